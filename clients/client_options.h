@@ -41,5 +41,7 @@ enum memcached_options {
   OPT_STAT_ARGS,
   OPT_SERVER_VERSION,
   OPT_QUIET,
+  OPT_HOT_KEYS,
+  OPT_CLIENT,
   OPT_FILE= 'f'
 };
@@ -975,6 +975,95 @@ static enum test_return test_binary_getkq(void)
   return test_binary_get_impl("test_binary_getkq", PROTOCOL_BINARY_CMD_GETKQ);
 }
 
+/**
+ * Receive a response with a body too large for the response buffer. Only
+ * the header is left in the response, the body goes to a buffer of its own
+ */
+static enum test_return recv_large_packet(response *rsp, std::vector<char>& body)
+{
+  execute(retry_read(rsp, sizeof(protocol_binary_response_no_extras)));
+
+  rsp->plain.message.header.response.keylen=
+          ntohs(rsp->plain.message.header.response.keylen);
+  rsp->plain.message.header.response.status=
+          ntohs(rsp->plain.message.header.response.status);
+  rsp->plain.message.header.response.bodylen=
+          ntohl(rsp->plain.message.header.response.bodylen);
+  rsp->plain.message.header.response.cas=
+          memcached_ntohll(rsp->plain.message.header.response.cas);
+
+  body.resize(rsp->plain.message.header.response.bodylen);
+  if (body.size() > 0)
+    execute(retry_read(&body[0], body.size()));
+
+  return TEST_PASS;
+}
+
+/**
+ * Store a value of the given size and read it back. A server may refuse
+ * a value as too large, but must return every byte of one it accepted
+ */
+static enum test_return binary_large_item_impl(const char *key, size_t size, uint8_t cc)
+{
+  size_t keylen= strlen(key);
+  std::vector<char> packet(sizeof(protocol_binary_request_set) + keylen + size);
+  protocol_binary_request_set *request= (protocol_binary_request_set*)&packet[0];
+  request->message.header.request.magic= PROTOCOL_BINARY_REQ;
+  request->message.header.request.opcode= PROTOCOL_BINARY_CMD_SET;
+  request->message.header.request.keylen= htons((uint16_t)keylen);
+  request->message.header.request.extlen= 8;
+  request->message.header.request.bodylen= htonl((uint32_t)(keylen + 8 + size));
+  request->message.header.request.opaque= 0xdeadbeef;
+
+  char *value= &packet[sizeof(protocol_binary_request_set)];
+  memcpy(value, key, keylen);
+  value+= keylen;
+  for (size_t x= 0; x < size; ++x)
+  {
+    value[x]= (char)('a' + x % 26);
+  }
+
+  execute(retry_write(&packet[0], packet.size()));
+
+  response rsp;
+  std::vector<char> body;
+  execute(recv_large_packet(&rsp, body));
+  if (size > 1024 * 1024 -1024 &&
+      rsp.plain.message.header.response.status == PROTOCOL_BINARY_RESPONSE_E2BIG)
+  {
+    return TEST_PASS;
+  }
+  verify(validate_response_header(&rsp, PROTOCOL_BINARY_CMD_SET,
+                                  PROTOCOL_BINARY_RESPONSE_SUCCESS));
+
+  command cmd;
+  raw_command(&cmd, cc, key, keylen, NULL, 0);
+  execute(send_packet(&cmd));
+  execute(recv_large_packet(&rsp, body));
+  verify(validate_response_header(&rsp, cc, PROTOCOL_BINARY_RESPONSE_SUCCESS));
+
+  size_t offset= 4;
+  if (cc == PROTOCOL_BINARY_CMD_GETK)
+  {
+    verify(rsp.plain.message.header.response.keylen == keylen);
+    verify(memcmp(&body[offset], key, keylen) == 0);
+    offset+= keylen;
+  }
+  verify(body.size() == offset + size);
+  verify(memcmp(&body[offset], value, size) == 0);
+
+  return TEST_PASS;
+}
+
+static enum test_return test_binary_large_value(void)
+{
+  execute(binary_large_item_impl("test_binary_large_value", 12000, PROTOCOL_BINARY_CMD_GET));
+  execute(binary_large_item_impl("test_binary_large_value", 12000, PROTOCOL_BINARY_CMD_GETK));
+  execute(binary_large_item_impl("test_binary_large_value", 1024 * 1024, PROTOCOL_BINARY_CMD_GETK));
+
+  return TEST_PASS;
+}
+
 static enum test_return test_binary_incr_impl(const char* key, uint8_t cc)
 {
   command cmd;
@@ -2051,6 +2140,7 @@ struct testcase testcases[]= {
   { "binary getq", test_binary_getq },
   { "binary getk", test_binary_getk },
   { "binary getkq", test_binary_getkq },
+  { "binary large value", test_binary_large_value },
   { "binary incr", test_binary_incr },
   { "binary incrq", test_binary_incrq },
   { "binary decr", test_binary_decr },
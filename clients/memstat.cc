@@ -17,7 +17,9 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <fcntl.h>
 #include <getopt.h>
 #include <unistd.h>
@@ -33,20 +35,26 @@
 
 #define PROGRAM_NAME "memstat"
 #define PROGRAM_DESCRIPTION "Output the state of a memcached cluster."
+#define HOT_KEYS_REPORTED 20
+#define CLIENT_PROBES 100
 
 /* Prototypes */
 static void options_parse(int argc, char *argv[]);
 static void run_analyzer(memcached_st *memc, memcached_stat_st *memc_stat);
 static void print_analysis_report(memcached_st *memc,
                                   memcached_analysis_st *report);
+static bool run_hot_keys(memcached_st *memc, const char *file);
+static bool run_client_stats(memcached_st *memc);
 
 static bool opt_binary= false;
 static bool opt_verbose= false;
 static bool opt_server_version= false;
 static bool opt_analyze= false;
+static bool opt_client= false;
 static char *opt_servers= NULL;
 static char *stat_args= NULL;
 static char *analyze_mode= NULL;
+static char *opt_hot_keys= NULL;
 static char *opt_username;
 static char *opt_passwd;
 
@@ -62,6 +70,8 @@ static struct option long_options[]=
   {(OPTIONSTRING)"server-version", no_argument, NULL, OPT_SERVER_VERSION},
   {(OPTIONSTRING)"servers", required_argument, NULL, OPT_SERVERS},
   {(OPTIONSTRING)"analyze", optional_argument, NULL, OPT_ANALYZE},
+  {(OPTIONSTRING)"hot-keys", required_argument, NULL, OPT_HOT_KEYS},
+  {(OPTIONSTRING)"client", no_argument, NULL, OPT_CLIENT},
   {(OPTIONSTRING)"username", required_argument, NULL, OPT_USERNAME},
   {(OPTIONSTRING)"password", required_argument, NULL, OPT_PASSWD},
   {0, 0, 0, 0},
@@ -188,6 +198,21 @@ int main(int argc, char *argv[])
 
     memcached_stat_free(memc, memc_stat);
   }
+  else if (opt_hot_keys)
+  {
+    if (run_hot_keys(memc, opt_hot_keys) == false)
+    {
+      rc= MEMCACHED_FAILURE;
+    }
+    free(opt_hot_keys);
+  }
+  else if (opt_client)
+  {
+    if (run_client_stats(memc) == false)
+    {
+      rc= MEMCACHED_FAILURE;
+    }
+  }
   else
   {
     rc= memcached_stat_execute(memc, stat_args, stat_printer, NULL);
@@ -370,6 +395,129 @@ static void print_analysis_report(memcached_st *memc,
   printf("\n");
 }
 
+static bool run_hot_keys(memcached_st *memc, const char *file)
+{
+  std::ifstream input;
+  if (strcmp(file, "-"))
+  {
+    input.open(file);
+    if (input.is_open() == false)
+    {
+      std::cerr << "Could not open " << file << std::endl;
+      return false;
+    }
+  }
+  std::istream& keys= strcmp(file, "-") ? input : std::cin;
+
+  if (memcached_failed(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_HOT_KEYS, HOT_KEYS_REPORTED)))
+  {
+    std::cerr << memcached_last_error_message(memc) << std::endl;
+    return false;
+  }
+
+  /* Every line is a key as a client would have requested it */
+  uint64_t read= 0;
+  std::string key;
+  while (std::getline(keys, key))
+  {
+    if (key.size() and key[key.size() -1] == '\r')
+    {
+      key.resize(key.size() -1);
+    }
+
+    if (memcached_success(memcached_hot_keys_add(memc, key.c_str(), key.size())))
+    {
+      read++;
+    }
+  }
+
+  memcached_hot_key_st hot[HOT_KEYS_REPORTED];
+  uint32_t number_of_keys= HOT_KEYS_REPORTED;
+  if (memcached_failed(memcached_hot_keys(memc, hot, &number_of_keys)))
+  {
+    std::cerr << memcached_last_error_message(memc) << std::endl;
+    return false;
+  }
+
+  printf("Hot keys out of %llu requests\n\n", (unsigned long long)read);
+  for (uint32_t x= 0; x < number_of_keys; x++)
+  {
+    const memcached_instance_st * instance= memcached_server_instance_by_position(memc, hot[x].server_key);
+    printf("\t%-40s : %llu requests on %s:%u\n", hot[x].key,
+           (unsigned long long)hot[x].count,
+           memcached_server_name(instance),
+           (uint32_t)memcached_server_port(instance));
+  }
+  printf("\n");
+
+  return true;
+}
+
+static bool run_client_stats(memcached_st *memc)
+{
+  if (memcached_failed(memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_SERVER_STATS, true)))
+  {
+    std::cerr << memcached_last_error_message(memc) << std::endl;
+    return false;
+  }
+
+  /* Keep probing until every server has answered enough gets, or it is clear some never will */
+  uint32_t server_count= memcached_server_count(memc);
+  for (uint32_t x= 0; x < CLIENT_PROBES * server_count * 4; x++)
+  {
+    char key[MEMCACHED_MAX_KEY];
+    int key_length= snprintf(key, sizeof(key), "memstat-probe-%u", x);
+
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    free(memcached_get(memc, key, size_t(key_length), &value_length, &flags, &rc));
+
+    bool done= true;
+    for (uint32_t y= 0; y < server_count; y++)
+    {
+      memcached_server_stats_st stats;
+      if (memcached_success(memcached_server_stats(memcached_server_instance_by_position(memc, y), &stats))
+          and stats.operation[MEMCACHED_OPERATION_GET].count < CLIENT_PROBES)
+      {
+        done= false;
+        break;
+      }
+    }
+
+    if (done)
+    {
+      break;
+    }
+  }
+
+  printf("Client latency in microseconds\n\n");
+  for (uint32_t x= 0; x < server_count; x++)
+  {
+    const memcached_instance_st * instance= memcached_server_instance_by_position(memc, x);
+
+    memcached_server_stats_st stats;
+    if (memcached_failed(memcached_server_stats(instance, &stats)))
+    {
+      std::cerr << memcached_last_error_message(memc) << std::endl;
+      return false;
+    }
+
+    printf("\t%s:%u => requests: %llu errors: %llu p50: %llu p90: %llu p99: %llu max: %llu\n",
+           memcached_server_name(instance),
+           (uint32_t)memcached_server_port(instance),
+           (unsigned long long)stats.operation[MEMCACHED_OPERATION_GET].count,
+           (unsigned long long)stats.operation[MEMCACHED_OPERATION_GET].errors,
+           (unsigned long long)memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_GET, 50),
+           (unsigned long long)memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_GET, 90),
+           (unsigned long long)memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_GET, 99),
+           (unsigned long long)stats.operation[MEMCACHED_OPERATION_GET].latency_max);
+  }
+  printf("\n");
+
+  return true;
+}
+
 static void options_parse(int argc, char *argv[])
 {
   memcached_programs_help_st help_options[]=
@@ -430,6 +578,14 @@ static void options_parse(int argc, char *argv[])
       analyze_mode= (optarg) ? strdup(optarg) : NULL;
       break;
 
+    case OPT_HOT_KEYS:
+      opt_hot_keys= strdup(optarg);
+      break;
+
+    case OPT_CLIENT:
+      opt_client= true;
+      break;
+
     case OPT_QUIET:
       close_stdio();
       break;
@@ -105,6 +105,8 @@ static const char *lookup_help(memcached_options option)
   case OPT_FILE: return "Path to file in which to save result";
   case OPT_STAT_ARGS: return "Argument for statistics";
   case OPT_SERVER_VERSION: return "Memcached daemon software version";
+  case OPT_HOT_KEYS: return "Report the heaviest keys of a file of keys, one per line (- for stdin)";
+  case OPT_CLIENT: return "Time a few gets against every server and report the latencies seen by the client";
   default:
                       break;
   };
@@ -81,11 +81,23 @@ static protocol_binary_response_status get_command_handler(const void *cookie,
   msg.response.message.header.response.status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS);
   msg.response.message.header.response.opaque= header->request.opaque;
 
+  key_lock lock(header + 1, ntohs(header->request.keylen));
   struct item *item= get_item(header + 1, ntohs(header->request.keylen));
   if (item)
   {
+    /* Values which do not fit the buffer on the stack get one of their own */
+    size_t offset= sizeof(*header) + 4;
+    size_t length= offset + item->nkey + item->size;
+    char *buffer= msg.buffer;
+    if (length > sizeof(msg) && (buffer= (char*)malloc(length)) == NULL)
+    {
+      release_item(item);
+      msg.response.message.header.response.status= htons(PROTOCOL_BINARY_RESPONSE_ENOMEM);
+      return response_handler(cookie, header, (protocol_binary_response_header*)&msg);
+    }
+
     msg.response.message.body.flags= htonl(item->flags);
-    char *ptr= (char*)(msg.response.bytes + sizeof(*header) + 4);
+    char *ptr= buffer + offset;
     uint32_t bodysize= 4;
     msg.response.message.header.response.cas= example_htonll(item->cas);
     if (opcode == PROTOCOL_BINARY_CMD_GETK || opcode == PROTOCOL_BINARY_CMD_GETKQ)
@@ -101,7 +113,15 @@ static protocol_binary_response_status get_command_handler(const void *cookie,
     msg.response.message.header.response.extlen= 4;
 
     release_item(item);
-    return response_handler(cookie, header, (protocol_binary_response_header*)&msg);
+    if (buffer == msg.buffer)
+    {
+      return response_handler(cookie, header, (protocol_binary_response_header*)&msg);
+    }
+
+    memcpy(buffer, msg.buffer, offset);
+    protocol_binary_response_status rval= response_handler(cookie, header, (protocol_binary_response_header*)buffer);
+    free(buffer);
+    return rval;
   }
   else if (opcode == PROTOCOL_BINARY_CMD_GET || opcode == PROTOCOL_BINARY_CMD_GETK)
   {
@@ -127,6 +147,7 @@ static protocol_binary_response_status delete_command_handler(const void *cookie
   response.message.header.response.opcode= header->request.opcode;
   response.message.header.response.opaque= header->request.opaque;
 
+  key_lock lock(key, keylen);
   if (delete_item(key, keylen) == false)
   {
     log_file->write(util::VERBOSE_NOTICE, "%s not found: %.*s", __func__, keylen, key);
@@ -151,9 +172,13 @@ static protocol_binary_response_status flush_command_handler(const void *cookie,
                                                              memcached_binary_protocol_raw_response_handler response_handler)
 {
   uint8_t opcode= header->request.opcode;
+  uint32_t when= 0;
 
-  /* @fixme sett inn when! */
-  flush(0);
+  if (header->request.extlen == 4)
+  {
+    when= ntohl(((protocol_binary_request_flush*)header)->message.body.expiration);
+  }
+  flush(when);
 
   if (opcode == PROTOCOL_BINARY_CMD_FLUSH)
   {
@@ -193,6 +218,7 @@ static protocol_binary_response_status arithmetic_command_handler(const void *co
 
   uint64_t value= initial;
 
+  key_lock lock(key, keylen);
   struct item *item= get_item(key, keylen);
   if (item != NULL)
   {
@@ -286,6 +312,7 @@ static protocol_binary_response_status concat_command_handler(const void *cookie
   uint32_t vallen= ntohl(header->request.bodylen) - keylen;
   void *val= (char*)key + keylen;
 
+  key_lock lock(key, keylen);
   struct item *item= get_item(key, keylen);
   struct item *nitem= NULL;
 
@@ -295,6 +322,7 @@ static protocol_binary_response_status concat_command_handler(const void *cookie
   }
   else if (cas != 0 && cas != item->cas)
   {
+    release_item(item);
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
   }
   else if ((nitem= create_item(key, keylen, NULL, item->size + vallen,
@@ -361,6 +389,7 @@ static protocol_binary_response_status set_command_handler(const void *cookie,
   response.message.header.response.status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS);
   response.message.header.response.opaque= header->request.opaque;
 
+  key_lock lock(key, keylen);
   if (header->request.cas != 0)
   {
     /* validate cas */
@@ -421,6 +450,7 @@ static protocol_binary_response_status add_command_handler(const void *cookie,
   response.message.header.response.status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS);
   response.message.header.response.opaque= header->request.opaque;
 
+  key_lock lock(key, keylen);
   struct item* item= get_item(key, keylen);
   if (item == NULL)
   {
@@ -470,6 +500,7 @@ static protocol_binary_response_status replace_command_handler(const void *cooki
   response.message.header.response.status= htons(PROTOCOL_BINARY_RESPONSE_SUCCESS);
   response.message.header.response.opaque= header->request.opaque;
 
+  key_lock lock(key, keylen);
   struct item* item= get_item(key, keylen);
   if (item == NULL)
   {
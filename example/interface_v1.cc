@@ -12,6 +12,7 @@
 
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -37,6 +38,7 @@ static protocol_binary_response_status add_handler(const void *cookie,
                                                    uint64_t *cas)
 {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
   struct item* item= get_item(key, keylen);
   if (item == NULL)
@@ -55,6 +57,7 @@ static protocol_binary_response_status add_handler(const void *cookie,
   }
   else
   {
+    release_item(item);
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
   }
 
@@ -70,6 +73,7 @@ static protocol_binary_response_status append_handler(const void *cookie,
                                                       uint64_t *result_cas)
 {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
 
   struct item *item= get_item(key, keylen);
@@ -81,6 +85,7 @@ static protocol_binary_response_status append_handler(const void *cookie,
   }
   else if (cas != 0 && cas != item->cas)
   {
+    release_item(item);
     rval= PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
   }
   else if ((nitem= create_item(key, keylen, NULL, item->size + vallen,
@@ -112,6 +117,7 @@ static protocol_binary_response_status decrement_handler(const void *cookie,
                                                          uint64_t *result,
                                                          uint64_t *result_cas) {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
   uint64_t val= initial;
   struct item *item= get_item(key, keylen);
@@ -150,6 +156,7 @@ static protocol_binary_response_status delete_handler(const void *, // cookie
                                                       uint16_t keylen,
                                                       uint64_t cas)
 {
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
 
   if (cas != 0)
@@ -175,15 +182,23 @@ static protocol_binary_response_status delete_handler(const void *, // cookie
 }
 
 
-static protocol_binary_response_status flush_handler(const void * /* cookie */, uint32_t /* when */)
+static protocol_binary_response_status flush_handler(const void * /* cookie */, uint32_t when)
 {
+  flush(when);
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+static void release_value(const void *, // cookie
+                          void *item)
+{
+  release_item((struct item*)item);
+}
+
 static protocol_binary_response_status get_handler(const void *cookie,
                                                    const void *key,
                                                    uint16_t keylen,
                                                    memcached_binary_protocol_get_response_handler response_handler) {
+  key_lock lock(key, keylen);
   struct item *item= get_item(key, keylen);
 
   if (item == NULL)
@@ -191,12 +206,11 @@ static protocol_binary_response_status get_handler(const void *cookie,
     return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
   }
 
-  protocol_binary_response_status rc;
-  rc= response_handler(cookie, key, (uint16_t)keylen,
+  /* The value is sent from the item, which is released once it is sent */
+  memcached_binary_protocol_reference_body(cookie, release_value, item);
+  return response_handler(cookie, key, (uint16_t)keylen,
                           item->data, (uint32_t)item->size, item->flags,
                           item->cas);
-  release_item(item);
-  return rc;
 }
 
 static protocol_binary_response_status increment_handler(const void *cookie,
@@ -208,6 +222,7 @@ static protocol_binary_response_status increment_handler(const void *cookie,
                                                          uint64_t *result,
                                                          uint64_t *result_cas) {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
   uint64_t val= initial;
   struct item *item= get_item(key, keylen);
@@ -252,6 +267,7 @@ static protocol_binary_response_status prepend_handler(const void *cookie,
                                                        uint64_t cas,
                                                        uint64_t *result_cas) {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
 
   struct item *item= get_item(key, keylen);
@@ -305,6 +321,7 @@ static protocol_binary_response_status replace_handler(const void *, // cookie
                                                        uint64_t cas,
                                                        uint64_t *result_cas)
 {
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
   struct item* item= get_item(key, keylen);
 
@@ -347,6 +364,7 @@ static protocol_binary_response_status set_handler(const void *cookie,
                                                    uint64_t cas,
                                                    uint64_t *result_cas) {
   (void)cookie;
+  key_lock lock(key, keylen);
   protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
 
   if (cas != 0)
@@ -358,6 +376,10 @@ static protocol_binary_response_status set_handler(const void *cookie,
       release_item(item);
       return PROTOCOL_BINARY_RESPONSE_KEY_EEXISTS;
     }
+    else if (item != NULL)
+    {
+      release_item(item);
+    }
   }
 
   delete_item(key, keylen);
@@ -376,12 +398,80 @@ static protocol_binary_response_status set_handler(const void *cookie,
   return rval;
 }
 
+static protocol_binary_response_status send_stat(const void *cookie,
+                                                 memcached_binary_protocol_stat_response_handler response_handler,
+                                                 const char *key, uint64_t value)
+{
+  char buffer[32];
+  int length= snprintf(buffer, sizeof(buffer), "%" PRIu64, value);
+
+  return response_handler(cookie, key, (uint16_t)strlen(key), buffer, (uint32_t)length);
+}
+
 static protocol_binary_response_status stat_handler(const void *cookie,
-                                                    const void *, // key
-                                                    uint16_t, // keylen,
+                                                    const void *key,
+                                                    uint16_t keylen,
                                                     memcached_binary_protocol_stat_response_handler response_handler)
 {
-  /* Just return an empty packet */
+  protocol_binary_response_status rval= PROTOCOL_BINARY_RESPONSE_SUCCESS;
+
+  if (keylen == 0)
+  {
+    struct storage_stats stats;
+    get_storage_stats(&stats);
+
+    if ((rval= send_stat(cookie, response_handler, "curr_items", stats.curr_items)) != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        (rval= send_stat(cookie, response_handler, "total_items", stats.total_items)) != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        (rval= send_stat(cookie, response_handler, "bytes", stats.bytes)) != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        (rval= send_stat(cookie, response_handler, "limit_maxbytes", stats.limit_maxbytes)) != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        (rval= send_stat(cookie, response_handler, "total_malloced", stats.total_malloced)) != PROTOCOL_BINARY_RESPONSE_SUCCESS ||
+        (rval= send_stat(cookie, response_handler, "evictions", stats.evictions)) != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+    {
+      return rval;
+    }
+  }
+  else if (keylen == 5 && memcmp(key, "slabs", 5) == 0)
+  {
+    /* One group of counters for every slab class which has memory */
+    struct storage_slab_stats stats;
+    for (unsigned int id= 1; get_slab_stats(id, &stats); id++)
+    {
+      if (stats.total_pages == 0)
+      {
+        continue;
+      }
+
+      const struct {
+        const char *name;
+        uint64_t value;
+      } counters[]= {
+        { "chunk_size", stats.chunk_size },
+        { "chunks_per_page", stats.chunks_per_page },
+        { "total_pages", stats.total_pages },
+        { "total_chunks", stats.total_pages * stats.chunks_per_page },
+        { "used_chunks", stats.used_chunks },
+        { "free_chunks", stats.free_chunks },
+        { "items", stats.items },
+        { "evicted", stats.evicted }
+      };
+
+      for (size_t x= 0; x < sizeof(counters) / sizeof(counters[0]); x++)
+      {
+        char name[64];
+        snprintf(name, sizeof(name), "%u:%s", id, counters[x].name);
+        if ((rval= send_stat(cookie, response_handler, name, counters[x].value)) != PROTOCOL_BINARY_RESPONSE_SUCCESS)
+        {
+          return rval;
+        }
+      }
+    }
+  }
+  else
+  {
+    return PROTOCOL_BINARY_RESPONSE_KEY_ENOENT;
+  }
+
+  /* An empty packet ends the list */
   return response_handler(cookie, NULL, 0, NULL, 0);
 }
 
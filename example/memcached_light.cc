@@ -3,18 +3,20 @@
  * What is a library without an example to show you how to use the library?
  * This example use both interfaces to implement a small memcached server.
  * Please note that this is an exemple on how to use the library, not
- * an implementation of a scalable memcached server. If you look closely
- * at the example it isn't even multithreaded ;-)
+ * an implementation of a scalable memcached server. Unless it is started
+ * with --threads it serves all of the clients from a single thread ;-)
  *
  * With that in mind, let me give you some pointers into the source:
- *   storage.c/h       - Implements the item store for this server and not really
+ *   storage.c/h       - Implements the item store for this server (a hash table
+ *                       with an LRU and a memory limit) and not really
  *                       interesting for this example.
+ *   slabs.cc/h        - The allocator behind the item store.
  *   interface_v0.cc   - Shows an implementation of the memcached server by using
  *                       the "raw" access to the packets as they arrive
  *   interface_v1.cc   - Shows an implementation of the memcached server by using
  *                       the more "logical" interface.
  *   memcached_light.cc- This file sets up all of the sockets and run the main
- *                       message loop.
+ *                       message loop, and the loops of the worker threads.
  *
  *
  * config.h is included so that I can use the ntohll/htonll on platforms that
@@ -47,6 +49,7 @@ using namespace datadifferential;
 #include <fcntl.h>
 #include <getopt.h>
 #include <iostream>
+#include <pthread.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -59,9 +62,29 @@ static int num_server_sockets= 0;
 struct connection
 {
   void *userdata;
+  struct event_base *base; /* The loop driving the connection */
   struct event event;
 };
 
+/*
+ * With --threads the main thread only accepts the connections, and hands
+ * them out in turn to the workers through their notify pipe. Every worker
+ * has an event loop and a protocol instance of its own.
+ */
+struct worker
+{
+  pthread_t thread;
+  struct event_base *base;
+  struct memcached_protocol_st *protocol;
+  int notify_receive;
+  int notify_send;
+  struct event notify_event;
+};
+
+static struct worker *workers= NULL;
+static unsigned int num_workers= 0;
+static unsigned int next_worker= 0;
+
 /* The default maximum number of connections... (change with -c) */
 static int maxconns= 1024;
 
@@ -72,11 +95,15 @@ struct options_st {
   std::string pid_file;
   std::string service;
   std::string log_file;
+  size_t memory_limit;
+  unsigned int threads;
   bool is_verbose;
   bool opt_daemon;
 
   options_st() :
     service("9999"),
+    memory_limit(64 * 1024 * 1024),
+    threads(1),
     is_verbose(false),
     opt_daemon(false)
   {
@@ -85,6 +112,19 @@ struct options_st {
 
 static options_st global_options;
 
+static struct event expire_event;
+
+/**
+ * Callback for the timer removing the expired items
+ */
+static void expire_handler(memcached_socket_t, short, void *)
+{
+  expire_items();
+
+  struct timeval interval= { 1, 0 };
+  evtimer_add(&expire_event, &interval);
+}
+
 /**
  * Callback for driving a client connection
  * @param fd the socket for the client socket
@@ -136,7 +176,7 @@ static void drive_client(memcached_socket_t fd, short, void *arg)
     }
 
     event_set(&client->event, int(fd), flags, drive_client, client);
-    event_base_set(event_base, &client->event);
+    event_base_set(client->base, &client->event);
 
     if (event_add(&client->event, 0) == -1)
     {
@@ -146,6 +186,108 @@ static void drive_client(memcached_socket_t fd, short, void *arg)
   }
 }
 
+/**
+ * Start driving a new client connection from an event loop
+ * @param base the event loop of the thread serving the client
+ * @param protocol the protocol instance of that thread
+ * @param sock the socket for the client
+ */
+static void register_client(struct event_base *base,
+                            struct memcached_protocol_st *protocol,
+                            memcached_socket_t sock)
+{
+  struct memcached_protocol_client_st* c= memcached_protocol_create_client(protocol, sock);
+  if (c == NULL)
+  {
+    closesocket(sock);
+  }
+  else
+  {
+    memcached_protocol_client_set_verbose(c, global_options.is_verbose);
+    struct connection *client = &socket_userdata_map[sock];
+    client->userdata= c;
+    client->base= base;
+
+    event_set(&client->event, int(sock), EV_READ, drive_client, client);
+    event_base_set(base, &client->event);
+    if (event_add(&client->event, 0) == -1)
+    {
+      std::cerr << "Failed to add event for " << sock << std::endl;
+      memcached_protocol_client_destroy(c);
+      closesocket(sock);
+    }
+  }
+}
+
+/**
+ * Callback for the connections handed to a worker thread
+ * @param fd the receiving end of the notify pipe of the worker
+ * @param which identifying the event that occurred (not used)
+ * @param arg the worker
+ */
+static void notify_handler(memcached_socket_t fd, short, void *arg)
+{
+  struct worker *worker= (struct worker*)arg;
+  memcached_socket_t sock;
+
+  if (read(fd, &sock, sizeof(sock)) == (ssize_t)sizeof(sock))
+  {
+    register_client(worker->base, worker->protocol, sock);
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  struct worker *worker= (struct worker*)arg;
+
+  if (event_base_loop(worker->base, 0) == -1)
+  {
+    std::cerr << "event_base_loop() failed in a worker thread" << std::endl;
+  }
+
+  return NULL;
+}
+
+static bool start_workers(memcached_binary_protocol_callback_st *interface)
+{
+  workers= (struct worker*)calloc(global_options.threads, sizeof(struct worker));
+  if (workers == NULL)
+  {
+    return false;
+  }
+
+  for (num_workers= 0; num_workers < global_options.threads; ++num_workers)
+  {
+    struct worker *worker= &workers[num_workers];
+    int fds[2];
+
+    if (pipe(fds) == -1)
+    {
+      return false;
+    }
+    worker->notify_receive= fds[0];
+    worker->notify_send= fds[1];
+
+    if ((worker->base= event_base_new()) == NULL ||
+        (worker->protocol= memcached_protocol_create_instance()) == NULL)
+    {
+      return false;
+    }
+    memcached_binary_protocol_set_callbacks(worker->protocol, interface);
+    memcached_binary_protocol_set_pedantic(worker->protocol, true);
+
+    event_set(&worker->notify_event, worker->notify_receive, EV_READ | EV_PERSIST, notify_handler, worker);
+    event_base_set(worker->base, &worker->notify_event);
+    if (event_add(&worker->notify_event, 0) == -1 ||
+        pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 /**
  * Callback for accepting new connections
  * @param fd the socket for the server socket
@@ -163,6 +305,7 @@ static void accept_handler(memcached_socket_t fd, short, void *arg)
   if (sock == INVALID_SOCKET)
   {
     perror("Failed to accept client");
+    return;
   }
 
 #ifndef WIN32
@@ -171,27 +314,30 @@ static void accept_handler(memcached_socket_t fd, short, void *arg)
     closesocket(sock);
     return ;
   }
-#endif
 
-  struct memcached_protocol_client_st* c= memcached_protocol_create_client((memcached_protocol_st*)server->userdata, sock);
-  if (c == NULL)
+  /* The client is driven until its reads would block */
+  int flags= fcntl(sock, F_GETFL, 0);
+  if (flags == -1 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
   {
+    perror("Failed to set client socket to nonblocking mode");
     closesocket(sock);
+    return;
   }
-  else
+#endif
+
+  if (num_workers == 0)
   {
-    memcached_protocol_client_set_verbose(c, global_options.is_verbose);
-    struct connection *client = &socket_userdata_map[sock];
-    client->userdata= c;
+    register_client(server->base, (memcached_protocol_st*)server->userdata, sock);
+    return;
+  }
 
-    event_set(&client->event, int(sock), EV_READ, drive_client, client);
-    event_base_set(event_base, &client->event);
-    if (event_add(&client->event, 0) == -1)
-    {
-      std::cerr << "Failed to add event for " << sock << std::endl;
-      memcached_protocol_client_destroy(c);
-      closesocket(sock);
-    }
+  struct worker *worker= &workers[next_worker];
+  next_worker= (next_worker + 1) % num_workers;
+
+  if (write(worker->notify_send, &sock, sizeof(sock)) != (ssize_t)sizeof(sock))
+  {
+    perror("Failed to hand the client to a worker");
+    closesocket(sock);
   }
 }
 
@@ -444,7 +590,9 @@ int main(int argc, char **argv)
       OPT_PORT,
       OPT_MAX_CONNECTIONS,
       OPT_LOGFILE,
-      OPT_PIDFILE
+      OPT_PIDFILE,
+      OPT_MEMORY_LIMIT,
+      OPT_THREADS
     };
 
     static struct option long_options[]=
@@ -458,6 +606,8 @@ int main(int argc, char **argv)
       { "max-connections", required_argument, NULL, OPT_MAX_CONNECTIONS },
       { "pid-file", required_argument, NULL, OPT_PIDFILE },
       { "log-file", required_argument, NULL, OPT_LOGFILE },
+      { "memory-limit", required_argument, NULL, OPT_MEMORY_LIMIT },
+      { "threads", required_argument, NULL, OPT_THREADS },
       {0, 0, 0, 0}
     };
 
@@ -503,6 +653,19 @@ int main(int argc, char **argv)
         maxconns= atoi(optarg);
         break;
 
+      case OPT_MEMORY_LIMIT:
+        /* In megabytes, 0 for no limit */
+        global_options.memory_limit= size_t(strtoul(optarg, NULL, 10)) * 1024 * 1024;
+        break;
+
+      case OPT_THREADS:
+        global_options.threads= (unsigned int)strtoul(optarg, NULL, 10);
+        if (global_options.threads == 0)
+        {
+          global_options.threads= 1;
+        }
+        break;
+
       case OPT_HELP:  /* FALLTHROUGH */
         opt_help= true;
         break;
@@ -531,7 +694,7 @@ int main(int argc, char **argv)
     util::daemonize(false, true);
   }
 
-  if (initialize_storage() == false)
+  if (initialize_storage(global_options.memory_limit, global_options.threads) == false)
   {
     /* Error message already printed */
     return EXIT_FAILURE;
@@ -604,6 +767,7 @@ int main(int argc, char **argv)
   {
     struct connection *conn= &socket_userdata_map[server_sockets[xx]];
     conn->userdata= protocol_handle;
+    conn->base= event_base;
 
     event_set(&conn->event, int(server_sockets[xx]), EV_READ | EV_PERSIST, accept_handler, conn);
 
@@ -615,6 +779,21 @@ int main(int argc, char **argv)
     }
   }
 
+  evtimer_set(&expire_event, expire_handler, NULL);
+  event_base_set(event_base, &expire_event);
+  struct timeval interval= { 1, 0 };
+  if (evtimer_add(&expire_event, &interval) == -1)
+  {
+    log_file.write(util::VERBOSE_ERROR, "Failed to add the expiry timer");
+  }
+
+  /* A single thread serves the clients from the main loop */
+  if (global_options.threads > 1 && start_workers(interface) == false)
+  {
+    log_file.write(util::VERBOSE_ERROR, "Failed to start the worker threads");
+    return EXIT_FAILURE;
+  }
+
   if (global_options.opt_daemon)
   {
     if (util::daemon_is_ready(true) == false)
@@ -0,0 +1,333 @@
+/* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/**
+ * The allocator behind the item store of memcached_light. Items are carved
+ * out of pages of SLAB_PAGE_SIZE bytes, each page serving a single size
+ * class, the classes growing by SLAB_GROWTH_FACTOR up to a full page.
+ * Pages are taken from arenas mmap'd ARENA_PAGES at a time, and are never
+ * given back: a freed chunk goes on the free list of its class. A single
+ * lock guards all of them, as the store calls in from every thread.
+ */
+#include "mem_config.h"
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "storage.h"
+#include "slabs.h"
+
+#define SLAB_MIN_CHUNK 128
+#define SLAB_GROWTH_FACTOR 1.25
+#define SLAB_ALIGNMENT 8
+#define ARENA_PAGES 16
+
+struct slab_class {
+  size_t size;
+  size_t perslab;
+  void *free_list; /* Each free chunk starts with the next one */
+  size_t free_chunks;
+  char *next_chunk; /* Not yet handed out in the last page */
+  size_t chunks_left;
+  size_t total_pages;
+};
+
+struct arena {
+  char *base;
+  size_t pages;
+  struct arena *next;
+};
+
+static struct slab_class classes[MAX_SLAB_CLASSES + 1];
+static unsigned int largest;
+
+static struct arena *arenas;
+static size_t arena_pages_left;
+static size_t pages_total;
+static size_t page_limit;
+static char **page_table; /* Every page handed out, only kept with a memory limit */
+
+static pthread_mutex_t slabs_lock= PTHREAD_MUTEX_INITIALIZER;
+
+bool slabs_init(size_t memory_limit)
+{
+  size_t size= SLAB_MIN_CHUNK;
+
+  largest= 0;
+  while (largest < MAX_SLAB_CLASSES - 1 && size <= SLAB_PAGE_SIZE / 2)
+  {
+    struct slab_class *slab= &classes[++largest];
+    slab->size= size;
+    slab->perslab= SLAB_PAGE_SIZE / size;
+
+    size= (size_t)((double)size * SLAB_GROWTH_FACTOR);
+    size= (size + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1);
+  }
+
+  /* The last class holds a single item per page */
+  classes[++largest].size= SLAB_PAGE_SIZE;
+  classes[largest].perslab= 1;
+
+  page_limit= 0;
+  if (memory_limit != 0)
+  {
+    page_limit= memory_limit / SLAB_PAGE_SIZE;
+    if (page_limit == 0)
+    {
+      page_limit= 1;
+    }
+
+    if ((page_table= (char**)calloc(page_limit, sizeof(char*))) == NULL)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void slabs_shutdown(void)
+{
+  while (arenas != NULL)
+  {
+    struct arena *next= arenas->next;
+    munmap(arenas->base, arenas->pages * SLAB_PAGE_SIZE);
+    free(arenas);
+    arenas= next;
+  }
+
+  free(page_table);
+  page_table= NULL;
+
+  memset(classes, 0, sizeof(classes));
+  arena_pages_left= pages_total= 0;
+}
+
+unsigned int slabs_clsid(size_t size)
+{
+  for (unsigned int id= 1; id <= largest; id++)
+  {
+    if (size <= classes[id].size)
+    {
+      return id;
+    }
+  }
+
+  return 0;
+}
+
+unsigned int slabs_largest_clsid(void)
+{
+  return largest;
+}
+
+static char* new_page(void)
+{
+  if (page_limit != 0 && pages_total >= page_limit)
+  {
+    return NULL;
+  }
+
+  if (arena_pages_left == 0)
+  {
+    size_t pages= ARENA_PAGES;
+    if (page_limit != 0 && page_limit - pages_total < pages)
+    {
+      pages= page_limit - pages_total;
+    }
+
+    struct arena *arena= (struct arena*)malloc(sizeof(struct arena));
+    if (arena == NULL)
+    {
+      return NULL;
+    }
+
+    arena->base= (char*)mmap(NULL, pages * SLAB_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena->base == MAP_FAILED)
+    {
+      free(arena);
+      return NULL;
+    }
+    arena->pages= pages;
+    arena->next= arenas;
+    arenas= arena;
+    arena_pages_left= pages;
+  }
+
+  char *page= arenas->base + (arenas->pages - arena_pages_left) * SLAB_PAGE_SIZE;
+  --arena_pages_left;
+  if (page_table != NULL)
+  {
+    page_table[pages_total]= page;
+  }
+  ++pages_total;
+
+  return page;
+}
+
+static void* do_slabs_alloc(struct slab_class *slab)
+{
+  if (slab->free_list != NULL)
+  {
+    void *ret= slab->free_list;
+    slab->free_list= *(void**)ret;
+    --slab->free_chunks;
+    return ret;
+  }
+
+  if (slab->chunks_left == 0)
+  {
+    if ((slab->next_chunk= new_page()) == NULL)
+    {
+      return NULL;
+    }
+    slab->chunks_left= slab->perslab;
+    ++slab->total_pages;
+  }
+
+  void *ret= slab->next_chunk;
+  slab->next_chunk+= slab->size;
+  --slab->chunks_left;
+
+  return ret;
+}
+
+void* slabs_alloc(unsigned int id)
+{
+  pthread_mutex_lock(&slabs_lock);
+  void *ret= do_slabs_alloc(&classes[id]);
+  pthread_mutex_unlock(&slabs_lock);
+
+  return ret;
+}
+
+void slabs_free(void* ptr, unsigned int id)
+{
+  struct slab_class *slab= &classes[id];
+
+  pthread_mutex_lock(&slabs_lock);
+  *(void**)ptr= slab->free_list;
+  slab->free_list= ptr;
+  ++slab->free_chunks;
+  pthread_mutex_unlock(&slabs_lock);
+}
+
+bool slabs_full(void)
+{
+  pthread_mutex_lock(&slabs_lock);
+  bool ret= page_limit != 0 && pages_total >= page_limit;
+  pthread_mutex_unlock(&slabs_lock);
+
+  return ret;
+}
+
+char* slabs_page_of(const void* ptr)
+{
+  const char *chunk= (const char*)ptr;
+  char *ret= NULL;
+
+  pthread_mutex_lock(&slabs_lock);
+  for (size_t x= 0; page_table != NULL && x < pages_total; x++)
+  {
+    if (chunk >= page_table[x] && chunk < page_table[x] + SLAB_PAGE_SIZE)
+    {
+      ret= page_table[x];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&slabs_lock);
+
+  return ret;
+}
+
+static bool in_page(const void* ptr, const char* page)
+{
+  return (const char*)ptr >= page && (const char*)ptr < page + SLAB_PAGE_SIZE;
+}
+
+bool slabs_move_page(char* page, unsigned int from, unsigned int to)
+{
+  struct slab_class *source= &classes[from];
+  struct slab_class *target= &classes[to];
+
+  pthread_mutex_lock(&slabs_lock);
+
+  /* Only the carved part of the page being carved can be in use */
+  bool carving= source->chunks_left != 0 && in_page(source->next_chunk, page);
+  size_t used= carving ? source->perslab - source->chunks_left : source->perslab;
+
+  size_t free_chunks= 0;
+  for (void *chunk= source->free_list; chunk != NULL; chunk= *(void**)chunk)
+  {
+    if (in_page(chunk, page))
+    {
+      ++free_chunks;
+    }
+  }
+
+  if (free_chunks != used)
+  {
+    /* Some of its items are still referenced or were just stored */
+    pthread_mutex_unlock(&slabs_lock);
+    return false;
+  }
+
+  void **link= &source->free_list;
+  while (*link != NULL)
+  {
+    if (in_page(*link, page))
+    {
+      *link= *(void**)*link;
+    }
+    else
+    {
+      link= (void**)*link;
+    }
+  }
+  source->free_chunks-= free_chunks;
+  if (carving)
+  {
+    source->next_chunk= NULL;
+    source->chunks_left= 0;
+  }
+  --source->total_pages;
+
+  /* The target ran out of chunks, the page becomes the one it carves */
+  for (; target->chunks_left != 0; --target->chunks_left)
+  {
+    *(void**)target->next_chunk= target->free_list;
+    target->free_list= target->next_chunk;
+    target->next_chunk+= target->size;
+    ++target->free_chunks;
+  }
+  target->next_chunk= page;
+  target->chunks_left= target->perslab;
+  ++target->total_pages;
+
+  pthread_mutex_unlock(&slabs_lock);
+
+  return true;
+}
+
+void slabs_stats(unsigned int id, struct storage_slab_stats* stats)
+{
+  struct slab_class *slab= &classes[id];
+
+  pthread_mutex_lock(&slabs_lock);
+  stats->chunk_size= slab->size;
+  stats->chunks_per_page= slab->perslab;
+  stats->total_pages= slab->total_pages;
+  stats->free_chunks= slab->free_chunks + slab->chunks_left;
+  stats->used_chunks= slab->total_pages * slab->perslab - stats->free_chunks;
+  pthread_mutex_unlock(&slabs_lock);
+}
+
+size_t slabs_total_malloced(void)
+{
+  pthread_mutex_lock(&slabs_lock);
+  size_t ret= pages_total * SLAB_PAGE_SIZE;
+  pthread_mutex_unlock(&slabs_lock);
+
+  return ret;
+}
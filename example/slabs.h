@@ -0,0 +1,31 @@
+/* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+#pragma once
+
+/* The largest value, pages leave room for the header and key of its item */
+#define ITEM_SIZE_MAX (1024 * 1024)
+/* Every item, with its header and key, has to fit in a single page */
+#define SLAB_PAGE_SIZE (ITEM_SIZE_MAX + 4096)
+#define MAX_SLAB_CLASSES 64
+
+/* A memory_limit of 0 lets the slabs grow without bounds */
+bool slabs_init(size_t memory_limit);
+void slabs_shutdown(void);
+
+/* The class for an item of size bytes, 0 if it is too large */
+unsigned int slabs_clsid(size_t size);
+unsigned int slabs_largest_clsid(void);
+
+/* NULL once the memory limit is reached and the class has no free chunk */
+void* slabs_alloc(unsigned int id);
+void slabs_free(void* ptr, unsigned int id);
+
+/* true once the memory limit is reached, classes then only grow by moving pages */
+bool slabs_full(void);
+/* The start of the page holding a chunk */
+char* slabs_page_of(const void* ptr);
+/* Hands a page of class from over to class to, false unless all its chunks are free */
+bool slabs_move_page(char* page, unsigned int from, unsigned int to);
+
+/* Fills the chunk and page counts of stats */
+void slabs_stats(unsigned int id, struct storage_slab_stats* stats);
+size_t slabs_total_malloced(void);
@@ -1,168 +1,692 @@
 /* -*- Mode: C; tab-width: 2; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/**
+ * The item store of memcached_light. Items live in a hash table which
+ * grows by rehashing a few buckets on every access. Their memory comes from
+ * the slabs, and every slab class has an LRU list which is used to evict
+ * items of that class once the memory limit is reached. Expired items are
+ * removed when they are looked up, and by expire_items() which the server
+ * calls periodically.
+ *
+ * When the store is shared by several threads it is split in shards, picked
+ * by the high bits of the hash of the key. Each shard has its own table,
+ * LRU lists and lock, and the commands hold the lock of their key with
+ * lock_key() while they look at and replace its items.
+ *
+ * Every item carries a reference count. The table holds one reference, and
+ * create_item() and get_item() hand one to the caller which must give it
+ * back with release_item(). An item which is deleted or evicted while a
+ * caller still holds it stays valid until it is released.
+ */
 #include "mem_config.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 #include "storage.h"
+#include "slabs.h"
 
-struct list_entry {
+/* Expiration times above this are absolute unix times, below it relative */
+#define REALTIME_MAXDELTA (60 * 60 * 24 * 30)
+
+#define INITIAL_HASH_POWER 16
+/* The smallest initial table of a shard */
+#define MIN_HASH_POWER 10
+/* The shards for every thread sharing the store */
+#define SHARDS_PER_THREAD 4
+#define MAX_SHARD_POWER 8
+/* Buckets moved to the new table on every access while growing */
+#define REHASH_STEP 16
+/* Buckets of every shard visited by every call to expire_items() */
+#define EXPIRE_STEP 1024
+
+struct hash_entry {
   struct item item;
-  struct list_entry *next;
-  struct list_entry *prev;
+  struct hash_entry *h_next; /* Next in the hash bucket */
+  struct hash_entry *next; /* LRU, towards the least recently used */
+  struct hash_entry *prev;
+  uint32_t hash;
+  uint32_t refcount;
+  time_t time; /* When it was stored */
+  time_t atime; /* When it was last stored or read */
+  size_t total; /* Bytes used in the chunk */
+  unsigned int clsid;
+};
+
+struct hash_table {
+  struct hash_entry **buckets;
+  size_t size; /* Always a power of two */
 };
 
-static struct list_entry *root;
+struct shard {
+  pthread_mutex_t mutex; /* Guards everything below */
+  struct hash_table primary;
+  struct hash_table old; /* The table being rehashed into primary */
+  size_t rehash_bucket;
+  size_t expire_bucket;
+  size_t item_count;
+  uint64_t total_items;
+
+  struct hash_entry *lru_heads[MAX_SLAB_CLASSES + 1];
+  struct hash_entry *lru_tails[MAX_SLAB_CLASSES + 1];
+  size_t class_items[MAX_SLAB_CLASSES + 1];
+  uint64_t class_evicted[MAX_SLAB_CLASSES + 1];
+};
+
+static struct shard *shards;
+static size_t num_shards;
+static unsigned int shard_shift; /* 32 with a single shard */
+
+static size_t memory_limit;
+static size_t memory_used;
+
+static time_t oldest_live;
 static uint64_t cas;
 
-bool initialize_storage(void)
+static uint32_t hash_key(const void* key, size_t nkey)
 {
-  return true;
+  const uint8_t *ptr= (const uint8_t*)key;
+  uint32_t value= 2166136261UL;
+
+  for (size_t x= 0; x < nkey; x++)
+  {
+    value^= ptr[x];
+    value*= 16777619;
+  }
+
+  return value;
 }
 
-void shutdown_storage(void)
+/* The low bits of the hash pick the bucket, the high bits the shard */
+static struct shard* shard_of(uint32_t hash)
 {
-  /* Do nothing */
+  return &shards[(uint64_t)hash >> shard_shift];
 }
 
-void put_item(struct item* item)
+static time_t realtime(time_t exp, time_t now)
 {
-  struct list_entry* entry= (struct list_entry*)item;
+  if (exp == 0 || exp > REALTIME_MAXDELTA)
+  {
+    return exp;
+  }
 
-  update_cas(item);
+  return now + exp;
+}
 
-  if (root == NULL)
+static bool is_expired(const struct hash_entry *entry, time_t now)
+{
+  if (entry->item.exp != 0 && entry->item.exp <= now)
   {
-    entry->next= entry->prev= entry;
+    return true;
+  }
+
+  time_t live= __atomic_load_n(&oldest_live, __ATOMIC_RELAXED);
+  return live != 0 && live <= now && entry->time <= live;
+}
+
+static bool allocate_table(struct hash_table *table, size_t size)
+{
+  table->buckets= (struct hash_entry**)calloc(size, sizeof(struct hash_entry*));
+  if (table->buckets == NULL)
+  {
+    return false;
+  }
+  table->size= size;
+
+  return true;
+}
+
+static void free_entry(struct hash_entry *entry)
+{
+  __atomic_sub_fetch(&memory_used, entry->total, __ATOMIC_RELAXED);
+  slabs_free(entry, entry->clsid);
+}
+
+static void lru_unlink(struct shard *shard, struct hash_entry *entry)
+{
+  if (entry->prev)
+  {
+    entry->prev->next= entry->next;
   }
   else
   {
-    entry->prev= root->prev;
-    entry->next= root;
-    entry->prev->next= entry;
-    entry->next->prev= entry;
+    shard->lru_heads[entry->clsid]= entry->next;
   }
 
-  root= entry;
+  if (entry->next)
+  {
+    entry->next->prev= entry->prev;
+  }
+  else
+  {
+    shard->lru_tails[entry->clsid]= entry->prev;
+  }
+
+  entry->next= entry->prev= NULL;
 }
 
-struct item* get_item(const void* key, size_t nkey)
+static void lru_push(struct shard *shard, struct hash_entry *entry)
 {
-  struct list_entry *walker= root;
+  struct hash_entry **head= &shard->lru_heads[entry->clsid];
 
-  if (root == NULL)
+  entry->prev= NULL;
+  entry->next= *head;
+  if (*head)
   {
-    return NULL;
+    (*head)->prev= entry;
   }
+  *head= entry;
 
-  do
+  if (shard->lru_tails[entry->clsid] == NULL)
   {
-    if (((struct item*)walker)->nkey == nkey &&
-        memcmp(((struct item*)walker)->key, key, nkey) == 0)
+    shard->lru_tails[entry->clsid]= entry;
+  }
+}
+
+/* Move the next few buckets of the old table into the new one */
+static void rehash(struct shard *shard, size_t buckets)
+{
+  while (shard->old.buckets != NULL && buckets-- > 0)
+  {
+    struct hash_entry *entry= shard->old.buckets[shard->rehash_bucket];
+    while (entry != NULL)
+    {
+      struct hash_entry *next= entry->h_next;
+      size_t bucket= entry->hash & (shard->primary.size - 1);
+      entry->h_next= shard->primary.buckets[bucket];
+      shard->primary.buckets[bucket]= entry;
+      entry= next;
+    }
+    shard->old.buckets[shard->rehash_bucket]= NULL;
+
+    if (++shard->rehash_bucket == shard->old.size)
     {
-      return (struct item*)walker;
+      free(shard->old.buckets);
+      shard->old.buckets= NULL;
+      shard->old.size= 0;
     }
-    walker= walker->next;
-  } while (walker != root);
+  }
+}
+
+static void grow(struct shard *shard)
+{
+  struct hash_table table;
+  if (shard->old.buckets != NULL || allocate_table(&table, shard->primary.size * 2) == false)
+  {
+    /* Still rehashing, or out of memory: the chains just get longer */
+    return;
+  }
+
+  shard->old= shard->primary;
+  shard->primary= table;
+  shard->rehash_bucket= 0;
+  shard->expire_bucket= 0;
+}
+
+static struct hash_entry** find_slot(struct shard *shard, const void* key, size_t nkey, uint32_t hash)
+{
+  struct hash_table *tables[]= { &shard->old, &shard->primary };
+
+  for (size_t x= 0; x < sizeof(tables) / sizeof(tables[0]); x++)
+  {
+    struct hash_table *table= tables[x];
+    if (table->buckets == NULL)
+    {
+      continue;
+    }
+
+    struct hash_entry **slot= &table->buckets[hash & (table->size - 1)];
+    while (*slot != NULL)
+    {
+      struct item *item= &(*slot)->item;
+      if ((*slot)->hash == hash && item->nkey == nkey && memcmp(item->key, key, nkey) == 0)
+      {
+        return slot;
+      }
+      slot= &(*slot)->h_next;
+    }
+  }
 
   return NULL;
 }
 
-struct item* create_item(const void* key, size_t nkey, const void* data,
-                         size_t size, uint32_t flags, time_t exp)
+/* Take the item out of the table and the LRU, and drop the table's reference */
+static void unlink_entry(struct shard *shard, struct hash_entry **slot)
 {
-  struct item* ret= (struct item*)calloc(1, sizeof(struct list_entry));
+  struct hash_entry *entry= *slot;
 
-  if (ret != NULL)
+  *slot= entry->h_next;
+  entry->h_next= NULL;
+  lru_unlink(shard, entry);
+  --shard->item_count;
+  --shard->class_items[entry->clsid];
+
+  release_item(&entry->item);
+}
+
+static void unlink_item(struct shard *shard, struct hash_entry *entry)
+{
+  struct hash_entry **slot= find_slot(shard, entry->item.key, entry->item.nkey, entry->hash);
+  if (slot != NULL)
+  {
+    unlink_entry(shard, slot);
+  }
+}
+
+/*
+ * Evict the least recently used item of the class, from the shard if it
+ * has one and otherwise from any other shard which isn't busy. The lock of
+ * the shard is held by the caller, so the others are only tried.
+ */
+static bool evict(struct shard *shard, unsigned int clsid)
+{
+  if (shard->lru_tails[clsid] != NULL)
   {
-    ret->key= malloc(nkey);
-    if (size > 0)
+    unlink_item(shard, shard->lru_tails[clsid]);
+    ++shard->class_evicted[clsid];
+    return true;
+  }
+
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    struct shard *other= &shards[x];
+    if (other == shard || pthread_mutex_trylock(&other->mutex) != 0)
     {
-      ret->data= malloc(size);
+      continue;
     }
 
-    if (ret->key == NULL || (size > 0 && ret->data == NULL))
+    bool evicted= false;
+    if (other->lru_tails[clsid] != NULL)
     {
-      free(ret->key);
-      free(ret->data);
-      free(ret);
-      return NULL;
+      unlink_item(other, other->lru_tails[clsid]);
+      ++other->class_evicted[clsid];
+      evicted= true;
+    }
+    pthread_mutex_unlock(&other->mutex);
+
+    if (evicted)
+    {
+      return true;
     }
+  }
+
+  return false;
+}
 
-    memcpy(ret->key, key, nkey);
-    if (data != NULL)
+/*
+ * Once every page is taken a class only grows by taking a page from
+ * another one, or it would be stuck with the pages it got first. The
+ * least recently used item of the shard gives its page up when it is older
+ * than the class' own: every item of that page is evicted, and the page
+ * moved unless one of them is still referenced or a shard was busy.
+ */
+static bool move_page(struct shard *shard, unsigned int clsid)
+{
+  if (slabs_full() == false)
+  {
+    return false;
+  }
+
+  struct hash_entry *victim= NULL;
+  for (unsigned int id= 1; id <= slabs_largest_clsid(); id++)
+  {
+    struct hash_entry *tail= shard->lru_tails[id];
+    if (id != clsid && tail != NULL && (victim == NULL || tail->atime < victim->atime))
     {
-      memcpy(ret->data, data, size);
+      victim= tail;
     }
+  }
 
-    ret->nkey= nkey;
-    ret->size= size;
-    ret->flags= flags;
-    ret->exp= exp;
+  struct hash_entry *own= shard->lru_tails[clsid];
+  if (victim == NULL || (own != NULL && own->atime <= victim->atime))
+  {
+    return false;
   }
 
-  return ret;
+  unsigned int from= victim->clsid;
+  char *page= slabs_page_of(victim);
+  if (page == NULL)
+  {
+    return false;
+  }
+
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    struct shard *other= &shards[x];
+    if (other != shard && pthread_mutex_trylock(&other->mutex) != 0)
+    {
+      return false;
+    }
+
+    struct hash_entry *entry= other->lru_tails[from];
+    while (entry != NULL)
+    {
+      struct hash_entry *prev= entry->prev;
+      if ((char*)entry >= page && (char*)entry < page + SLAB_PAGE_SIZE)
+      {
+        unlink_item(other, entry);
+        ++other->class_evicted[from];
+      }
+      entry= prev;
+    }
+
+    if (other != shard)
+    {
+      pthread_mutex_unlock(&other->mutex);
+    }
+  }
+
+  return slabs_move_page(page, from, clsid);
 }
 
-bool delete_item(const void* key, size_t nkey)
+bool initialize_storage(size_t limit, unsigned int threads)
 {
-  struct item* item= get_item(key, nkey);
-  bool ret= false;
+  unsigned int power= 0;
+  if (threads > 1)
+  {
+    while (power < MAX_SHARD_POWER && ((size_t)1 << power) < (size_t)threads * SHARDS_PER_THREAD)
+    {
+      ++power;
+    }
+  }
+
+  num_shards= (size_t)1 << power;
+  shard_shift= 32 - power;
+  memory_limit= limit;
 
-  if (item)
+  shards= (struct shard*)calloc(num_shards, sizeof(struct shard));
+  if (shards == NULL || slabs_init(limit) == false)
   {
-    /* remove from linked list */
-    struct list_entry *entry= (struct list_entry*)item;
+    return false;
+  }
+
+  unsigned int hash_power= INITIAL_HASH_POWER - power;
+  if (hash_power < MIN_HASH_POWER)
+  {
+    hash_power= MIN_HASH_POWER;
+  }
 
-    if (entry->next == entry)
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    if (pthread_mutex_init(&shards[x].mutex, NULL) != 0 ||
+        allocate_table(&shards[x].primary, (size_t)1 << hash_power) == false)
     {
-      /* Only one object in the list */
-      root= NULL;
+      return false;
     }
-    else
+  }
+
+  return true;
+}
+
+void shutdown_storage(void)
+{
+  flush(0);
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    free(shards[x].primary.buckets);
+    free(shards[x].old.buckets);
+    pthread_mutex_destroy(&shards[x].mutex);
+  }
+  free(shards);
+  shards= NULL;
+  num_shards= 0;
+  slabs_shutdown();
+}
+
+void lock_key(const void* key, size_t nkey)
+{
+  pthread_mutex_lock(&shard_of(hash_key(key, nkey))->mutex);
+}
+
+void unlock_key(const void* key, size_t nkey)
+{
+  pthread_mutex_unlock(&shard_of(hash_key(key, nkey))->mutex);
+}
+
+void put_item(struct item* item)
+{
+  struct hash_entry* entry= (struct hash_entry*)item;
+  struct shard *shard= shard_of(entry->hash);
+
+  rehash(shard, REHASH_STEP);
+  update_cas(item);
+
+  struct hash_entry **slot= find_slot(shard, item->key, item->nkey, entry->hash);
+  if (slot != NULL)
+  {
+    unlink_entry(shard, slot);
+  }
+
+  size_t bucket= entry->hash & (shard->primary.size - 1);
+  entry->h_next= shard->primary.buckets[bucket];
+  shard->primary.buckets[bucket]= entry;
+  lru_push(shard, entry);
+  entry->time= entry->atime= time(NULL);
+  __atomic_add_fetch(&entry->refcount, 1, __ATOMIC_RELAXED);
+  ++shard->class_items[entry->clsid];
+  ++shard->total_items;
+
+  if (++shard->item_count > shard->primary.size + shard->primary.size / 2)
+  {
+    grow(shard);
+  }
+}
+
+struct item* get_item(const void* key, size_t nkey)
+{
+  uint32_t hash= hash_key(key, nkey);
+  struct shard *shard= shard_of(hash);
+
+  rehash(shard, REHASH_STEP);
+
+  struct hash_entry **slot= find_slot(shard, key, nkey, hash);
+  if (slot == NULL)
+  {
+    return NULL;
+  }
+
+  struct hash_entry *entry= *slot;
+  time_t now= time(NULL);
+  if (is_expired(entry, now))
+  {
+    unlink_entry(shard, slot);
+    return NULL;
+  }
+
+  if (entry != shard->lru_heads[entry->clsid])
+  {
+    lru_unlink(shard, entry);
+    lru_push(shard, entry);
+  }
+  entry->atime= now;
+  __atomic_add_fetch(&entry->refcount, 1, __ATOMIC_RELAXED);
+
+  return &entry->item;
+}
+
+struct item* create_item(const void* key, size_t nkey, const void* data,
+                         size_t size, uint32_t flags, time_t exp)
+{
+  /* The key and the data follow the entry, the data aligned for incr/decr */
+  size_t data_offset= (sizeof(struct hash_entry) + nkey + 7) & ~(size_t)7;
+  size_t total= data_offset + size;
+
+  unsigned int clsid= slabs_clsid(total);
+  if (clsid == 0)
+  {
+    return NULL;
+  }
+
+  /* A page of older items, or else an item of the same class, makes room */
+  uint32_t hash= hash_key(key, nkey);
+  struct hash_entry* entry;
+  while ((entry= (struct hash_entry*)slabs_alloc(clsid)) == NULL)
+  {
+    if (move_page(shard_of(hash), clsid) == false && evict(shard_of(hash), clsid) == false)
     {
-      /* ensure that we don't loose track of the root, and this will
-       * change the start position for the next search ;-) */
-      root= entry->next;
-      entry->prev->next= entry->next;
-      entry->next->prev= entry->prev;
+      return NULL;
     }
+  }
+  memset(entry, 0, sizeof(struct hash_entry));
+  __atomic_add_fetch(&memory_used, total, __ATOMIC_RELAXED);
 
-    free(item->key);
-    free(item->data);
-    free(item);
-    ret= true;
+  struct item* ret= &entry->item;
+  ret->key= (char*)entry + sizeof(struct hash_entry);
+  ret->data= size > 0 ? (char*)entry + data_offset : NULL;
+
+  memcpy(ret->key, key, nkey);
+  if (data != NULL)
+  {
+    memcpy(ret->data, data, size);
   }
 
+  ret->nkey= nkey;
+  ret->size= size;
+  ret->flags= flags;
+  ret->exp= realtime(exp, time(NULL));
+  entry->hash= hash;
+  entry->refcount= 1;
+  entry->total= total;
+  entry->clsid= clsid;
+
   return ret;
 }
 
-void flush(uint32_t /* when */)
+bool delete_item(const void* key, size_t nkey)
 {
-  /* remove the complete linked list */
-  if (root == NULL)
+  uint32_t hash= hash_key(key, nkey);
+  struct shard *shard= shard_of(hash);
+
+  rehash(shard, REHASH_STEP);
+
+  struct hash_entry **slot= find_slot(shard, key, nkey, hash);
+  if (slot == NULL)
   {
+    return false;
+  }
+
+  bool expired= is_expired(*slot, time(NULL));
+  unlink_entry(shard, slot);
+
+  return expired == false;
+}
+
+void flush(uint32_t when)
+{
+  if (when != 0)
+  {
+    /* Everything stored until then goes away then */
+    __atomic_store_n(&oldest_live, realtime((time_t)when, time(NULL)) - 1, __ATOMIC_RELAXED);
     return;
   }
 
-  root->prev->next= NULL;
-  while (root != NULL)
+  __atomic_store_n(&oldest_live, (time_t)0, __ATOMIC_RELAXED);
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    struct shard *shard= &shards[x];
+
+    pthread_mutex_lock(&shard->mutex);
+    for (unsigned int id= 1; id <= MAX_SLAB_CLASSES; id++)
+    {
+      while (shard->lru_tails[id] != NULL)
+      {
+        unlink_item(shard, shard->lru_tails[id]);
+      }
+    }
+    pthread_mutex_unlock(&shard->mutex);
+  }
+}
+
+void expire_items(void)
+{
+  time_t now= time(NULL);
+
+  for (size_t s= 0; s < num_shards; s++)
   {
-    struct item* tmp= (struct item*)root;
-    root= root->next;
+    struct shard *shard= &shards[s];
+
+    pthread_mutex_lock(&shard->mutex);
+    rehash(shard, EXPIRE_STEP);
+
+    for (size_t x= 0; x < EXPIRE_STEP && shard->primary.buckets != NULL; x++)
+    {
+      struct hash_entry **slot= &shard->primary.buckets[shard->expire_bucket];
+      while (*slot != NULL)
+      {
+        if (is_expired(*slot, now))
+        {
+          unlink_entry(shard, slot);
+        }
+        else
+        {
+          slot= &(*slot)->h_next;
+        }
+      }
 
-    free(tmp->key);
-    free(tmp->data);
-    free(tmp);
+      shard->expire_bucket= (shard->expire_bucket + 1) & (shard->primary.size - 1);
+    }
+    pthread_mutex_unlock(&shard->mutex);
   }
 }
 
 void update_cas(struct item* item)
 {
-  item->cas= ++cas;
+  item->cas= __atomic_add_fetch(&cas, 1, __ATOMIC_RELAXED);
 }
 
-void release_item(struct item* /* item */)
+void release_item(struct item* item)
 {
+  struct hash_entry* entry= (struct hash_entry*)item;
+
+  if (__atomic_sub_fetch(&entry->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    free_entry(entry);
+  }
+}
+
+void get_storage_stats(struct storage_stats* stats)
+{
+  memset(stats, 0, sizeof(struct storage_stats));
+
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    struct shard *shard= &shards[x];
+
+    pthread_mutex_lock(&shard->mutex);
+    stats->curr_items+= shard->item_count;
+    stats->total_items+= shard->total_items;
+    for (unsigned int id= 1; id <= MAX_SLAB_CLASSES; id++)
+    {
+      stats->evictions+= shard->class_evicted[id];
+    }
+    pthread_mutex_unlock(&shard->mutex);
+  }
+
+  stats->bytes= __atomic_load_n(&memory_used, __ATOMIC_RELAXED);
+  stats->limit_maxbytes= memory_limit;
+  stats->total_malloced= slabs_total_malloced();
+}
+
+bool get_slab_stats(unsigned int id, struct storage_slab_stats* stats)
+{
+  if (id == 0 || id > slabs_largest_clsid())
+  {
+    return false;
+  }
+
+  slabs_stats(id, stats);
+  stats->items= 0;
+  stats->evicted= 0;
+  for (size_t x= 0; x < num_shards; x++)
+  {
+    struct shard *shard= &shards[x];
+
+    pthread_mutex_lock(&shard->mutex);
+    stats->items+= shard->class_items[id];
+    stats->evicted+= shard->class_evicted[id];
+    pthread_mutex_unlock(&shard->mutex);
+  }
+
+  return true;
 }
@@ -11,9 +11,39 @@ struct item {
   time_t exp;
 };
 
-bool initialize_storage(void);
+struct storage_stats {
+  size_t curr_items;
+  uint64_t total_items;
+  size_t bytes; /* Held by the items themselves */
+  size_t limit_maxbytes;
+  size_t total_malloced; /* Taken by the slabs */
+  uint64_t evictions;
+};
+
+struct storage_slab_stats {
+  size_t chunk_size;
+  size_t chunks_per_page;
+  size_t total_pages;
+  size_t used_chunks;
+  size_t free_chunks;
+  size_t items;
+  uint64_t evicted;
+};
+
+/*
+ * A memory_limit of 0 lets the store grow without bounds. The store is
+ * split in shards when it is shared by more than one thread.
+ */
+bool initialize_storage(size_t memory_limit, unsigned int threads);
 void shutdown_storage(void);
 
+/*
+ * The items of a key may only be created, looked up, stored or deleted
+ * while its lock is held. Nothing else may be locked in the meantime.
+ */
+void lock_key(const void* key, size_t nkey);
+void unlock_key(const void* key, size_t nkey);
+
 void update_cas(struct item* item);
 void put_item(struct item* item);
 struct item* get_item(const void* key, size_t nkey);
@@ -21,4 +51,30 @@ struct item* create_item(const void* key, size_t nkey, const void *data,
                          size_t size, uint32_t flags, time_t exp);
 bool delete_item(const void* key, size_t nkey);
 void flush(uint32_t when);
+void expire_items(void);
+/* Doesn't need the lock of the key */
 void release_item(struct item* item);
+
+void get_storage_stats(struct storage_stats* stats);
+/* false once id is past the last slab class, which starts at 1 */
+bool get_slab_stats(unsigned int id, struct storage_slab_stats* stats);
+
+/* Holds the lock of a key for the rest of the scope */
+class key_lock {
+public:
+  key_lock(const void* key, size_t nkey) :
+    _key(key),
+    _nkey(nkey)
+  {
+    lock_key(_key, _nkey);
+  }
+
+  ~key_lock()
+  {
+    unlock_key(_key, _nkey);
+  }
+
+private:
+  const void* _key;
+  size_t _nkey;
+};
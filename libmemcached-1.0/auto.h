@@ -106,6 +106,46 @@ LIBMEMCACHED_API
                                                              time_t expiration,
                                                              uint64_t *value);
 
+LIBMEMCACHED_API
+  memcached_return_t memcached_mincrement(memcached_st *ptr,
+                                          const char * const *keys,
+                                          const size_t *key_length,
+                                          size_t number_of_keys,
+                                          uint64_t offset,
+                                          uint64_t *values,
+                                          memcached_return_t *results);
+
+LIBMEMCACHED_API
+  memcached_return_t memcached_mdecrement(memcached_st *ptr,
+                                          const char * const *keys,
+                                          const size_t *key_length,
+                                          size_t number_of_keys,
+                                          uint64_t offset,
+                                          uint64_t *values,
+                                          memcached_return_t *results);
+
+LIBMEMCACHED_API
+  memcached_return_t memcached_mincrement_with_initial(memcached_st *ptr,
+                                                       const char * const *keys,
+                                                       const size_t *key_length,
+                                                       size_t number_of_keys,
+                                                       uint64_t offset,
+                                                       uint64_t initial,
+                                                       time_t expiration,
+                                                       uint64_t *values,
+                                                       memcached_return_t *results);
+
+LIBMEMCACHED_API
+  memcached_return_t memcached_mdecrement_with_initial(memcached_st *ptr,
+                                                       const char * const *keys,
+                                                       const size_t *key_length,
+                                                       size_t number_of_keys,
+                                                       uint64_t offset,
+                                                       uint64_t initial,
+                                                       time_t expiration,
+                                                       uint64_t *values,
+                                                       memcached_return_t *results);
+
 #ifdef __cplusplus
 }
 #endif
@@ -43,14 +43,18 @@
 #define MEMCACHED_DEFAULT_PORT_STRING "11211"
 #define MEMCACHED_POINTS_PER_SERVER 100
 #define MEMCACHED_POINTS_PER_SERVER_KETAMA 160
-#define MEMCACHED_CONTINUUM_SIZE MEMCACHED_POINTS_PER_SERVER*100 /* This would then set max hosts to 100 */
+#define MEMCACHED_CONTINUUM_SIZE MEMCACHED_POINTS_PER_SERVER*100 /* Deprecated, the continuum is sized from the servers it holds */
 #define MEMCACHED_STRIDE 4
 #define MEMCACHED_DEFAULT_TIMEOUT 5000
 #define MEMCACHED_DEFAULT_CONNECT_TIMEOUT 4000
-#define MEMCACHED_CONTINUUM_ADDITION 10 /* How many extra slots we should build for in the continuum */
+#define MEMCACHED_CONTINUUM_ADDITION 10 /* How many servers worth of extra points we should build for in the continuum */
 #define MEMCACHED_EXPIRATION_NOT_ADD 0xffffffffU
 #define MEMCACHED_SERVER_FAILURE_LIMIT 5
 #define MEMCACHED_SERVER_FAILURE_RETRY_TIMEOUT 2
 #define MEMCACHED_SERVER_FAILURE_DEAD_TIMEOUT 0
 #define MEMCACHED_SERVER_TIMEOUT_LIMIT 0
+#define MEMCACHED_ZERO_COPY_THRESHOLD 8192 /* Values of this size or larger are sent without being copied into the write buffer */
+#define MEMCACHED_KETAMA_LOOKUP_MAX_BITS 18 /* Largest continuum lookup table is 2^18 +1 buckets */
+#define MEMCACHED_NEAR_CACHE_TTL 2 /* Seconds a value is served from the near cache */
+#define MEMCACHED_EARLY_REFRESH_FLAG 0x80000000U /* Item flags bit reserved for values stored behind an early refresh header */
 
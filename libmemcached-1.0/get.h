@@ -105,6 +105,11 @@ memcached_return_t memcached_mget_execute_by_key(memcached_st *ptr,
                                                  void *context,
                                                  const uint32_t number_of_callbacks);
 
+LIBMEMCACHED_API
+memcached_return_t memcached_single_flight_stats(const memcached_st *ptr,
+                                                 uint64_t *loads,
+                                                 uint64_t *coalesced);
+
 #ifdef __cplusplus
 }
 #endif
@@ -42,5 +42,6 @@
 #define MEMCACHED_MAX_BUFFER 8196
 #define MEMCACHED_MAX_HOST_SORT_LENGTH 86 /* Used for Ketama */
 #define MEMCACHED_MAX_KEY 251 /* We add one to have it null terminated */
+#define MEMCACHED_MAX_HOT_KEYS 256
 #define MEMCACHED_PREFIX_KEY_MAX_SIZE 128
 #define MEMCACHED_VERSION_STRING_LENGTH 24
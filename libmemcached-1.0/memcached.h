@@ -66,6 +66,7 @@
 #include <libmemcached-1.0/types/callback.h>
 #include <libmemcached-1.0/types/connection.h>
 #include <libmemcached-1.0/types/hash.h>
+#include <libmemcached-1.0/types/operation.h>
 #include <libmemcached-1.0/types/return.h>
 #include <libmemcached-1.0/types/server_distribution.h>
 
@@ -106,11 +107,14 @@
 #include <libmemcached-1.0/flush_buffers.h>
 #include <libmemcached-1.0/get.h>
 #include <libmemcached-1.0/hash.h>
+#include <libmemcached-1.0/hot_keys.h>
+#include <libmemcached-1.0/near_cache.h>
 #include <libmemcached-1.0/options.h>
 #include <libmemcached-1.0/parse.h>
 #include <libmemcached-1.0/quit.h>
 #include <libmemcached-1.0/result.h>
 #include <libmemcached-1.0/server.h>
+#include <libmemcached-1.0/server_stats.h>
 #include <libmemcached-1.0/server_list.h>
 #include <libmemcached-1.0/storage.h>
 #include <libmemcached-1.0/strerror.h>
@@ -456,20 +456,36 @@ public:
               time_t expiration,
               uint32_t flags)
   {
-    bool retval= true;
+    std::vector<const char *> real_keys;
+    std::vector<size_t> key_len;
+    std::vector<const char *> real_values;
+    std::vector<size_t> value_len;
+
+    real_keys.reserve(keys.size());
+    key_len.reserve(keys.size());
+    real_values.reserve(keys.size());
+    value_len.reserve(keys.size());
+
     std::vector<std::string>::const_iterator key_it= keys.begin();
     std::vector< std::vector<char> *>::const_iterator val_it= values.begin();
     while (key_it != keys.end())
     {
-      retval= set((*key_it), *(*val_it), expiration, flags);
-      if (retval == false)
-      {
-        return retval;
-      }
+      real_keys.push_back((*key_it).c_str());
+      key_len.push_back((*key_it).length());
+      real_values.push_back((*val_it)->empty() ? NULL : &(*(*val_it))[0]);
+      value_len.push_back((*val_it)->size());
       ++key_it;
       ++val_it;
     }
-    return retval;
+
+    if (real_keys.empty())
+    {
+      return true;
+    }
+
+    return memcached_success(memcached_mset(memc_, &real_keys[0], &key_len[0],
+                                            &real_values[0], &value_len[0], real_keys.size(),
+                                            expiration, flags, NULL));
   }
 
   /**
@@ -485,21 +501,34 @@ public:
               time_t expiration,
               uint32_t flags)
   {
-    bool retval= true;
-    std::map<const std::string, std::vector<char> >::const_iterator it= key_value_map.begin();
+    std::vector<const char *> real_keys;
+    std::vector<size_t> key_len;
+    std::vector<const char *> real_values;
+    std::vector<size_t> value_len;
 
+    real_keys.reserve(key_value_map.size());
+    key_len.reserve(key_value_map.size());
+    real_values.reserve(key_value_map.size());
+    value_len.reserve(key_value_map.size());
+
+    std::map<const std::string, std::vector<char> >::const_iterator it= key_value_map.begin();
     while (it != key_value_map.end())
     {
-      retval= set(it->first, it->second, expiration, flags);
-      if (retval == false)
-      {
-        // We should tell the user what the key that failed was
-        return false;
-      }
+      real_keys.push_back(it->first.c_str());
+      key_len.push_back(it->first.length());
+      real_values.push_back(it->second.empty() ? NULL : &it->second[0]);
+      value_len.push_back(it->second.size());
       ++it;
     }
 
-    return true;
+    if (real_keys.empty())
+    {
+      return true;
+    }
+
+    return memcached_success(memcached_mset(memc_, &real_keys[0], &key_len[0],
+                                            &real_values[0], &value_len[0], real_keys.size(),
+                                            expiration, flags, NULL));
   }
 
   /**
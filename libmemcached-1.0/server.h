@@ -65,6 +65,9 @@ void memcached_server_free(memcached_server_st *ptr);
 LIBMEMCACHED_API
 const memcached_instance_st * memcached_server_get_last_disconnect(const memcached_st *ptr);
 
+LIBMEMCACHED_API
+memcached_return_t memcached_connect_all(memcached_st *ptr);
+
 
 LIBMEMCACHED_API
 memcached_return_t memcached_server_add_udp(memcached_st *ptr,
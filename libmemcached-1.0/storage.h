@@ -126,6 +126,34 @@ memcached_return_t memcached_cas_by_key(memcached_st *ptr,
                                         uint32_t flags,
                                         uint64_t cas);
 
+/*
+  Store many objects with a single round trip per server. If results is not
+  NULL it receives the outcome for each key, in the same order as keys.
+*/
+LIBMEMCACHED_API
+memcached_return_t memcached_mset(memcached_st *ptr,
+                                  const char * const *keys,
+                                  const size_t *key_length,
+                                  const char * const *values,
+                                  const size_t *value_length,
+                                  size_t number_of_keys,
+                                  time_t expiration,
+                                  uint32_t flags,
+                                  memcached_return_t *results);
+
+LIBMEMCACHED_API
+memcached_return_t memcached_mset_by_key(memcached_st *ptr,
+                                         const char *group_key,
+                                         size_t group_key_length,
+                                         const char * const *keys,
+                                         const size_t *key_length,
+                                         const char * const *values,
+                                         const size_t *value_length,
+                                         size_t number_of_keys,
+                                         time_t expiration,
+                                         uint32_t flags,
+                                         memcached_return_t *results);
+
 #ifdef __cplusplus
 }
 #endif
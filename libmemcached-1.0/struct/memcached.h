@@ -65,6 +65,9 @@ struct memcached_st {
     bool tcp_keepalive:1;
     bool is_aes:1;
     bool is_fetching_version:1;
+    bool zero_copy:1;
+    bool ketama_lookup_table:1;
+    bool server_stats:1;
     bool not_used:1;
   } flags;
 
@@ -80,9 +83,11 @@ struct memcached_st {
   int32_t rcv_timeout;
   uint32_t server_failure_limit;
   uint32_t server_timeout_limit;
+  uint32_t latency_eject_factor; // Eject a server this many times slower than the others, 0 when disabled
   uint32_t io_msg_watermark;
   uint32_t io_bytes_watermark;
   uint32_t io_key_prefetch;
+  uint32_t io_zero_copy_threshold;
   uint32_t tcp_keepidle;
   int32_t poll_timeout;
   int32_t connect_timeout; // How long we will wait on connect() before we will timeout
@@ -90,19 +95,59 @@ struct memcached_st {
   int32_t dead_timeout;
   int send_size;
   int recv_size;
+  int epoll_fd; // Readiness set used by memcached_io_get_readable_server()
   void *user_data;
   uint64_t query_id;
   uint32_t number_of_replicas;
+  uint32_t early_refresh; // XFetch beta in hundredths, 0 when disabled
   memcached_result_st result;
 
   struct {
     bool weighted_;
-    uint32_t continuum_count; // Ketama
+    uint32_t continuum_count; // Ketama, points allocated
     uint32_t continuum_points_counter; // Ketama
     time_t next_distribution_rebuild; // Ketama
     struct memcached_continuum_item_st *continuum; // Ketama
+    uint32_t lookup_bits; // Ketama, top bits of the hash used to index lookup
+    uint32_t *lookup; // Ketama, first continuum point of each bucket
+    uint32_t points_version; // Ketama, bumped when the points cached per server go stale
+    uint32_t continuum_version; // Ketama, points_version the continuum was built from
   } ketama;
 
+  struct {
+    struct memcached_near_cache_st *cache; // Shared with every clone
+    uint64_t budget;
+    uint32_t ttl;
+    struct memcached_near_cache_entry_st **hits; // Found by the last mget and not fetched yet
+    uint32_t hits_count;
+    uint32_t hits_fetched;
+    const char **miss_keys; // Keys of the last mget left for the servers
+    size_t *miss_key_length;
+    uint32_t size; // Keys the arrays above have room for
+    uint64_t sent; // The cache's invalidation count when the last mget was sent
+  } near_cache;
+
+  struct {
+    struct memcached_hot_keys_st *tracker; // Shared with every clone
+    uint32_t additions; // Keys recorded by this handle and not yet added to the tracker's total
+  } hot_keys;
+
+  struct {
+    struct memcached_hot_replicas_st *table; // Shared with every clone
+    uint32_t replicas;
+    uint32_t threshold;
+    uint32_t next; // Round robin over the copies of a key
+    bool read_replica; // The last get was sent to a replica
+    bool read_primary; // Ignore the replicas while retrying a get
+  } hot_replicas;
+
+  struct memcached_dns_st *dns; // Resolved server addresses, shared with every clone
+
+  struct {
+    uint32_t percentile; // Ask a replica once a get is slower than this percentile, 0 when disabled
+    struct memcached_hedge_st *mget; // Keys of the last mget, kept while it is fetched
+  } hedge;
+
   struct memcached_virtual_bucket_t *virtual_bucket;
 
   struct memcached_allocator_t allocators;
@@ -112,6 +157,7 @@ struct memcached_st {
   memcached_trigger_key_fn get_key_failure;
   memcached_trigger_delete_key_fn delete_trigger;
   memcached_callback_st *callbacks;
+  struct memcached_single_flight_st *single_flight; // Shared with every clone
   struct memcached_sasl_st sasl;
   struct memcached_error_t *error_messages;
   struct memcached_array_st *_namespace;
@@ -43,6 +43,9 @@
 struct memcached_st;
 struct memcached_stat_st;
 struct memcached_analysis_st;
+struct memcached_near_cache_stat_st;
+struct memcached_hot_key_st;
+struct memcached_server_stats_st;
 struct memcached_result_st;
 struct memcached_array_st;
 struct memcached_error_t;
@@ -65,6 +68,9 @@ struct memcached_continuum_item_st;
 typedef struct memcached_st memcached_st;
 typedef struct memcached_stat_st memcached_stat_st;
 typedef struct memcached_analysis_st memcached_analysis_st;
+typedef struct memcached_near_cache_stat_st memcached_near_cache_stat_st;
+typedef struct memcached_hot_key_st memcached_hot_key_st;
+typedef struct memcached_server_stats_st memcached_server_stats_st;
 typedef struct memcached_result_st memcached_result_st;
 typedef struct memcached_array_st memcached_array_st;
 typedef struct memcached_error_t memcached_error_t;
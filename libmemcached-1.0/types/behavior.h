@@ -77,6 +77,20 @@ enum memcached_behavior_t {
   MEMCACHED_BEHAVIOR_REMOVE_FAILED_SERVERS,
   MEMCACHED_BEHAVIOR_DEAD_TIMEOUT,
   MEMCACHED_BEHAVIOR_SERVER_TIMEOUT_LIMIT,
+  MEMCACHED_BEHAVIOR_ZERO_COPY,
+  MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD,
+  MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE,
+  MEMCACHED_BEHAVIOR_SINGLE_FLIGHT,
+  MEMCACHED_BEHAVIOR_EARLY_REFRESH,
+  MEMCACHED_BEHAVIOR_NEAR_CACHE,
+  MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL,
+  MEMCACHED_BEHAVIOR_HOT_KEYS,
+  MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS,
+  MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD,
+  MEMCACHED_BEHAVIOR_DNS_CACHE_TTL,
+  MEMCACHED_BEHAVIOR_SERVER_STATS,
+  MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR,
+  MEMCACHED_BEHAVIOR_HEDGED_READS,
   MEMCACHED_BEHAVIOR_MAX
 };
 
@@ -72,7 +72,8 @@ static memcached_return_t text_incr_decr(memcached_instance_st* instance,
                                          const bool is_incr,
                                          const char *key, size_t key_length,
                                          const uint64_t offset,
-                                         const bool reply)
+                                         const bool reply,
+                                         const bool should_flush= true)
 {
   char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
 
@@ -99,7 +100,12 @@ static memcached_return_t text_incr_decr(memcached_instance_st* instance,
     vector[1].buffer= "decr ";
   }
 
-  return memcached_vdo(instance, vector, 7, true);
+  if (reply and should_flush)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_INCR);
+  }
+
+  return memcached_vdo(instance, vector, 7, should_flush);
 }
 
 static memcached_return_t binary_incr_decr(memcached_instance_st* instance,
@@ -108,7 +114,9 @@ static memcached_return_t binary_incr_decr(memcached_instance_st* instance,
                                            const uint64_t offset,
                                            const uint64_t initial,
                                            const uint32_t expiration,
-                                           const bool reply)
+                                           const bool reply,
+                                           const uint32_t *opaque= NULL,
+                                           const bool should_flush= true)
 {
   if (reply == false)
   {
@@ -125,6 +133,10 @@ static memcached_return_t binary_incr_decr(memcached_instance_st* instance,
   protocol_binary_request_incr request= {}; // = {.bytes= {0}};
 
   initialize_binary_request(instance, request.message.header);
+  if (opaque)
+  {
+    request.message.header.request.opaque= htonl(*opaque);
+  }
 
   request.message.header.request.opcode= cmd;
   request.message.header.request.keylen= htons((uint16_t)(key_length + memcached_array_size(instance->root->_namespace)));
@@ -143,7 +155,12 @@ static memcached_return_t binary_incr_decr(memcached_instance_st* instance,
     { key, key_length }
   };
 
-  return memcached_vdo(instance, vector, 4, true);
+  if (reply and should_flush)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_INCR);
+  }
+
+  return memcached_vdo(instance, vector, 4, should_flush);
 }
 
 memcached_return_t memcached_increment(memcached_st *memc,
@@ -183,9 +200,11 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
   {
     return memcached_last_error(memc);
   }
+  memcached_near_cache_invalidate(memc, key, key_length);
 
   uint32_t server_key= memcached_generate_hash_with_redistribution(memc, group_key, group_key_length);
   memcached_instance_st* instance= memcached_instance_fetch(memc, server_key);
+  memcached_hot_replicas_changed(memc, server_key, key, key_length, true);
 
   bool reply= memcached_is_replying(instance->root);
 
@@ -206,6 +225,9 @@ static memcached_return_t increment_decrement_by_key(const protocol_binary_comma
 
   auto_response(instance, reply, rc, value);
 
+  // A read answered before the server applied the change may have cached the old value
+  memcached_near_cache_invalidate(memc, key, key_length);
+
   return rc;
 }
 
@@ -242,9 +264,11 @@ static memcached_return_t increment_decrement_with_initial_by_key(const protocol
   {
     return memcached_last_error(memc);
   }
+  memcached_near_cache_invalidate(memc, key, key_length);
 
   uint32_t server_key= memcached_generate_hash_with_redistribution(memc, group_key, group_key_length);
   memcached_instance_st* instance= memcached_instance_fetch(memc, server_key);
+  memcached_hot_replicas_changed(memc, server_key, key, key_length, true);
 
   bool reply= memcached_is_replying(instance->root);
 
@@ -264,6 +288,9 @@ static memcached_return_t increment_decrement_with_initial_by_key(const protocol
 
   auto_response(instance, reply, rc, value);
 
+  // A read answered before the server applied the change may have cached the old value
+  memcached_near_cache_invalidate(memc, key, key_length);
+
   return rc;
 }
 
@@ -383,3 +410,186 @@ memcached_return_t memcached_decrement_with_initial_by_key(memcached_st *shell,
 
   return rc;
 }
+
+struct mincrement_context_st
+{
+  protocol_binary_command command;
+  const char * const *keys;
+  const size_t *key_length;
+  uint64_t offset;
+  uint64_t initial;
+  uint32_t expiration;
+  uint64_t *values;
+};
+
+static memcached_return_t mincrement_send(Memcached *memc,
+                                          memcached_instance_st* instance,
+                                          uint32_t server_key,
+                                          uint32_t position,
+                                          bool reply,
+                                          void *context)
+{
+  mincrement_context_st *mincrement= static_cast<mincrement_context_st *>(context);
+  memcached_hot_replicas_changed(memc, server_key,
+                                 mincrement->keys[position], mincrement->key_length[position], false);
+
+  // Every reply carries the new value, so only noreply uses the quiet commands
+  if (memcached_is_binary(memc))
+  {
+    return binary_incr_decr(instance, mincrement->command,
+                            mincrement->keys[position], mincrement->key_length[position],
+                            mincrement->offset, mincrement->initial, mincrement->expiration,
+                            reply, &position, false);
+  }
+
+  return text_incr_decr(instance,
+                        mincrement->command == PROTOCOL_BINARY_CMD_INCREMENT ? true : false,
+                        mincrement->keys[position], mincrement->key_length[position],
+                        mincrement->offset, reply, false);
+}
+
+static memcached_return_t mincrement_response(Memcached *,
+                                              uint32_t position,
+                                              memcached_return_t rc,
+                                              memcached_result_st *result,
+                                              void *context)
+{
+  mincrement_context_st *mincrement= static_cast<mincrement_context_st *>(context);
+
+  if (memcached_success(rc) and mincrement->values)
+  {
+    mincrement->values[position]= result->numeric_value;
+  }
+
+  return rc;
+}
+
+static memcached_return_t mincrement_decrement(const protocol_binary_command command,
+                                               Memcached *memc,
+                                               const char * const *keys,
+                                               const size_t *key_length,
+                                               size_t number_of_keys,
+                                               uint64_t offset,
+                                               uint64_t initial,
+                                               uint32_t expiration,
+                                               uint64_t *values,
+                                               memcached_return_t *results)
+{
+  if (memc == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (memcached_is_encrypted(memc))
+  {
+    return memcached_set_error(*memc, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT, 
+                               memcached_literal_param("Operation not allowed while encyrption is enabled"));
+  }
+
+  if (expiration != MEMCACHED_EXPIRATION_NOT_ADD and memcached_is_binary(memc) == false)
+  {
+    return memcached_set_error(*memc, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("memcached_mincrement_with_initial() is not supported via the ASCII protocol"));
+  }
+
+  // Keys that fail, or are sent without a reply, have no new value
+  if (values)
+  {
+    for (size_t x= 0; x < number_of_keys; ++x)
+    {
+      values[x]= UINT64_MAX;
+    }
+  }
+
+  mincrement_context_st context= { command, keys, key_length, offset, initial, expiration, values };
+
+  memcached_batch_st batch;
+  batch.send= mincrement_send;
+  batch.response= mincrement_response;
+  batch.context= &context;
+  batch.reply= memcached_is_replying(memc);
+
+  return memcached_batch(memc, NULL, 0,
+                         keys, key_length, number_of_keys,
+                         batch, results);
+}
+
+memcached_return_t memcached_mincrement(memcached_st *shell,
+                                        const char * const *keys,
+                                        const size_t *key_length,
+                                        size_t number_of_keys,
+                                        uint64_t offset,
+                                        uint64_t *values,
+                                        memcached_return_t *results)
+{
+  LIBMEMCACHED_MEMCACHED_INCREMENT_START();
+  memcached_return_t rc= mincrement_decrement(PROTOCOL_BINARY_CMD_INCREMENT,
+                                              memcached2Memcached(shell),
+                                              keys, key_length, number_of_keys,
+                                              offset, 0, MEMCACHED_EXPIRATION_NOT_ADD,
+                                              values, results);
+  LIBMEMCACHED_MEMCACHED_INCREMENT_END();
+
+  return rc;
+}
+
+memcached_return_t memcached_mdecrement(memcached_st *shell,
+                                        const char * const *keys,
+                                        const size_t *key_length,
+                                        size_t number_of_keys,
+                                        uint64_t offset,
+                                        uint64_t *values,
+                                        memcached_return_t *results)
+{
+  LIBMEMCACHED_MEMCACHED_DECREMENT_START();
+  memcached_return_t rc= mincrement_decrement(PROTOCOL_BINARY_CMD_DECREMENT,
+                                              memcached2Memcached(shell),
+                                              keys, key_length, number_of_keys,
+                                              offset, 0, MEMCACHED_EXPIRATION_NOT_ADD,
+                                              values, results);
+  LIBMEMCACHED_MEMCACHED_DECREMENT_END();
+
+  return rc;
+}
+
+memcached_return_t memcached_mincrement_with_initial(memcached_st *shell,
+                                                     const char * const *keys,
+                                                     const size_t *key_length,
+                                                     size_t number_of_keys,
+                                                     uint64_t offset,
+                                                     uint64_t initial,
+                                                     time_t expiration,
+                                                     uint64_t *values,
+                                                     memcached_return_t *results)
+{
+  LIBMEMCACHED_MEMCACHED_INCREMENT_WITH_INITIAL_START();
+  memcached_return_t rc= mincrement_decrement(PROTOCOL_BINARY_CMD_INCREMENT,
+                                              memcached2Memcached(shell),
+                                              keys, key_length, number_of_keys,
+                                              offset, initial, uint32_t(expiration),
+                                              values, results);
+  LIBMEMCACHED_MEMCACHED_INCREMENT_WITH_INITIAL_END();
+
+  return rc;
+}
+
+memcached_return_t memcached_mdecrement_with_initial(memcached_st *shell,
+                                                     const char * const *keys,
+                                                     const size_t *key_length,
+                                                     size_t number_of_keys,
+                                                     uint64_t offset,
+                                                     uint64_t initial,
+                                                     time_t expiration,
+                                                     uint64_t *values,
+                                                     memcached_return_t *results)
+{
+  LIBMEMCACHED_MEMCACHED_INCREMENT_WITH_INITIAL_START();
+  memcached_return_t rc= mincrement_decrement(PROTOCOL_BINARY_CMD_DECREMENT,
+                                              memcached2Memcached(shell),
+                                              keys, key_length, number_of_keys,
+                                              offset, initial, uint32_t(expiration),
+                                              values, results);
+  LIBMEMCACHED_MEMCACHED_INCREMENT_WITH_INITIAL_END();
+
+  return rc;
+}
@@ -0,0 +1,362 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <libmemcached/common.h>
+
+/*
+  Keys are sent in windows of at most io_msg_watermark keys per server. The
+  responses to a window are read before the next one is sent, so neither side
+  can fill its socket buffers, and memcached_purge() is held off while a
+  window is being written so that it does not throw away the statuses we are
+  collecting.
+
+  The response count of each instance is kept at zero while a window is
+  written and raised by one before every read, whether or not the commands
+  themselves are answered.
+*/
+#define BATCH_END_OF_LIST UINT32_MAX
+
+static void batch_fail_window(memcached_return_t *results,
+                              const uint32_t *next,
+                              uint32_t position, const uint32_t end,
+                              const memcached_return_t rc)
+{
+  for (; position != end; position= next[position])
+  {
+    if (memcached_success(results[position]))
+    {
+      results[position]= rc;
+    }
+  }
+}
+
+static memcached_return_t batch_send_fence(memcached_instance_st* instance)
+{
+  protocol_binary_request_noop request= {};
+  initialize_binary_request(instance, request.message.header);
+  request.message.header.request.opcode= PROTOCOL_BINARY_CMD_NOOP;
+  request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { request.bytes, sizeof(request.bytes) }
+  };
+
+  memcached_return_t rc;
+  if (memcached_failed(rc= memcached_vdo(instance, vector, 1, true)))
+  {
+    memcached_io_reset(instance);
+    return rc;
+  }
+
+  if (memcached_is_replying(instance->root))
+  {
+    memcached_server_response_decrement(instance);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t batch_read_window(Memcached *ptr,
+                                            memcached_instance_st* instance,
+                                            memcached_batch_st& batch,
+                                            memcached_return_t *results,
+                                            const uint32_t *next,
+                                            const size_t number_of_keys,
+                                            uint32_t position, const uint32_t end)
+{
+  if (memcached_is_binary(ptr))
+  {
+    while (true)
+    {
+      uint32_t opaque;
+      memcached_server_response_increment(instance);
+      memcached_return_t rc= memcached_read_one_response(instance, &ptr->result, opaque);
+
+      // The NOOP fence, everything we have not heard about has succeeded
+      if (rc == MEMCACHED_END)
+      {
+        return MEMCACHED_SUCCESS;
+      }
+
+      if (opaque < number_of_keys)
+      {
+        results[opaque]= batch.response(ptr, opaque, rc, &ptr->result, batch.context);
+      }
+
+      if (memcached_fatal(rc))
+      {
+        // The connection is gone, the outcome of the rest of the window is unknown
+        batch_fail_window(results, next, position, end, rc);
+        return rc;
+      }
+    }
+  }
+
+  for (; position != end; position= next[position])
+  {
+    // Nothing was sent for a key that failed to be written
+    if (memcached_failed(results[position]))
+    {
+      continue;
+    }
+
+    memcached_server_response_increment(instance);
+    memcached_return_t rc= memcached_read_one_response(instance, &ptr->result);
+    results[position]= batch.response(ptr, position, rc, &ptr->result, batch.context);
+
+    if (memcached_fatal(rc))
+    {
+      results[position]= rc;
+      batch_fail_window(results, next, next[position], end, rc);
+      return rc;
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_batch(Memcached *ptr,
+                                   const char *group_key, size_t group_key_length,
+                                   const char * const *keys,
+                                   const size_t *key_length,
+                                   size_t number_of_keys,
+                                   memcached_batch_st& batch,
+                                   memcached_return_t *results)
+{
+  memcached_return_t rc;
+  if (memcached_failed(rc= initialize_query(ptr, true)))
+  {
+    return rc;
+  }
+
+  if (memcached_is_udp(ptr))
+  {
+    return memcached_set_error(*ptr, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
+  }
+
+  if (number_of_keys >= BATCH_END_OF_LIST)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Too many keys"));
+  }
+
+  if (memcached_failed(memcached_key_test(*ptr, keys, key_length, number_of_keys)))
+  {
+    return memcached_last_error(ptr);
+  }
+
+  for (size_t x= 0; ptr->near_cache.cache and x < number_of_keys; ++x)
+  {
+    memcached_near_cache_invalidate(ptr, keys[x], key_length[x]);
+  }
+
+  if (group_key and group_key_length)
+  {
+    if (memcached_failed(memcached_key_test(*ptr, (const char **)&group_key, &group_key_length, 1)))
+    {
+      return memcached_last_error(ptr);
+    }
+  }
+
+  const uint32_t server_count= memcached_server_count(ptr);
+  uint32_t *next= libmemcached_xcalloc(ptr, number_of_keys +(server_count *4), uint32_t);
+  memcached_return_t *collected= results;
+  if (collected == NULL)
+  {
+    collected= libmemcached_xcalloc(ptr, number_of_keys, memcached_return_t);
+  }
+
+  if (next == NULL or collected == NULL)
+  {
+    libmemcached_free(ptr, next);
+    if (collected != results)
+    {
+      libmemcached_free(ptr, collected);
+    }
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  // Per server: the first and last key, the next key to send, and the start of the current window
+  uint32_t *head= next +number_of_keys;
+  uint32_t *tail= head +server_count;
+  uint32_t *cursor= tail +server_count;
+  uint32_t *window= cursor +server_count;
+
+  for (uint32_t x= 0; x < server_count; ++x)
+  {
+    head[x]= tail[x]= BATCH_END_OF_LIST;
+  }
+
+  for (uint32_t x= 0; x < number_of_keys; ++x)
+  {
+    uint32_t server_key;
+    if (group_key and group_key_length)
+    {
+      server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
+    }
+    else
+    {
+      server_key= memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
+    }
+
+    collected[x]= MEMCACHED_SUCCESS;
+    next[x]= BATCH_END_OF_LIST;
+    if (head[server_key] == BATCH_END_OF_LIST)
+    {
+      head[server_key]= x;
+    }
+    else
+    {
+      next[tail[server_key]]= x;
+    }
+    tail[server_key]= x;
+  }
+
+  for (uint32_t x= 0; x < server_count; ++x)
+  {
+    cursor[x]= head[x];
+  }
+
+  const bool is_replying= memcached_is_replying(ptr);
+  const uint32_t window_size= ptr->io_msg_watermark ? ptr->io_msg_watermark : 1;
+
+  bool pending= true;
+  while (pending)
+  {
+    pending= false;
+
+    memcached_set_purging(ptr, true);
+    for (uint32_t x= 0; x < server_count; ++x)
+    {
+      window[x]= cursor[x];
+      if (cursor[x] == BATCH_END_OF_LIST)
+      {
+        continue;
+      }
+
+      memcached_instance_st* instance= memcached_instance_fetch(ptr, x);
+      for (uint32_t sent= 0; sent < window_size and cursor[x] != BATCH_END_OF_LIST; ++sent, cursor[x]= next[cursor[x]])
+      {
+        uint32_t position= cursor[x];
+        rc= batch.send(ptr, instance, x, position, batch.reply, batch.context);
+
+        if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+        {
+          if (is_replying)
+          {
+            memcached_server_response_decrement(instance);
+          }
+          continue;
+        }
+
+        collected[position]= rc;
+        if (memcached_fatal(rc))
+        {
+          // Whatever was written before went down with the connection
+          batch_fail_window(collected, next, window[x], position, rc);
+        }
+      }
+
+      if (cursor[x] != BATCH_END_OF_LIST)
+      {
+        pending= true;
+      }
+
+      if (batch.reply and memcached_is_binary(ptr))
+      {
+        if (memcached_failed(rc= batch_send_fence(instance)))
+        {
+          batch_fail_window(collected, next, window[x], cursor[x], rc);
+          window[x]= cursor[x];
+        }
+      }
+      else if (instance->fd != INVALID_SOCKET and memcached_io_write(instance) == false)
+      {
+        memcached_io_reset(instance);
+        batch_fail_window(collected, next, window[x], cursor[x], MEMCACHED_WRITE_FAILURE);
+        window[x]= cursor[x];
+      }
+    }
+    memcached_set_purging(ptr, false);
+
+    // Replicas only ever see quiet commands, they just need to be flushed
+    if (ptr->number_of_replicas or ptr->hot_replicas.table)
+    {
+      (void)memcached_flush_buffers(ptr);
+    }
+
+    if (batch.reply == false)
+    {
+      continue;
+    }
+
+    for (uint32_t x= 0; x < server_count; ++x)
+    {
+      if (window[x] != cursor[x])
+      {
+        (void)batch_read_window(ptr, memcached_instance_fetch(ptr, x), batch,
+                                collected, next, number_of_keys,
+                                window[x], cursor[x]);
+      }
+    }
+  }
+
+  // Reads answered before the server applied the batch may have cached old values
+  for (size_t x= 0; ptr->near_cache.cache and x < number_of_keys; ++x)
+  {
+    memcached_near_cache_invalidate(ptr, keys[x], key_length[x]);
+  }
+
+  rc= MEMCACHED_SUCCESS;
+  for (uint32_t x= 0; x < number_of_keys; ++x)
+  {
+    if (memcached_failed(collected[x]))
+    {
+      rc= MEMCACHED_SOME_ERRORS;
+      break;
+    }
+  }
+
+  libmemcached_free(ptr, next);
+  if (collected != results)
+  {
+    libmemcached_free(ptr, collected);
+  }
+
+  return rc;
+}
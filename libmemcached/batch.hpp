@@ -0,0 +1,80 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+/*
+  Runs one command over many keys. The keys are grouped per server and
+  pipelined, each binary window is fenced with a NOOP, and the outcome of
+  every key is collected by its position in the keys array.
+*/
+struct memcached_batch_st
+{
+  /*
+    Write, without flushing, the command for keys[position]. Binary commands
+    must carry htonl(position) as their opaque. When reply is false the
+    command must not be answered (quiet opcodes or "noreply").
+  */
+  memcached_return_t (*send)(Memcached *ptr,
+                             memcached_instance_st* instance,
+                             uint32_t server_key,
+                             uint32_t position,
+                             bool reply,
+                             void *context);
+
+  /*
+    Turn a response read for keys[position] into the status recorded for it.
+    The result holds any value or number that came with the response.
+  */
+  memcached_return_t (*response)(Memcached *ptr,
+                                 uint32_t position,
+                                 memcached_return_t rc,
+                                 memcached_result_st *result,
+                                 void *context);
+
+  void *context;
+
+  // Read responses, false when the commands are sent without replies
+  bool reply;
+};
+
+memcached_return_t memcached_batch(Memcached *ptr,
+                                   const char *group_key, size_t group_key_length,
+                                   const char * const *keys,
+                                   const size_t *key_length,
+                                   size_t number_of_keys,
+                                   memcached_batch_st& batch,
+                                   memcached_return_t *results);
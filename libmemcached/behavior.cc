@@ -120,6 +120,25 @@ memcached_return_t memcached_behavior_set(memcached_st *shell,
     ptr->server_timeout_limit= uint32_t(data);
     break;
 
+  case MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR:
+    if (data == 1 or data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR must be 0 or more than 1."));
+    }
+    ptr->latency_eject_factor= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READS:
+    if (data > 100)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_HEDGED_READS must be a percentile from 0 to 100."));
+    }
+    memcached_hedge_reset(ptr);
+    ptr->hedge.percentile= uint32_t(data);
+    break;
+
   case MEMCACHED_BEHAVIOR_BINARY_PROTOCOL:
     send_quit(ptr); // We need t shutdown all of the connections to make sure we do the correct protocol
     if (data)
@@ -292,6 +311,148 @@ memcached_return_t memcached_behavior_set(memcached_st *shell,
       return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
                                  memcached_literal_param("MEMCACHED_BEHAVIOR_LOAD_FROM_FILE can not be set with memcached_behavior_set()"));
 
+  case MEMCACHED_BEHAVIOR_ZERO_COPY:
+    ptr->flags.zero_copy= bool(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD:
+    if (data == 0)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD requires a value greater then zero."));
+    }
+    ptr->io_zero_copy_threshold= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE:
+    ptr->flags.ketama_lookup_table= bool(data);
+    return run_distribution(ptr);
+
+  case MEMCACHED_BEHAVIOR_SINGLE_FLIGHT:
+    if (bool(data))
+    {
+      return memcached_single_flight_create(ptr);
+    }
+    memcached_single_flight_release(ptr);
+    break;
+
+  case MEMCACHED_BEHAVIOR_EARLY_REFRESH:
+    if (data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_EARLY_REFRESH is out of range."));
+    }
+    ptr->early_refresh= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE:
+    if (data == 0)
+    {
+      memcached_near_cache_free(ptr);
+      break;
+    }
+
+    if (ptr->near_cache.cache and ptr->near_cache.budget == data)
+    {
+      break;
+    }
+    return memcached_near_cache_create(ptr, data);
+
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL:
+    if (data == 0 or data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL requires a value greater then zero."));
+    }
+    ptr->near_cache.ttl= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_HOT_KEYS:
+    if (data > MEMCACHED_MAX_HOT_KEYS)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_HOT_KEYS can not track more than MEMCACHED_MAX_HOT_KEYS keys."));
+    }
+
+    if (data == 0)
+    {
+      memcached_hot_keys_free(ptr);
+      break;
+    }
+
+    if (memcached_hot_keys_size(ptr) == data)
+    {
+      break;
+    }
+    return memcached_hot_keys_create(ptr, uint32_t(data));
+
+  case MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS:
+    if (data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS must fit in 32 bits."));
+    }
+
+    if (data == 0)
+    {
+      memcached_hot_replicas_free(ptr);
+    }
+    else if (ptr->hot_replicas.table == NULL)
+    {
+      memcached_return_t rc;
+      if (memcached_failed(rc= memcached_hot_replicas_create(ptr)))
+      {
+        return rc;
+      }
+    }
+    ptr->hot_replicas.replicas= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD:
+    if (data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD must fit in 32 bits."));
+    }
+    ptr->hot_replicas.threshold= uint32_t(data);
+    break;
+
+  case MEMCACHED_BEHAVIOR_DNS_CACHE_TTL:
+    if (data > UINT32_MAX)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                                 memcached_literal_param("MEMCACHED_BEHAVIOR_DNS_CACHE_TTL must fit in 32 bits."));
+    }
+
+    if (data == 0)
+    {
+      memcached_dns_free(ptr);
+    }
+    else if (ptr->dns == NULL)
+    {
+      memcached_return_t rc;
+      if (memcached_failed(rc= memcached_dns_create(ptr, uint32_t(data))))
+      {
+        return rc;
+      }
+    }
+    else
+    {
+      memcached_dns_ttl(ptr, uint32_t(data));
+    }
+    break;
+
+  case MEMCACHED_BEHAVIOR_SERVER_STATS:
+    ptr->flags.server_stats= bool(data);
+    if (ptr->flags.server_stats == false)
+    {
+      for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+      {
+        memcached_server_stats_free(memcached_instance_fetch(ptr, x));
+      }
+    }
+    break;
+
   case MEMCACHED_BEHAVIOR_MAX:
   default:
       /* Shouldn't get here */
@@ -381,6 +542,12 @@ uint64_t memcached_behavior_get(memcached_st *shell,
   case MEMCACHED_BEHAVIOR_SERVER_TIMEOUT_LIMIT:
     return ptr->server_timeout_limit;
 
+  case MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR:
+    return ptr->latency_eject_factor;
+
+  case MEMCACHED_BEHAVIOR_HEDGED_READS:
+    return ptr->hedge.percentile;
+
   case MEMCACHED_BEHAVIOR_SORT_HOSTS:
     return ptr->flags.use_sort_hosts;
 
@@ -507,6 +674,42 @@ uint64_t memcached_behavior_get(memcached_st *shell,
   case MEMCACHED_BEHAVIOR_LOAD_FROM_FILE:
     return bool(memcached_parse_filename(ptr));
 
+  case MEMCACHED_BEHAVIOR_ZERO_COPY:
+    return ptr->flags.zero_copy;
+
+  case MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD:
+    return ptr->io_zero_copy_threshold;
+
+  case MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE:
+    return ptr->flags.ketama_lookup_table;
+
+  case MEMCACHED_BEHAVIOR_SINGLE_FLIGHT:
+    return ptr->single_flight != NULL;
+
+  case MEMCACHED_BEHAVIOR_EARLY_REFRESH:
+    return ptr->early_refresh;
+
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE:
+    return ptr->near_cache.budget;
+
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL:
+    return ptr->near_cache.ttl;
+
+  case MEMCACHED_BEHAVIOR_HOT_KEYS:
+    return memcached_hot_keys_size(ptr);
+
+  case MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS:
+    return ptr->hot_replicas.replicas;
+
+  case MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD:
+    return ptr->hot_replicas.threshold;
+
+  case MEMCACHED_BEHAVIOR_DNS_CACHE_TTL:
+    return memcached_dns_ttl(ptr);
+
+  case MEMCACHED_BEHAVIOR_SERVER_STATS:
+    return ptr->flags.server_stats;
+
   case MEMCACHED_BEHAVIOR_MAX:
   default:
     assert_msg(0, "Invalid behavior passed to memcached_behavior_get()");
@@ -577,6 +780,7 @@ memcached_return_t memcached_behavior_set_key_hash(memcached_st *shell, memcache
   {
     if (hashkit_success(hashkit_set_function(&ptr->hashkit, (hashkit_hash_algorithm_t)type)))
     {
+      ptr->ketama.points_version++;
       return MEMCACHED_SUCCESS;
     }
 
@@ -605,6 +809,7 @@ memcached_return_t memcached_behavior_set_distribution_hash(memcached_st *shell,
   {
     if (hashkit_success(hashkit_set_distribution_function(&ptr->hashkit, (hashkit_hash_algorithm_t)type)))
     {
+      ptr->ketama.points_version++;
       return MEMCACHED_SUCCESS;
     }
 
@@ -668,6 +873,20 @@ const char *libmemcached_string_behavior(const memcached_behavior_t flag)
   case MEMCACHED_BEHAVIOR_TCP_KEEPALIVE: return "MEMCACHED_BEHAVIOR_TCP_KEEPALIVE";
   case MEMCACHED_BEHAVIOR_TCP_KEEPIDLE: return "MEMCACHED_BEHAVIOR_TCP_KEEPIDLE";
   case MEMCACHED_BEHAVIOR_LOAD_FROM_FILE: return "MEMCACHED_BEHAVIOR_LOAD_FROM_FILE";
+  case MEMCACHED_BEHAVIOR_ZERO_COPY: return "MEMCACHED_BEHAVIOR_ZERO_COPY";
+  case MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD: return "MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD";
+  case MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE: return "MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE";
+  case MEMCACHED_BEHAVIOR_SINGLE_FLIGHT: return "MEMCACHED_BEHAVIOR_SINGLE_FLIGHT";
+  case MEMCACHED_BEHAVIOR_EARLY_REFRESH: return "MEMCACHED_BEHAVIOR_EARLY_REFRESH";
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE: return "MEMCACHED_BEHAVIOR_NEAR_CACHE";
+  case MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL: return "MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL";
+  case MEMCACHED_BEHAVIOR_HOT_KEYS: return "MEMCACHED_BEHAVIOR_HOT_KEYS";
+  case MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS: return "MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS";
+  case MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD: return "MEMCACHED_BEHAVIOR_HOT_KEY_THRESHOLD";
+  case MEMCACHED_BEHAVIOR_DNS_CACHE_TTL: return "MEMCACHED_BEHAVIOR_DNS_CACHE_TTL";
+  case MEMCACHED_BEHAVIOR_SERVER_STATS: return "MEMCACHED_BEHAVIOR_SERVER_STATS";
+  case MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR: return "MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR";
+  case MEMCACHED_BEHAVIOR_HEDGED_READS: return "MEMCACHED_BEHAVIOR_HEDGED_READS";
   default:
   case MEMCACHED_BEHAVIOR_MAX: return "INVALID memcached_behavior_t";
   }
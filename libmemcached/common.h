@@ -138,6 +138,7 @@ memcached_instance_st* memcached_instance_fetch(memcached_st *ptr, uint32_t serv
 # include "libmemcached/do.hpp"
 # include "libmemcached/socket.hpp"
 # include "libmemcached/connect.hpp"
+# include "libmemcached/dns.hpp"
 # include "libmemcached/allocators.hpp"
 # include "libmemcached/hash.hpp"
 # include "libmemcached/quit.hpp"
@@ -158,6 +159,13 @@ memcached_instance_st* memcached_instance_fetch(memcached_st *ptr, uint32_t serv
 
 #ifdef __cplusplus
 # include "libmemcached/response.h"
+# include "libmemcached/batch.hpp"
+# include "libmemcached/single_flight.hpp"
+# include "libmemcached/early_refresh.hpp"
+# include "libmemcached/near_cache.hpp"
+# include "libmemcached/hot_keys.hpp"
+# include "libmemcached/server_stats.hpp"
+# include "libmemcached/hedge.hpp"
 # include "libmemcached/namespace.h"
 #else
 # include "libmemcached/virtual_bucket.h"
@@ -196,6 +204,7 @@ extern "C" {
 #endif
 
 memcached_return_t run_distribution(memcached_st *ptr);
+memcached_return_t run_distribution_for_auto_eject(memcached_st *ptr);
 
 #ifdef __cplusplus
 static inline void memcached_server_response_increment(memcached_instance_st* instance)
@@ -214,7 +214,7 @@ static memcached_return_t set_hostinfo(memcached_instance_st* server)
   assert(server->address_info_next == NULL);
   int errcode;
   assert(server->hostname());
-  switch(errcode= getaddrinfo(server->hostname(), str_port, &hints, &server->address_info))
+  switch(errcode= memcached_dns_getaddrinfo(server->root, server->hostname(), str_port, &hints, &server->address_info))
   {
   case 0:
     server->address_info_next= server->address_info;
@@ -506,7 +506,12 @@ static memcached_return_t unix_socket_connect(memcached_instance_st* server)
 #endif
 }
 
-static memcached_return_t network_connect(memcached_instance_st* server)
+/*
+  With wait set to false a connect() which would block leaves the socket in
+  MEMCACHED_SERVER_STATE_IN_PROGRESS and returns MEMCACHED_IN_PROGRESS, the
+  caller is then responsible for polling it.
+*/
+static memcached_return_t network_connect(memcached_instance_st* server, const bool wait)
 {
   bool timeout_error_occured= false;
 
@@ -591,6 +596,11 @@ static memcached_return_t network_connect(memcached_instance_st* server)
       {
         server->events(POLLOUT);
         server->state= MEMCACHED_SERVER_STATE_IN_PROGRESS;
+        if (wait == false)
+        {
+          return MEMCACHED_IN_PROGRESS;
+        }
+
         memcached_return_t rc= connect_poll(server, local_error);
 
         if (memcached_success(rc))
@@ -688,7 +698,7 @@ static memcached_return_t backoff_handling(memcached_instance_st* server, bool&
       }
 
       memcached_return_t rc;
-      if (memcached_failed(rc= run_distribution((memcached_st *)server->root)))
+      if (memcached_failed(rc= run_distribution_for_auto_eject((memcached_st *)server->root)))
       {
         return memcached_set_error(*server, rc, MEMCACHED_AT, memcached_literal_param("Backoff handling failed during run_distribution"));
       }
@@ -726,6 +736,65 @@ static memcached_return_t backoff_handling(memcached_instance_st* server, bool&
   return MEMCACHED_SUCCESS;
 }
 
+static memcached_return_t network_connect_authenticate(memcached_instance_st* server, memcached_return_t rc)
+{
+#if defined(LIBMEMCACHED_WITH_SASL_SUPPORT)
+  if (LIBMEMCACHED_WITH_SASL_SUPPORT)
+  {
+    if (server->fd != INVALID_SOCKET and server->root->sasl.callbacks)
+    {
+      rc= memcached_sasl_authenticate_connection(server);
+      if (memcached_failed(rc) and server->fd != INVALID_SOCKET)
+      {
+        WATCHPOINT_ASSERT(server->fd != INVALID_SOCKET);
+        server->reset_socket();
+      }
+    }
+  }
+#else
+  (void)server;
+#endif
+
+  return rc;
+}
+
+static memcached_return_t connect_result(memcached_instance_st* server, memcached_return_t rc,
+                                         const bool in_timeout, const bool set_last_disconnected)
+{
+  if (memcached_success(rc))
+  {
+    memcached_io_readable_add(server);
+    server->mark_server_as_clean();
+    memcached_version_instance(server);
+    return rc;
+  }
+  else if (set_last_disconnected)
+  {
+    set_last_disconnected_host(server);
+    if (memcached_has_current_error(*server))
+    {
+      memcached_mark_server_for_timeout(server);
+      assert(memcached_failed(memcached_instance_error_return(server)));
+    }
+    else
+    {
+      memcached_set_error(*server, rc, MEMCACHED_AT);
+      memcached_mark_server_for_timeout(server);
+    }
+
+    LIBMEMCACHED_MEMCACHED_CONNECT_END();
+
+    if (in_timeout)
+    {
+      char buffer[1024];
+      int snprintf_length= snprintf(buffer, sizeof(buffer), "%s:%d", server->hostname(), int(server->port()));
+      return memcached_set_error(*server, MEMCACHED_SERVER_TEMPORARILY_DISABLED, MEMCACHED_AT, buffer, snprintf_length);
+    }
+  }
+
+  return rc;
+}
+
 static memcached_return_t _memcached_connect(memcached_instance_st* server, const bool set_last_disconnected)
 {
   assert(server);
@@ -759,22 +828,7 @@ static memcached_return_t _memcached_connect(memcached_instance_st* server, cons
   {
   case MEMCACHED_CONNECTION_UDP:
   case MEMCACHED_CONNECTION_TCP:
-    rc= network_connect(server);
-
-#if defined(LIBMEMCACHED_WITH_SASL_SUPPORT)
-    if (LIBMEMCACHED_WITH_SASL_SUPPORT)
-    {
-      if (server->fd != INVALID_SOCKET and server->root->sasl.callbacks)
-      {
-        rc= memcached_sasl_authenticate_connection(server);
-        if (memcached_failed(rc) and server->fd != INVALID_SOCKET)
-        {
-          WATCHPOINT_ASSERT(server->fd != INVALID_SOCKET);
-          server->reset_socket();
-        }
-      }
-    }
-#endif
+    rc= network_connect_authenticate(server, network_connect(server, true));
     break;
 
   case MEMCACHED_CONNECTION_UNIX_SOCKET:
@@ -782,40 +836,224 @@ static memcached_return_t _memcached_connect(memcached_instance_st* server, cons
     break;
   }
 
-  if (memcached_success(rc))
+  return connect_result(server, rc, in_timeout, set_last_disconnected);
+}
+
+memcached_return_t memcached_connect(memcached_instance_st* server)
+{
+  if (server->stale_responses)
   {
-    server->mark_server_as_clean();
-    memcached_version_instance(server);
-    return rc;
+    memcached_hedge_drain(server);
   }
-  else if (set_last_disconnected)
+
+  return _memcached_connect(server, true);
+}
+
+struct connect_pending_st {
+  memcached_instance_st* instance;
+  bool in_timeout;
+};
+
+static memcached_return_t connect_pending_failed(connect_pending_st& pending, const int local_errno)
+{
+  memcached_instance_st* server= pending.instance;
+
+  WATCHPOINT_ASSERT(server->fd != INVALID_SOCKET);
+  server->reset_socket();
+  server->address_info_next= server->address_info_next->ai_next;
+
+  // Any other address of the host is tried the same way
+  if (server->address_info_next)
   {
-    set_last_disconnected_host(server);
-    if (memcached_has_current_error(*server))
+    memcached_return_t rc= network_connect(server, false);
+    if (rc == MEMCACHED_IN_PROGRESS)
     {
-      memcached_mark_server_for_timeout(server);
-      assert(memcached_failed(memcached_instance_error_return(server)));
+      return rc;
     }
-    else
+
+    return connect_result(server, network_connect_authenticate(server, rc), pending.in_timeout, true);
+  }
+
+  memcached_set_errno(*server, local_errno, MEMCACHED_AT, memcached_literal_param("getsockopt() found the error from poll() after connect() returned EINPROGRESS."));
+  return connect_result(server, MEMCACHED_CONNECTION_FAILURE, pending.in_timeout, true);
+}
+
+/*
+  Connect the servers marked in wanted (all of them when wanted is NULL).
+
+  Every connect() is started before any of them is waited on, and then all
+  of them are polled together, so the whole takes at most connect_timeout
+  instead of connect_timeout per server. Unix sockets, UDP and servers which
+  cannot be put in the poll set go through memcached_connect().
+*/
+memcached_return_t memcached_connect_servers(Memcached* memc, const bool* wanted)
+{
+  uint32_t server_count= memcached_server_count(memc);
+  uint32_t failures= 0;
+
+  connect_pending_st* pending= libmemcached_xcalloc(memc, server_count, connect_pending_st);
+  struct pollfd* fds= libmemcached_xcalloc(memc, server_count, struct pollfd);
+  uint32_t pending_count= 0;
+
+  for (uint32_t x= 0; x < server_count; ++x)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+    if ((wanted and wanted[x] == false) or instance->fd != INVALID_SOCKET)
     {
-      memcached_set_error(*server, rc, MEMCACHED_AT);
-      memcached_mark_server_for_timeout(server);
+      continue;
     }
 
-    LIBMEMCACHED_MEMCACHED_CONNECT_END();
+    if (pending == NULL or fds == NULL or
+        instance->type != MEMCACHED_CONNECTION_TCP or instance->hostname()[0] == '/')
+    {
+      if (memcached_failed(memcached_connect(instance)))
+      {
+        failures++;
+      }
+      continue;
+    }
 
-    if (in_timeout)
+    LIBMEMCACHED_MEMCACHED_CONNECT_START();
+
+    bool in_timeout= false;
+    if (memcached_failed(backoff_handling(instance, in_timeout)))
     {
-      char buffer[1024];
-      int snprintf_length= snprintf(buffer, sizeof(buffer), "%s:%d", server->hostname(), int(server->port()));
-      return memcached_set_error(*server, MEMCACHED_SERVER_TEMPORARILY_DISABLED, MEMCACHED_AT, buffer, snprintf_length);
+      set_last_disconnected_host(instance);
+      failures++;
+      continue;
+    }
+
+    memcached_return_t rc= network_connect(instance, false);
+    if (rc == MEMCACHED_IN_PROGRESS)
+    {
+      pending[pending_count].instance= instance;
+      pending[pending_count].in_timeout= in_timeout;
+      pending_count++;
+    }
+    else if (memcached_failed(connect_result(instance, network_connect_authenticate(instance, rc), in_timeout, true)))
+    {
+      failures++;
     }
   }
 
-  return rc;
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  while (pending_count)
+  {
+    for (uint32_t x= 0; x < pending_count; ++x)
+    {
+      fds[x].fd= pending[x].instance->fd;
+      fds[x].events= POLLOUT;
+      fds[x].revents= 0;
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t elapsed= int64_t(now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+    if (memc->connect_timeout >= 0 and elapsed >= memc->connect_timeout)
+    {
+      break;
+    }
+
+    int number_of= poll(fds, pending_count, memc->connect_timeout < 0 ? -1 : int(memc->connect_timeout - elapsed));
+    if (number_of == -1)
+    {
+      int local_errno= get_socket_errno();
+      if (local_errno == EINTR)
+      {
+        continue;
+      }
+#ifdef __linux__
+      if (local_errno == ERESTART)
+      {
+        continue;
+      }
+#endif
+
+      for (uint32_t x= 0; x < pending_count; ++x)
+      {
+        memcached_instance_st* instance= pending[x].instance;
+        instance->reset_socket();
+        memcached_set_errno(*instance, local_errno, MEMCACHED_AT, memcached_literal_param("poll() failed while connecting"));
+        (void)connect_result(instance, MEMCACHED_CONNECTION_FAILURE, pending[x].in_timeout, true);
+        failures++;
+      }
+      pending_count= 0;
+      break;
+    }
+
+    // Finished connections are swapped out of the pending list
+    for (uint32_t x= 0; x < pending_count; )
+    {
+      if (fds[x].revents == 0)
+      {
+        ++x;
+        continue;
+      }
+
+      memcached_instance_st* instance= pending[x].instance;
+      int err= 0;
+      socklen_t len= sizeof(err);
+      if (getsockopt(instance->fd, SOL_SOCKET, SO_ERROR, (char*)&err, &len) == -1)
+      {
+        err= get_socket_errno();
+      }
+
+      memcached_return_t rc;
+      if (err == 0)
+      {
+        instance->state= MEMCACHED_SERVER_STATE_CONNECTED;
+        rc= connect_result(instance, network_connect_authenticate(instance, MEMCACHED_SUCCESS), pending[x].in_timeout, true);
+      }
+      else if ((rc= connect_pending_failed(pending[x], err)) == MEMCACHED_IN_PROGRESS)
+      {
+        fds[x].fd= instance->fd;
+        fds[x].revents= 0;
+        ++x;
+        continue;
+      }
+
+      if (memcached_failed(rc))
+      {
+        failures++;
+      }
+
+      --pending_count;
+      pending[x]= pending[pending_count];
+      fds[x]= fds[pending_count];
+    }
+  }
+
+  // Whatever is left ran out of time
+  for (uint32_t x= 0; x < pending_count; ++x)
+  {
+    memcached_instance_st* instance= pending[x].instance;
+    instance->reset_socket();
+    memcached_set_error(*instance, MEMCACHED_TIMEOUT, MEMCACHED_AT,
+                        memcached_literal_param("connect() did not complete within the connect timeout"));
+    (void)connect_result(instance, MEMCACHED_TIMEOUT, pending[x].in_timeout, true);
+    failures++;
+  }
+
+  libmemcached_free(memc, pending);
+  libmemcached_free(memc, fds);
+
+  return failures ? MEMCACHED_SOME_ERRORS : MEMCACHED_SUCCESS;
 }
 
-memcached_return_t memcached_connect(memcached_instance_st* server)
+memcached_return_t memcached_connect_all(memcached_st* shell)
 {
-  return _memcached_connect(server, true);
+  Memcached* memc= memcached2Memcached(shell);
+  if (memc == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (memcached_server_count(memc) == 0)
+  {
+    return memcached_set_error(*memc, MEMCACHED_NO_SERVERS, MEMCACHED_AT);
+  }
+
+  return memcached_connect_servers(memc, NULL);
 }
@@ -38,3 +38,5 @@
 #pragma once
 
 memcached_return_t memcached_connect(memcached_instance_st*);
+
+memcached_return_t memcached_connect_servers(Memcached*, const bool* wanted);
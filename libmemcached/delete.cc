@@ -61,6 +61,11 @@ static inline memcached_return_t ascii_delete(memcached_instance_st* instance,
     { memcached_literal_param("\r\n") }
   };
 
+  if (reply and is_buffering == false)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_DELETE);
+  }
+
   /* Send command header, only flush if we are NOT buffering */
   return memcached_vdo(instance, vector, 6, is_buffering ? false : true);
 }
@@ -70,13 +75,18 @@ static inline memcached_return_t binary_delete(memcached_instance_st* instance,
                                                const char *key,
                                                const size_t key_length,
                                                const bool reply,
-                                               const bool is_buffering)
+                                               const bool is_buffering,
+                                               const uint32_t *opaque= NULL)
 {
   protocol_binary_request_delete request= {};
 
   bool should_flush= is_buffering ? false : true;
 
   initialize_binary_request(instance, request.message.header);
+  if (opaque)
+  {
+    request.message.header.request.opaque= htonl(*opaque);
+  }
 
   if (reply)
   {
@@ -98,6 +108,11 @@ static inline memcached_return_t binary_delete(memcached_instance_st* instance,
     { key, key_length }
   };
 
+  if (reply and should_flush)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_DELETE);
+  }
+
   memcached_return_t rc;
   if (memcached_fatal(rc= memcached_vdo(instance, vector,  4, should_flush)))
   {
@@ -105,11 +120,18 @@ static inline memcached_return_t binary_delete(memcached_instance_st* instance,
     memcached_io_reset(instance);
   }
 
-  if (memcached_has_replicas(instance))
+  uint32_t replicas= memcached_has_replicas(instance);
+  if (replicas == 0 and instance->root->hot_replicas.table and
+      memcached_hot_replicas_write(instance->root, key, key_length, false) == HOT_REPLICAS_DROP)
+  {
+    replicas= memcached_hot_replicas_count(instance->root);
+  }
+
+  if (replicas)
   {
     request.message.header.request.opcode= PROTOCOL_BINARY_CMD_DELETEQ;
 
-    for (uint32_t x= 0; x < memcached_has_replicas(instance); ++x)
+    for (uint32_t x= 0; x < replicas; ++x)
     {
       ++server_key;
 
@@ -153,6 +175,7 @@ memcached_return_t memcached_delete_by_key(memcached_st *shell,
   {
     return memcached_last_error(memc);
   }
+  memcached_near_cache_invalidate(memc, key, key_length);
 
   if (expiration)
   {
@@ -216,6 +239,133 @@ memcached_return_t memcached_delete_by_key(memcached_st *shell,
     }
   }
 
+  // A read answered before the server applied the delete may have cached the old value
+  memcached_near_cache_invalidate(memc, key, key_length);
+
   LIBMEMCACHED_MEMCACHED_DELETE_END();
   return rc;
 }
+
+struct mdelete_context_st
+{
+  const char * const *keys;
+  const size_t *key_length;
+};
+
+static memcached_return_t mdelete_send(Memcached *ptr,
+                                       memcached_instance_st* instance,
+                                       uint32_t server_key,
+                                       uint32_t position,
+                                       bool reply,
+                                       void *context)
+{
+  mdelete_context_st *mdelete= static_cast<mdelete_context_st *>(context);
+
+  if (memcached_is_binary(ptr))
+  {
+    // Always quiet, only failures come back and they carry the opaque
+    return binary_delete(instance, server_key,
+                         mdelete->keys[position], mdelete->key_length[position],
+                         false, true, &position);
+  }
+
+  return ascii_delete(instance, server_key,
+                      mdelete->keys[position], mdelete->key_length[position],
+                      reply, true);
+}
+
+static memcached_return_t mdelete_response(Memcached *,
+                                           uint32_t,
+                                           memcached_return_t rc,
+                                           memcached_result_st *,
+                                           void *)
+{
+  if (rc == MEMCACHED_DELETED)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  return rc;
+}
+
+static memcached_return_t mdelete_by_key(Memcached *memc,
+                                         const char *group_key, size_t group_key_length,
+                                         const char * const *keys,
+                                         const size_t *key_length,
+                                         size_t number_of_keys,
+                                         memcached_return_t *results)
+{
+  if (memc == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  bool is_replying= memcached_is_replying(memc);
+  if (memc->delete_trigger and is_replying == false)
+  {
+    return memcached_set_error(*memc, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT, 
+                               memcached_literal_param("Delete triggers cannot be used if MEMCACHED_BEHAVIOR_NOREPLY is set"));
+  }
+
+  // The trigger needs to know which keys were deleted
+  memcached_return_t *collected= results;
+  if (memc->delete_trigger and collected == NULL and number_of_keys)
+  {
+    if ((collected= libmemcached_xcalloc(memc, number_of_keys, memcached_return_t)) == NULL)
+    {
+      return memcached_set_error(*memc, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  }
+
+  mdelete_context_st context= { keys, key_length };
+
+  memcached_batch_st batch;
+  batch.send= mdelete_send;
+  batch.response= mdelete_response;
+  batch.context= &context;
+  batch.reply= is_replying;
+
+  memcached_return_t rc= memcached_batch(memc, group_key, group_key_length,
+                                         keys, key_length, number_of_keys,
+                                         batch, collected);
+
+  if (memc->delete_trigger and (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_SOME_ERRORS))
+  {
+    for (size_t x= 0; x < number_of_keys; ++x)
+    {
+      if (collected[x] == MEMCACHED_SUCCESS)
+      {
+        memc->delete_trigger(memc, keys[x], key_length[x]);
+      }
+    }
+  }
+
+  if (collected != results)
+  {
+    libmemcached_free(memc, collected);
+  }
+
+  return rc;
+}
+
+memcached_return_t memcached_mdelete(memcached_st *shell,
+                                     const char * const *keys,
+                                     const size_t *key_length,
+                                     size_t number_of_keys,
+                                     memcached_return_t *results)
+{
+  return mdelete_by_key(memcached2Memcached(shell), NULL, 0,
+                        keys, key_length, number_of_keys, results);
+}
+
+memcached_return_t memcached_mdelete_by_key(memcached_st *shell,
+                                            const char *group_key,
+                                            size_t group_key_length,
+                                            const char * const *keys,
+                                            const size_t *key_length,
+                                            size_t number_of_keys,
+                                            memcached_return_t *results)
+{
+  return mdelete_by_key(memcached2Memcached(shell), group_key, group_key_length,
+                        keys, key_length, number_of_keys, results);
+}
@@ -0,0 +1,384 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+#include <signal.h>
+
+#define DNS_NEGATIVE_TTL_DIVISOR 10 // Failed lookups are kept for a tenth of the TTL
+#define DNS_ADDRINFO_ALIGN(__size) (((__size) + sizeof(void *) -1) & ~(sizeof(void *) -1))
+
+struct dns_entry_st
+{
+  dns_entry_st *next;
+  memcached_dns_st *cache;
+  char hostname[MEMCACHED_NI_MAXHOST];
+  char port[MEMCACHED_NI_MAXSERV];
+  struct addrinfo hints;
+  struct addrinfo *list; // Last addresses found, kept when a later lookup fails
+  int error; // getaddrinfo() error when there is no list
+  int system_errno; // errno that went with EAI_SYSTEM
+  time_t expires;
+  bool refreshing;
+};
+
+struct memcached_dns_st
+{
+  uint32_t refcount;
+  uint32_t ttl;
+  pthread_mutex_t mutex; // Guards the entries
+  dns_entry_st *entries;
+};
+
+void memcached_dns_addrinfo_free(struct addrinfo *list)
+{
+  free(list);
+}
+
+/* Copies a list into one allocation so that it outlives the resolver's */
+static struct addrinfo *dns_addrinfo_copy(const struct addrinfo *list)
+{
+  size_t size= 0;
+  for (const struct addrinfo *ai= list; ai; ai= ai->ai_next)
+  {
+    size+= DNS_ADDRINFO_ALIGN(sizeof(struct addrinfo)) + DNS_ADDRINFO_ALIGN(ai->ai_addrlen);
+  }
+
+  char *block;
+  if (size == 0 or (block= (char *)malloc(size)) == NULL)
+  {
+    return NULL;
+  }
+
+  struct addrinfo *head= NULL;
+  struct addrinfo **tail= &head;
+  for (const struct addrinfo *ai= list; ai; ai= ai->ai_next)
+  {
+    struct addrinfo *copy= (struct addrinfo *)block;
+    block+= DNS_ADDRINFO_ALIGN(sizeof(struct addrinfo));
+
+    *copy= *ai;
+    copy->ai_canonname= NULL;
+    copy->ai_addr= (struct sockaddr *)block;
+    copy->ai_next= NULL;
+    memcpy(block, ai->ai_addr, ai->ai_addrlen);
+    block+= DNS_ADDRINFO_ALIGN(ai->ai_addrlen);
+
+    *tail= copy;
+    tail= &copy->ai_next;
+  }
+
+  return head;
+}
+
+static int dns_resolve(const char *hostname, const char *port,
+                       const struct addrinfo *hints,
+                       struct addrinfo **result)
+{
+  struct addrinfo *list= NULL;
+  int error= getaddrinfo(hostname, port, hints, &list);
+  if (error == 0)
+  {
+    *result= dns_addrinfo_copy(list);
+    freeaddrinfo(list);
+
+    if (*result == NULL)
+    {
+      return EAI_MEMORY;
+    }
+  }
+
+  return error;
+}
+
+static dns_entry_st *dns_find(memcached_dns_st *cache,
+                              const char *hostname, const char *port,
+                              const struct addrinfo *hints)
+{
+  for (dns_entry_st *entry= cache->entries; entry; entry= entry->next)
+  {
+    if (entry->hints.ai_family == hints->ai_family and
+        entry->hints.ai_socktype == hints->ai_socktype and
+        entry->hints.ai_protocol == hints->ai_protocol and
+        entry->hints.ai_flags == hints->ai_flags and
+        strcmp(entry->port, port) == 0 and
+        strcmp(entry->hostname, hostname) == 0)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+  Records the outcome of a lookup, taking ownership of list. A failure does
+  not replace addresses found before, they stay in use until a lookup
+  succeeds again.
+*/
+static void dns_store(memcached_dns_st *cache, dns_entry_st *entry,
+                      struct addrinfo *list, int error, int system_errno)
+{
+  time_t now= time(NULL);
+  uint32_t ttl= __atomic_load_n(&cache->ttl, __ATOMIC_RELAXED);
+
+  if (error == 0)
+  {
+    memcached_dns_addrinfo_free(entry->list);
+    entry->list= list;
+    entry->error= 0;
+    entry->expires= now +ttl;
+    return;
+  }
+
+  uint32_t negative_ttl= ttl / DNS_NEGATIVE_TTL_DIVISOR;
+  entry->expires= now +(negative_ttl ? negative_ttl : 1);
+  if (entry->list == NULL)
+  {
+    entry->error= error;
+    entry->system_errno= system_errno;
+  }
+}
+
+static void dns_release(memcached_dns_st *cache)
+{
+  if (cache == NULL or __atomic_sub_fetch(&cache->refcount, 1, __ATOMIC_ACQ_REL))
+  {
+    return;
+  }
+
+  while (cache->entries)
+  {
+    dns_entry_st *entry= cache->entries;
+    cache->entries= entry->next;
+    memcached_dns_addrinfo_free(entry->list);
+    free(entry);
+  }
+
+  pthread_mutex_destroy(&cache->mutex);
+  free(cache);
+}
+
+static void *dns_refresh(void *context)
+{
+  dns_entry_st *entry= (dns_entry_st *)context;
+  memcached_dns_st *cache= entry->cache;
+
+  // The name and hints of an entry never change once it is linked in
+  struct addrinfo *list= NULL;
+  int error= dns_resolve(entry->hostname, entry->port, &entry->hints, &list);
+  int system_errno= errno;
+
+  pthread_mutex_lock(&cache->mutex);
+  dns_store(cache, entry, list, error, system_errno);
+  entry->refreshing= false;
+  pthread_mutex_unlock(&cache->mutex);
+
+  dns_release(cache);
+
+  return NULL;
+}
+
+/* Looks the entry up again in a detached thread, which holds a reference to the cache */
+static void dns_refresh_start(dns_entry_st *entry)
+{
+  memcached_dns_st *cache= entry->cache;
+  __atomic_add_fetch(&cache->refcount, 1, __ATOMIC_RELAXED);
+
+  bool started= false;
+  pthread_attr_t attr;
+  if (pthread_attr_init(&attr) == 0)
+  {
+    // Signals are left to the application's own threads
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+    pthread_t thread;
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    started= pthread_create(&thread, &attr, dns_refresh, entry) == 0;
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    pthread_attr_destroy(&attr);
+  }
+
+  if (started == false)
+  {
+    // The next lookup of the entry tries again
+    pthread_mutex_lock(&cache->mutex);
+    entry->refreshing= false;
+    pthread_mutex_unlock(&cache->mutex);
+    dns_release(cache);
+  }
+}
+
+int memcached_dns_getaddrinfo(Memcached *ptr,
+                              const char *hostname, const char *port,
+                              const struct addrinfo *hints,
+                              struct addrinfo **result)
+{
+  *result= NULL;
+
+  memcached_dns_st *cache= ptr->dns;
+  if (cache == NULL)
+  {
+    return dns_resolve(hostname, port, hints, result);
+  }
+
+  pthread_mutex_lock(&cache->mutex);
+  dns_entry_st *entry= dns_find(cache, hostname, port, hints);
+  if (entry and entry->list)
+  {
+    // Known addresses are used right away, even once they are due for a refresh
+    int error= (*result= dns_addrinfo_copy(entry->list)) ? 0 : EAI_MEMORY;
+    bool refresh= entry->refreshing == false and time(NULL) >= entry->expires;
+    if (refresh)
+    {
+      entry->refreshing= true;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (refresh)
+    {
+      dns_refresh_start(entry);
+    }
+
+    return error;
+  }
+
+  if (entry and time(NULL) < entry->expires)
+  {
+    int error= entry->error;
+    errno= entry->system_errno;
+    pthread_mutex_unlock(&cache->mutex);
+
+    return error;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+
+  // Nothing usable is known, this lookup has to wait for the resolver
+  struct addrinfo *list= NULL;
+  int error= dns_resolve(hostname, port, hints, &list);
+  int system_errno= errno;
+
+  if (error == 0 and (*result= dns_addrinfo_copy(list)) == NULL)
+  {
+    memcached_dns_addrinfo_free(list);
+    return EAI_MEMORY;
+  }
+
+  pthread_mutex_lock(&cache->mutex);
+  if (entry == NULL and (entry= dns_find(cache, hostname, port, hints)) == NULL and
+      strlen(hostname) < sizeof(entry->hostname) and strlen(port) < sizeof(entry->port) and
+      (entry= (dns_entry_st *)calloc(1, sizeof(dns_entry_st))))
+  {
+    entry->cache= cache;
+    strcpy(entry->hostname, hostname);
+    strcpy(entry->port, port);
+    entry->hints.ai_family= hints->ai_family;
+    entry->hints.ai_socktype= hints->ai_socktype;
+    entry->hints.ai_protocol= hints->ai_protocol;
+    entry->hints.ai_flags= hints->ai_flags;
+    entry->next= cache->entries;
+    cache->entries= entry;
+  }
+
+  if (entry)
+  {
+    dns_store(cache, entry, list, error, system_errno);
+    list= NULL;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+
+  memcached_dns_addrinfo_free(list);
+  errno= system_errno;
+
+  return error;
+}
+
+memcached_return_t memcached_dns_create(Memcached *ptr, uint32_t ttl)
+{
+  memcached_dns_st *cache= (memcached_dns_st *)calloc(1, sizeof(memcached_dns_st));
+  if (cache == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  int error;
+  if ((error= pthread_mutex_init(&cache->mutex, NULL)))
+  {
+    free(cache);
+    return memcached_set_errno(*ptr, error, MEMCACHED_AT);
+  }
+
+  cache->refcount= 1;
+  cache->ttl= ttl;
+  ptr->dns= cache;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_dns_clone(Memcached *clone, const Memcached *source)
+{
+  memcached_dns_st *cache= source->dns;
+  if (cache)
+  {
+    __atomic_add_fetch(&cache->refcount, 1, __ATOMIC_RELAXED);
+  }
+
+  clone->dns= cache;
+}
+
+void memcached_dns_free(Memcached *ptr)
+{
+  dns_release(ptr->dns);
+  ptr->dns= NULL;
+}
+
+uint32_t memcached_dns_ttl(const Memcached *ptr)
+{
+  return ptr->dns ? __atomic_load_n(&ptr->dns->ttl, __ATOMIC_RELAXED) : 0;
+}
+
+void memcached_dns_ttl(Memcached *ptr, uint32_t ttl)
+{
+  if (ptr->dns)
+  {
+    __atomic_store_n(&ptr->dns->ttl, ttl, __ATOMIC_RELAXED);
+  }
+}
@@ -0,0 +1,69 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Resolved server addresses, shared by reference count between a handle and
+  every handle cloned from it. An entry older than its TTL is still handed
+  out while a background thread looks the name up again, so a slow or
+  failing resolver never holds up a reconnect to a host seen before.
+*/
+struct memcached_dns_st;
+
+memcached_return_t memcached_dns_create(Memcached *ptr, uint32_t ttl);
+
+void memcached_dns_clone(Memcached *clone, const Memcached *source);
+
+void memcached_dns_free(Memcached *ptr);
+
+/* TTL in seconds, 0 when disabled */
+uint32_t memcached_dns_ttl(const Memcached *ptr);
+
+void memcached_dns_ttl(Memcached *ptr, uint32_t ttl);
+
+/*
+  getaddrinfo() through the cache when there is one. The list returned in
+  result is a copy in a single allocation, release it with
+  memcached_dns_addrinfo_free() and not freeaddrinfo().
+*/
+int memcached_dns_getaddrinfo(Memcached *ptr,
+                              const char *hostname, const char *port,
+                              const struct addrinfo *hints,
+                              struct addrinfo **result);
+
+void memcached_dns_addrinfo_free(struct addrinfo *list);
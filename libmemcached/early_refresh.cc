@@ -0,0 +1,123 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include <libmemcached/common.h>
+
+#include <cmath>
+
+/* Expirations larger than 30 days are absolute unix times */
+#define MEMCACHED_EXPIRATION_RELATIVE_MAX (60 * 60 * 24 * 30)
+
+char *memcached_early_refresh_wrap(Memcached *ptr,
+                                   const memcached_result_st *result,
+                                   const struct timeval& started,
+                                   size_t *length)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  time_t expiration= result->item_expiration;
+  if (expiration <= MEMCACHED_EXPIRATION_RELATIVE_MAX)
+  {
+    expiration+= now.tv_sec;
+  }
+
+  int64_t delta= int64_t(now.tv_sec - started.tv_sec) * 1000 + (now.tv_usec - started.tv_usec) / 1000;
+  if (delta < 0)
+  {
+    delta= 0;
+  }
+  else if (delta > int64_t(UINT32_MAX))
+  {
+    delta= UINT32_MAX;
+  }
+
+  size_t value_length= memcached_result_length(result);
+  char *envelope= static_cast<char *>(libmemcached_malloc(ptr, MEMCACHED_EARLY_REFRESH_HEADER_LENGTH +value_length));
+  if (envelope == NULL)
+  {
+    return NULL;
+  }
+
+  uint32_t expiry= htonl(uint32_t(expiration));
+  uint32_t compute_time= htonl(uint32_t(delta));
+  memcpy(envelope, &expiry, sizeof(expiry));
+  memcpy(envelope +4, &compute_time, sizeof(compute_time));
+  memcpy(envelope +MEMCACHED_EARLY_REFRESH_HEADER_LENGTH, memcached_result_value(result), value_length);
+
+  *length= MEMCACHED_EARLY_REFRESH_HEADER_LENGTH +value_length;
+
+  return envelope;
+}
+
+bool memcached_early_refresh_open(const Memcached *ptr,
+                                  char *value, size_t *value_length,
+                                  uint32_t *flags)
+{
+  /* Only the flags tell an envelope apart, the value itself is opaque */
+  if ((*flags & MEMCACHED_EARLY_REFRESH_FLAG) == 0 or
+      *value_length < MEMCACHED_EARLY_REFRESH_HEADER_LENGTH)
+  {
+    return false;
+  }
+  *flags&= ~MEMCACHED_EARLY_REFRESH_FLAG;
+
+  uint32_t expiry;
+  uint32_t compute_time;
+  memcpy(&expiry, value, sizeof(expiry));
+  memcpy(&compute_time, value +4, sizeof(compute_time));
+  expiry= ntohl(expiry);
+  compute_time= ntohl(compute_time);
+
+  /* Values are always followed by a terminating zero, move it as well */
+  *value_length-= MEMCACHED_EARLY_REFRESH_HEADER_LENGTH;
+  memmove(value, value +MEMCACHED_EARLY_REFRESH_HEADER_LENGTH, *value_length +1);
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  /*
+    XFetch: recompute once now - delta * beta * log(random) passes the
+    expiry, random being uniform in (0, 1].
+  */
+  double beta= double(ptr->early_refresh) / 100.0;
+  double uniform= (double(random()) +1.0) / (double(RAND_MAX) +1.0);
+  double gap= -(double(compute_time) / 1000.0) * beta * std::log(uniform);
+
+  return double(now.tv_sec) + double(now.tv_usec) / 1000000.0 + gap >= double(expiry);
+}
@@ -0,0 +1,64 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Probabilistic early refresh (XFetch) for values stored by the
+  get_key_failure read through. The stored value is prefixed with a small
+  envelope holding when the item expires and how long the trigger took to
+  compute it, and stored with MEMCACHED_EARLY_REFRESH_FLAG set in its flags.
+*/
+#define MEMCACHED_EARLY_REFRESH_HEADER_LENGTH 8
+
+/*
+  Return a copy of the result's value prefixed with its envelope, or NULL
+  on allocation failure. started is when the trigger was called.
+*/
+char *memcached_early_refresh_wrap(Memcached *ptr,
+                                   const memcached_result_st *result,
+                                   const struct timeval& started,
+                                   size_t *length);
+
+/*
+  Strip the envelope and its flag from a fetched value, in place, when its
+  flags mark one. Returns true when the value should be recomputed now, the
+  earlier the more expensive it was to compute.
+*/
+bool memcached_early_refresh_open(const Memcached *ptr,
+                                  char *value, size_t *value_length,
+                                  uint32_t *flags);
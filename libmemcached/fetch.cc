@@ -191,10 +191,25 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
     }
   }
 
+  if (ptr->near_cache.hits_count and memcached_near_cache_fetch(ptr, result))
+  {
+    *error= MEMCACHED_SUCCESS;
+    result->count++;
+    return result;
+  }
+
   *error= MEMCACHED_MAXIMUM_RETURN; // We use this to see if we ever go into the loop
   memcached_instance_st *server;
   memcached_return_t read_ret= MEMCACHED_SUCCESS;
   bool connection_failures= false;
+  if (memcached_hedge_active(ptr) and memcached_hedge_fetch(ptr, result, *error, connection_failures))
+  {
+    memcached_near_cache_store(ptr, result);
+    result->count++;
+    return result;
+  }
+
+  // Once a hedged mget is fetched no server has replies left for it
   while ((server= memcached_io_get_readable_server(ptr, read_ret)))
   {
     char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
@@ -211,6 +226,7 @@ memcached_result_st *memcached_fetch_result(memcached_st *ptr,
     }
     else if (*error == MEMCACHED_SUCCESS)
     {
+      memcached_near_cache_store(ptr, result);
       result->count++;
       return result;
     }
@@ -158,6 +158,8 @@ memcached_return_t memcached_flush(memcached_st *shell, time_t expiration)
 
   bool reply= memcached_is_replying(ptr);
 
+  memcached_near_cache_invalidate_all(ptr);
+
   LIBMEMCACHED_MEMCACHED_FLUSH_START();
   if (memcached_is_binary(ptr))
   {
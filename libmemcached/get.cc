@@ -50,6 +50,108 @@ char *memcached_get(memcached_st *ptr, const char *key,
                               flags, error);
 }
 
+/*
+  Run the get_key_failure trigger for a key that was not found and store
+  what it produced.
+*/
+static char *get_key_failure_load(Memcached *ptr,
+                                  const char *key, size_t key_length,
+                                  size_t *value_length,
+                                  uint32_t *flags,
+                                  memcached_return_t *error)
+{
+  memcached_result_st key_failure_result;
+  memcached_result_st* result_ptr= memcached_result_create(ptr, &key_failure_result);
+
+  struct timeval started;
+  gettimeofday(&started, NULL);
+  memcached_return_t rc= ptr->get_key_failure(ptr, key, key_length, result_ptr);
+
+  /* On all failure drop to returning NULL */
+  if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+  {
+    const char *stored= memcached_result_value(result_ptr);
+    size_t stored_length= memcached_result_length(result_ptr);
+
+    uint32_t stored_flags= memcached_result_flags(result_ptr);
+
+    /* Only items that expire can be refreshed early */
+    char *envelope= NULL;
+    if (ptr->early_refresh and result_ptr->item_expiration)
+    {
+      if ((envelope= memcached_early_refresh_wrap(ptr, result_ptr, started, &stored_length)) == NULL)
+      {
+        *error= memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+        memcached_result_free(result_ptr);
+
+        return NULL;
+      }
+      stored= envelope;
+      stored_flags|= MEMCACHED_EARLY_REFRESH_FLAG;
+    }
+
+    if (rc == MEMCACHED_BUFFERED)
+    {
+      uint64_t latch; /* We use latch to track the state of the original socket */
+      latch= memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
+      if (latch == 0)
+      {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+      }
+
+      rc= memcached_set(ptr, key, key_length,
+                        stored, stored_length,
+                        result_ptr->item_expiration,
+                        stored_flags);
+
+      if (rc == MEMCACHED_BUFFERED and latch == 0)
+      {
+        memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
+      }
+    }
+    else
+    {
+      rc= memcached_set(ptr, key, key_length,
+                        stored, stored_length,
+                        result_ptr->item_expiration,
+                        stored_flags);
+    }
+    libmemcached_free(ptr, envelope);
+
+    if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+    {
+      *error= rc;
+      *value_length= memcached_result_length(result_ptr);
+      *flags= memcached_result_flags(result_ptr);
+      char *result_value=  memcached_string_take_value(&result_ptr->value);
+      memcached_result_free(result_ptr);
+
+      return result_value;
+    }
+  }
+
+  memcached_result_free(result_ptr);
+
+  return NULL;
+}
+
+static char *key_failure_load(Memcached *ptr,
+                              const char *key, size_t key_length,
+                              size_t *value_length,
+                              uint32_t *flags,
+                              memcached_return_t *error)
+{
+  if (ptr->single_flight)
+  {
+    return memcached_single_flight_load(ptr, key, key_length,
+                                        value_length, flags, error,
+                                        get_key_failure_load);
+  }
+
+  return get_key_failure_load(ptr, key, key_length,
+                              value_length, flags, error);
+}
+
 static memcached_return_t __mget_by_key_real(memcached_st *ptr,
                                              const char *group_key,
                                              size_t group_key_length,
@@ -72,6 +174,18 @@ char *memcached_get_by_key(memcached_st *shell,
     error= &unused;
   }
 
+  size_t unused_length;
+  if (value_length == NULL)
+  {
+    value_length= &unused_length;
+  }
+
+  uint32_t unused_flags;
+  if (flags == NULL)
+  {
+    flags= &unused_flags;
+  }
+
   uint64_t query_id= 0;
   if (ptr)
   {
@@ -97,10 +211,7 @@ char *memcached_get_by_key(memcached_st *shell,
       }
     }
 
-    if (value_length) 
-    {
-      *value_length= 0;
-    }
+    *value_length= 0;
 
     return NULL;
   }
@@ -114,63 +225,53 @@ char *memcached_get_by_key(memcached_st *shell,
   {
     *error= MEMCACHED_NOTFOUND;
   }
-  if (value == NULL)
+
+  if (value == NULL and ptr->hot_replicas.read_replica and *error == MEMCACHED_NOTFOUND)
   {
-    if (ptr->get_key_failure and *error == MEMCACHED_NOTFOUND)
+    /* The copy may be gone, or not written yet, the key's own server decides */
+    ptr->hot_replicas.read_primary= true;
+    *error= __mget_by_key_real(ptr, group_key, group_key_length,
+                               (const char * const *)&key, &key_length,
+                               1, false);
+    ptr->hot_replicas.read_primary= false;
+    query_id++;
+
+    if (memcached_success(*error))
     {
-      memcached_result_st key_failure_result;
-      memcached_result_st* result_ptr= memcached_result_create(ptr, &key_failure_result);
-      memcached_return_t rc= ptr->get_key_failure(ptr, key, key_length, result_ptr);
-
-      /* On all failure drop to returning NULL */
-      if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
+      value= memcached_fetch(ptr, NULL, NULL, value_length, flags, error);
+      if (*error == MEMCACHED_END)
       {
-        if (rc == MEMCACHED_BUFFERED)
-        {
-          uint64_t latch; /* We use latch to track the state of the original socket */
-          latch= memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS);
-          if (latch == 0)
-          {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
-          }
-
-          rc= memcached_set(ptr, key, key_length,
-                            (memcached_result_value(result_ptr)),
-                            (memcached_result_length(result_ptr)),
-                            0,
-                            (memcached_result_flags(result_ptr)));
-
-          if (rc == MEMCACHED_BUFFERED and latch == 0)
-          {
-            memcached_behavior_set(ptr, MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
-          }
-        }
-        else
-        {
-          rc= memcached_set(ptr, key, key_length,
-                            (memcached_result_value(result_ptr)),
-                            (memcached_result_length(result_ptr)),
-                            0,
-                            (memcached_result_flags(result_ptr)));
-        }
-
-        if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_BUFFERED)
-        {
-          *error= rc;
-          *value_length= memcached_result_length(result_ptr);
-          *flags= memcached_result_flags(result_ptr);
-          char *result_value=  memcached_string_take_value(&result_ptr->value);
-          memcached_result_free(result_ptr);
-
-          return result_value;
-        }
+        *error= MEMCACHED_NOTFOUND;
       }
+    }
+  }
 
-      memcached_result_free(result_ptr);
+  if (value == NULL)
+  {
+    if (ptr->get_key_failure and *error == MEMCACHED_NOTFOUND)
+    {
+      value= key_failure_load(ptr, key, key_length, value_length, flags, error);
     }
     assert_msg(ptr->query_id == query_id +1, "Programmer error, the query_id was not incremented.");
 
-    return NULL;
+    return value;
+  }
+
+  if (ptr->early_refresh and memcached_early_refresh_open(ptr, value, value_length, flags) and ptr->get_key_failure)
+  {
+    /* If the recompute fails the value we have is still good */
+    size_t refreshed_length;
+    uint32_t refreshed_flags;
+    memcached_return_t refreshed_error;
+    char *refreshed= key_failure_load(ptr, key, key_length, &refreshed_length, &refreshed_flags, &refreshed_error);
+    if (refreshed)
+    {
+      libmemcached_free(ptr, value);
+      value= refreshed;
+      *value_length= refreshed_length;
+      *flags= refreshed_flags;
+      *error= refreshed_error;
+    }
   }
 
   return value;
@@ -192,6 +293,45 @@ static memcached_return_t binary_mget_by_key(memcached_st *ptr,
                                              const size_t number_of_keys,
                                              const bool mget_mode);
 
+/*
+  The first mget after startup can need many servers, their connections are
+  established together instead of one after the other as keys reach them.
+*/
+static void mget_connect_servers(Memcached *ptr,
+                                 const char * const *keys,
+                                 const size_t *key_length,
+                                 size_t number_of_keys)
+{
+  uint32_t disconnected= 0;
+  for (uint32_t x= 0; x < memcached_server_count(ptr) and disconnected < 2; x++)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(ptr, x);
+    if (instance->fd == INVALID_SOCKET and instance->state != MEMCACHED_SERVER_STATE_IN_TIMEOUT)
+    {
+      disconnected++;
+    }
+  }
+
+  if (disconnected < 2)
+  {
+    return;
+  }
+
+  bool *wanted= libmemcached_xcalloc(ptr, memcached_server_count(ptr), bool);
+  if (wanted == NULL)
+  {
+    return;
+  }
+
+  for (size_t x= 0; x < number_of_keys; x++)
+  {
+    wanted[memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x])]= true;
+  }
+
+  (void)memcached_connect_servers(ptr, wanted);
+  libmemcached_free(ptr, wanted);
+}
+
 static memcached_return_t __mget_by_key_real(memcached_st *ptr,
                                              const char *group_key,
                                              const size_t group_key_length,
@@ -230,6 +370,13 @@ static memcached_return_t __mget_by_key_real(memcached_st *ptr,
     return rc;
   }
 
+  /* A retry on the key's own server is not counted twice */
+  ptr->hot_replicas.read_replica= false;
+  for (uint32_t x= 0; ptr->hot_keys.tracker and ptr->hot_replicas.read_primary == false and x < number_of_keys; ++x)
+  {
+    memcached_hot_keys_record(ptr, keys[x], key_length[x]);
+  }
+
   bool is_group_key_set= false;
   if (group_key and group_key_length)
   {
@@ -237,6 +384,9 @@ static memcached_return_t __mget_by_key_real(memcached_st *ptr,
     is_group_key_set= true;
   }
 
+  /* Replies still owed to an earlier hedged mget are dropped */
+  memcached_hedge_reset(ptr);
+
   /*
     Here is where we pay for the non-block API. We need to remove any data sitting
     in the queue before we start our get.
@@ -263,6 +413,31 @@ static memcached_return_t __mget_by_key_real(memcached_st *ptr,
     }
   }
 
+  if (ptr->near_cache.cache)
+  {
+    /* Only the keys missing from the near cache are asked for */
+    if (memcached_failed(rc= memcached_near_cache_mget(ptr, keys, key_length, number_of_keys,
+                                                       &keys, &key_length, &number_of_keys)))
+    {
+      return rc;
+    }
+
+    if (number_of_keys == 0)
+    {
+      LIBMEMCACHED_MEMCACHED_MGET_END();
+      return MEMCACHED_SUCCESS;
+    }
+  }
+  else if (ptr->near_cache.hits_count)
+  {
+    memcached_near_cache_reset(ptr);
+  }
+
+  if (is_group_key_set == false and number_of_keys > 1)
+  {
+    mget_connect_servers(ptr, keys, key_length, number_of_keys);
+  }
+
   if (memcached_is_binary(ptr))
   {
     return binary_mget_by_key(ptr, master_server_key, is_group_key_set, keys,
@@ -315,6 +490,7 @@ static memcached_return_t __mget_by_key_real(memcached_st *ptr,
         continue;
       }
       hosts_connected++;
+      memcached_server_stats_start(instance, number_of_keys == 1 ? MEMCACHED_OPERATION_GET : MEMCACHED_OPERATION_MGET);
 
       if ((memcached_io_writev(instance, vector, 1, false)) == false)
       {
@@ -486,6 +662,11 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
       server_key= memcached_generate_hash_with_redistribution(ptr, keys[x], key_length[x]);
     }
 
+    if (ptr->hot_replicas.table)
+    {
+      server_key= memcached_hot_replicas_read(ptr, server_key, keys[x], key_length[x]);
+    }
+
     memcached_instance_st* instance= memcached_instance_fetch(ptr, server_key);
 
     if (instance->response_count() == 0)
@@ -495,6 +676,7 @@ static memcached_return_t simple_binary_mget(memcached_st *ptr,
       {
         continue;
       }
+      memcached_server_stats_start(instance, number_of_keys == 1 ? MEMCACHED_OPERATION_GET : MEMCACHED_OPERATION_MGET);
     }
 
     protocol_binary_request_getk request= { }; //= {.bytes= {0}};
@@ -591,6 +773,7 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
 {
   memcached_return_t rc= MEMCACHED_NOTFOUND;
   uint32_t start= 0;
+  bool hedging= memcached_hedge_start(ptr, keys, key_length, number_of_keys);
   uint64_t randomize_read= memcached_behavior_get(ptr, MEMCACHED_BEHAVIOR_RANDOMIZE_REPLICA_READ);
 
   if (randomize_read)
@@ -641,6 +824,7 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
           success= false;
           continue;
         }
+        memcached_server_stats_start(instance, number_of_keys == 1 ? MEMCACHED_OPERATION_GET : MEMCACHED_OPERATION_MGET);
       }
 
       protocol_binary_request_getk request= {};
@@ -649,6 +833,10 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
       request.message.header.request.keylen= htons((uint16_t)(key_length[x] + memcached_array_size(ptr->_namespace)));
       request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
       request.message.header.request.bodylen= htonl((uint32_t)(key_length[x] + memcached_array_size(ptr->_namespace)));
+      if (hedging)
+      {
+        request.message.header.request.opaque= htonl(x);
+      }
 
       /*
        * We need to disable buffering to actually know that the request was
@@ -676,6 +864,10 @@ static memcached_return_t replication_binary_mget(memcached_st *ptr,
       }
 
       memcached_server_response_increment(instance);
+      if (hedging)
+      {
+        memcached_hedge_sent(ptr, x, hash[x], server);
+      }
       hash[x]= memcached_server_count(ptr);
     }
 
@@ -68,6 +68,14 @@ static uint32_t dispatch_host(const Memcached *ptr, uint32_t hash)
       begin= left= ptr->ketama.continuum;
       end= right= ptr->ketama.continuum + num;
 
+      if (ptr->ketama.lookup)
+      {
+        // Narrow the search to the points sharing the top bits of hash
+        uint32_t bucket= hash >> (32 - ptr->ketama.lookup_bits);
+        left= begin + ptr->ketama.lookup[bucket];
+        right= begin + ptr->ketama.lookup[bucket +1];
+      }
+
       while (left < right)
       {
         middle= left + (right - left) / 2;
@@ -134,7 +142,7 @@ static inline void _regen_for_auto_eject(Memcached *ptr)
     if (gettimeofday(&now, NULL) == 0 and
         now.tv_sec > ptr->ketama.next_distribution_rebuild)
     {
-      run_distribution(ptr);
+      run_distribution_for_auto_eject(ptr);
     }
   }
 }
@@ -182,6 +190,7 @@ memcached_return_t memcached_set_hashkit(memcached_st *shell, hashkit_st *hashk)
   {
     hashkit_free(&self->hashkit);
     hashkit_clone(&self->hashkit, hashk);
+    self->ketama.points_version++; // Cached ketama points used the old hash
 
     return MEMCACHED_SUCCESS;
   }
@@ -0,0 +1,463 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <libmemcached/common.h>
+
+#define HEDGE_NO_SERVER UINT32_MAX
+#define HEDGE_FIND_DEADLINE UINT64_MAX
+
+struct memcached_hedge_key_st
+{
+  size_t key_offset; // In key_buffer
+  size_t key_length;
+  uint64_t deadline; // When to ask the next replica, 0 for never
+  uint32_t server_key; // The server the key hashes to
+  uint32_t server; // The server it was sent to
+  uint32_t hedge_server; // The replica it was sent to next, HEDGE_NO_SERVER when none
+  bool answered;
+  bool hedged;
+};
+
+struct memcached_hedge_st
+{
+  memcached_hedge_key_st *keys;
+  uint32_t size; // Keys there is room for
+  char *key_buffer;
+  size_t buffer_size;
+  uint32_t count; // Keys of the mget, 0 once it is fetched
+  uint32_t answered;
+  uint64_t next_deadline; // Earliest deadline of the keys left, 0 for none
+};
+
+bool memcached_hedge_active(const Memcached *ptr)
+{
+  return ptr->hedge.mget and ptr->hedge.mget->count;
+}
+
+bool memcached_hedge_start(Memcached *ptr, const char * const *keys, const size_t *key_length, size_t number_of_keys)
+{
+  memcached_hedge_reset(ptr);
+
+  if (ptr->hedge.percentile == 0 or ptr->number_of_replicas == 0 or number_of_keys >= UINT32_MAX)
+  {
+    return false;
+  }
+
+  if (ptr->hedge.mget == NULL)
+  {
+    if ((ptr->hedge.mget= libmemcached_xcalloc(ptr, 1, memcached_hedge_st)) == NULL)
+    {
+      return false;
+    }
+  }
+  memcached_hedge_st *mget= ptr->hedge.mget;
+
+  if (number_of_keys > mget->size)
+  {
+    memcached_hedge_key_st *grown= libmemcached_xrealloc(ptr, mget->keys, number_of_keys, memcached_hedge_key_st);
+    if (grown == NULL)
+    {
+      return false;
+    }
+    mget->keys= grown;
+    mget->size= uint32_t(number_of_keys);
+  }
+
+  size_t total_length= 0;
+  for (size_t x= 0; x < number_of_keys; x++)
+  {
+    total_length+= key_length[x];
+  }
+
+  if (total_length > mget->buffer_size)
+  {
+    char *grown= libmemcached_xrealloc(ptr, mget->key_buffer, total_length, char);
+    if (grown == NULL)
+    {
+      return false;
+    }
+    mget->key_buffer= grown;
+    mget->buffer_size= total_length;
+  }
+
+  // Keys which are never sent count as answered
+  size_t offset= 0;
+  for (uint32_t x= 0; x < number_of_keys; x++)
+  {
+    memcached_hedge_key_st& key= mget->keys[x];
+    memcpy(mget->key_buffer + offset, keys[x], key_length[x]);
+    key.key_offset= offset;
+    key.key_length= key_length[x];
+    key.deadline= 0;
+    key.server_key= HEDGE_NO_SERVER;
+    key.server= HEDGE_NO_SERVER;
+    key.hedge_server= HEDGE_NO_SERVER;
+    key.answered= true;
+    key.hedged= false;
+    offset+= key_length[x];
+  }
+
+  mget->count= uint32_t(number_of_keys);
+  mget->answered= uint32_t(number_of_keys);
+  mget->next_deadline= 0;
+
+  return true;
+}
+
+void memcached_hedge_sent(Memcached *ptr, uint32_t x, uint32_t server_key, uint32_t server)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+  memcached_hedge_key_st& key= mget->keys[x];
+
+  if (key.answered)
+  {
+    mget->answered--;
+  }
+  key.answered= false;
+  key.server_key= server_key;
+  key.server= server;
+
+  uint64_t delay= memcached_server_stats_read_latency(memcached_instance_fetch(ptr, server), ptr->hedge.percentile);
+  if (delay)
+  {
+    key.deadline= memcached_server_stats_clock() + delay;
+    if (mget->next_deadline == 0 or key.deadline < mget->next_deadline)
+    {
+      mget->next_deadline= key.deadline;
+    }
+  }
+}
+
+static void hedge_answered(memcached_hedge_st *mget, memcached_hedge_key_st& key)
+{
+  key.answered= true;
+  mget->answered++;
+
+  if (key.hedged == false and key.deadline and key.deadline == mget->next_deadline)
+  {
+    mget->next_deadline= HEDGE_FIND_DEADLINE;
+  }
+}
+
+static uint64_t hedge_next_deadline(memcached_hedge_st *mget)
+{
+  if (mget->next_deadline == HEDGE_FIND_DEADLINE)
+  {
+    mget->next_deadline= 0;
+    for (uint32_t x= 0; x < mget->count; x++)
+    {
+      memcached_hedge_key_st& key= mget->keys[x];
+      if (key.answered == false and key.hedged == false and key.deadline and
+          (mget->next_deadline == 0 or key.deadline < mget->next_deadline))
+      {
+        mget->next_deadline= key.deadline;
+      }
+    }
+  }
+
+  return mget->next_deadline;
+}
+
+/* Ask the copy following the one key was sent to */
+static bool hedge_send(Memcached *ptr, uint32_t x)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+  memcached_hedge_key_st& key= mget->keys[x];
+
+  key.hedged= true;
+  if (key.deadline and key.deadline == mget->next_deadline)
+  {
+    mget->next_deadline= HEDGE_FIND_DEADLINE;
+  }
+
+  uint32_t server_count= memcached_server_count(ptr);
+  uint32_t replica= (key.server + server_count - key.server_key) % server_count;
+  uint32_t server= (key.server_key + (replica +1) % (ptr->number_of_replicas +1)) % server_count;
+  if (server == key.server)
+  {
+    return false;
+  }
+
+  memcached_instance_st* instance= memcached_instance_fetch(ptr, server);
+  if (memcached_failed(memcached_connect(instance)))
+  {
+    return false;
+  }
+
+  protocol_binary_request_getk request= {};
+  initialize_binary_request(instance, request.message.header);
+  request.message.header.request.opcode= PROTOCOL_BINARY_CMD_GETK;
+  request.message.header.request.keylen= htons((uint16_t)(key.key_length + memcached_array_size(ptr->_namespace)));
+  request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
+  request.message.header.request.bodylen= htonl((uint32_t)(key.key_length + memcached_array_size(ptr->_namespace)));
+  request.message.header.request.opaque= htonl(x);
+
+  libmemcached_io_vector_st vector[]=
+  {
+    { request.bytes, sizeof(request.bytes) },
+    { memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace) },
+    { mget->key_buffer + key.key_offset, key.key_length }
+  };
+
+  if (instance->response_count() == 0)
+  {
+    memcached_server_stats_start(instance, mget->count == 1 ? MEMCACHED_OPERATION_GET : MEMCACHED_OPERATION_MGET);
+  }
+
+  if (memcached_io_writev(instance, vector, 3, true) == false)
+  {
+    memcached_io_reset(instance);
+    return false;
+  }
+
+  memcached_server_response_increment(instance);
+  key.hedge_server= server;
+
+  return true;
+}
+
+static void hedge_due(Memcached *ptr, uint64_t now)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+
+  for (uint32_t x= 0; x < mget->count; x++)
+  {
+    memcached_hedge_key_st& key= mget->keys[x];
+    if (key.answered == false and key.hedged == false and key.deadline and key.deadline <= now)
+    {
+      (void)hedge_send(ptr, x);
+    }
+  }
+  mget->next_deadline= HEDGE_FIND_DEADLINE;
+}
+
+static bool hedge_server_pending(Memcached *ptr, uint32_t server)
+{
+  return server != HEDGE_NO_SERVER and memcached_instance_fetch(ptr, server)->response_count() > 0;
+}
+
+/*
+  No server has a reply ready. The keys whose servers failed are asked of a
+  replica if they have not been yet, the others will not be answered.
+  Returns false when nothing is left to wait for.
+*/
+static bool hedge_settle(Memcached *ptr)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+  bool sent= false;
+
+  for (uint32_t x= 0; x < mget->count; x++)
+  {
+    memcached_hedge_key_st& key= mget->keys[x];
+    if (key.answered or hedge_server_pending(ptr, key.server) or hedge_server_pending(ptr, key.hedge_server))
+    {
+      continue;
+    }
+
+    if (key.hedged == false and hedge_send(ptr, x))
+    {
+      sent= true;
+      continue;
+    }
+
+    hedge_answered(mget, key);
+  }
+
+  return sent;
+}
+
+bool memcached_hedge_fetch(Memcached *ptr, memcached_result_st *result,
+                           memcached_return_t& error, bool& connection_failures)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+
+  while (mget->answered < mget->count)
+  {
+    memcached_instance_st* instance;
+    uint64_t deadline= hedge_next_deadline(mget);
+    if (deadline)
+    {
+      uint64_t now= memcached_server_stats_clock();
+      if (deadline <= now)
+      {
+        hedge_due(ptr, now);
+        continue;
+      }
+
+      // Any reply, or the deadline, whichever comes first
+      instance= memcached_io_get_readable_server(ptr, int((deadline - now + 999) / 1000));
+      if (instance == NULL and memcached_server_stats_clock() >= deadline)
+      {
+        continue;
+      }
+    }
+    else
+    {
+      memcached_return_t unused;
+      instance= memcached_io_get_readable_server(ptr, unused);
+    }
+
+    if (instance == NULL)
+    {
+      if (hedge_settle(ptr))
+      {
+        continue;
+      }
+      break;
+    }
+
+    uint32_t opaque;
+    memcached_return_t rc= memcached_read_one_response(instance, result, opaque);
+    if (memcached_fatal(rc))
+    {
+      // The keys sent to the server will be asked of a replica
+      error= rc;
+      connection_failures= true;
+      continue;
+    }
+
+    if (opaque >= mget->count or mget->keys[opaque].answered)
+    {
+      continue; // The late copy of a key already answered
+    }
+
+    hedge_answered(mget, mget->keys[opaque]);
+    error= rc;
+
+    if (rc == MEMCACHED_SUCCESS)
+    {
+      if (mget->answered == mget->count)
+      {
+        memcached_hedge_reset(ptr);
+      }
+
+      return true;
+    }
+  }
+
+  memcached_hedge_reset(ptr);
+
+  return false;
+}
+
+void memcached_hedge_reset(Memcached *ptr)
+{
+  memcached_hedge_st *mget= ptr->hedge.mget;
+  if (mget == NULL or mget->count == 0)
+  {
+    return;
+  }
+  mget->count= 0;
+  mget->answered= 0;
+
+  /*
+    Whatever is still expected is a late copy. Replies already buffered are
+    read now, the others once the server is used again. A server which has
+    not sent them by then is reconnected rather than waited for.
+  */
+  for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(ptr, x);
+    if (instance->response_count())
+    {
+      instance->stale_responses+= instance->response_count();
+      memcached_server_response_reset(instance);
+
+      if (instance->read_buffer_length)
+      {
+        memcached_hedge_drain(instance);
+      }
+    }
+  }
+}
+
+/* A late copy which has not arrived is not waited for */
+static bool hedge_reply_ready(memcached_instance_st* instance)
+{
+  if (instance->read_buffer_length)
+  {
+    return true;
+  }
+
+  struct pollfd fds;
+  fds.fd= instance->fd;
+  fds.events= POLLIN;
+  fds.revents= 0;
+
+  return poll(&fds, 1, 0) == 1;
+}
+
+void memcached_hedge_drain(memcached_instance_st* instance)
+{
+  memcached_result_st result;
+  memcached_result_st *result_ptr= memcached_result_create(instance->root, &result);
+  if (result_ptr == NULL)
+  {
+    memcached_io_reset(instance);
+    return;
+  }
+
+  instance->cursor_active_+= instance->stale_responses;
+  instance->stale_responses= 0;
+  while (instance->response_count())
+  {
+    if (hedge_reply_ready(instance) == false)
+    {
+      memcached_io_reset(instance);
+      break;
+    }
+
+    uint32_t opaque;
+    if (memcached_fatal(memcached_read_one_response(instance, result_ptr, opaque)))
+    {
+      break;
+    }
+  }
+
+  memcached_result_free(result_ptr);
+}
+
+void memcached_hedge_free(Memcached *ptr)
+{
+  if (ptr->hedge.mget)
+  {
+    libmemcached_free(ptr, ptr->hedge.mget->keys);
+    libmemcached_free(ptr, ptr->hedge.mget->key_buffer);
+    libmemcached_free(ptr, ptr->hedge.mget);
+    ptr->hedge.mget= NULL;
+  }
+}
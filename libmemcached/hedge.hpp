@@ -0,0 +1,70 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Hedged reads. While MEMCACHED_BEHAVIOR_HEDGED_READS is set, a binary
+  mget with replicas remembers every key it sent, tagged with its position
+  in the opaque field. When the server of a key has not answered within
+  the given percentile of its past reads, the key is asked of the next
+  replica too. The first reply for a key is kept, the other one is dropped
+  when its opaque shows the key was already answered, or by
+  memcached_hedge_drain() before the server is used again.
+*/
+struct memcached_hedge_st;
+
+/* Start recording the keys of an mget, false when it will not be hedged */
+bool memcached_hedge_start(Memcached *ptr, const char * const *keys, const size_t *key_length, size_t number_of_keys);
+
+/* Key x, which hashes to server_key, was sent to server with x as its opaque */
+void memcached_hedge_sent(Memcached *ptr, uint32_t x, uint32_t server_key, uint32_t server);
+
+/* An mget is being fetched through memcached_hedge_fetch() */
+bool memcached_hedge_active(const Memcached *ptr);
+
+/* memcached_fetch_result() for a hedged mget */
+bool memcached_hedge_fetch(Memcached *ptr, memcached_result_st *result,
+                           memcached_return_t& error, bool& connection_failures);
+
+/* Forget the mget being fetched, its late replies are left to memcached_hedge_drain() */
+void memcached_hedge_reset(Memcached *ptr);
+
+/* Read and drop the late replies still expected from a server */
+void memcached_hedge_drain(memcached_instance_st* instance);
+
+void memcached_hedge_free(Memcached *ptr);
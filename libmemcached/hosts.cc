@@ -38,11 +38,12 @@
 #include <libmemcached/common.h>
 #include "libmemcached/assert.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <sys/time.h>
 
 /* Protoypes (static) */
-static memcached_return_t update_continuum(Memcached *ptr);
+static memcached_return_t update_continuum(Memcached *ptr, bool reuse_points);
 
 static int compare_servers(const void *p1, const void *p2)
 {
@@ -81,7 +82,7 @@ memcached_return_t run_distribution(Memcached *ptr)
   case MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY:
   case MEMCACHED_DISTRIBUTION_CONSISTENT_WEIGHTED:
-    return update_continuum(ptr);
+    return update_continuum(ptr, false);
 
   case MEMCACHED_DISTRIBUTION_VIRTUAL_BUCKET:
   case MEMCACHED_DISTRIBUTION_MODULA:
@@ -99,6 +100,21 @@ memcached_return_t run_distribution(Memcached *ptr)
   return MEMCACHED_SUCCESS;
 }
 
+/*
+  Only which servers are live has changed, so the hosts keep their order
+  and the consistent hashing ring can be updated from the points cached for
+  each server.
+*/
+memcached_return_t run_distribution_for_auto_eject(Memcached *ptr)
+{
+  if (memcached_is_consistent_distribution(ptr))
+  {
+    return update_continuum(ptr, true);
+  }
+
+  return run_distribution(ptr);
+}
+
 static uint32_t ketama_server_hash(const char *key, size_t key_length, uint32_t alignment)
 {
   unsigned char results[16];
@@ -111,33 +127,394 @@ static uint32_t ketama_server_hash(const char *key, size_t key_length, uint32_t
     | (results[0 + alignment * 4] & 0xFF);
 }
 
-static int continuum_item_cmp(const void *t1, const void *t2)
+/*
+  Sort the continuum by value with a least significant byte first radix
+  sort. It is stable, points sharing a value keep the order they were
+  generated in, and it runs in linear time so rebuilding a large ring does
+  not stall the caller.
+*/
+static memcached_return_t continuum_sort(Memcached *ptr, memcached_continuum_item_st *items, uint32_t points)
 {
-  memcached_continuum_item_st *ct1= (memcached_continuum_item_st *)t1;
-  memcached_continuum_item_st *ct2= (memcached_continuum_item_st *)t2;
+  if (points < 2)
+  {
+    return MEMCACHED_SUCCESS;
+  }
 
-  /* Why 153? Hmmm... */
-  WATCHPOINT_ASSERT(ct1->value != 153);
-  if (ct1->value == ct2->value)
+  uint32_t counts[4][256];
+  memset(counts, 0, sizeof(counts));
+
+  memcached_continuum_item_st *source= items;
+  for (uint32_t x= 0; x < points; ++x)
   {
-    return 0;
+    uint32_t value= source[x].value;
+    counts[0][value & 0xFF]++;
+    counts[1][(value >> 8) & 0xFF]++;
+    counts[2][(value >> 16) & 0xFF]++;
+    counts[3][value >> 24]++;
   }
-  else if (ct1->value > ct2->value)
+
+  memcached_continuum_item_st *scratch= libmemcached_xvalloc(ptr, points, memcached_continuum_item_st);
+  if (scratch == NULL)
   {
-    return 1;
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
   }
-  else
+
+  memcached_continuum_item_st *target= scratch;
+  for (uint32_t pass= 0; pass < 4; ++pass)
+  {
+    const uint32_t shift= pass * 8;
+
+    // Every point has the same byte here, this pass would not move anything.
+    if (counts[pass][(source[0].value >> shift) & 0xFF] == points)
+    {
+      continue;
+    }
+
+    uint32_t offset= 0;
+    for (uint32_t bucket= 0; bucket < 256; ++bucket)
+    {
+      uint32_t count= counts[pass][bucket];
+      counts[pass][bucket]= offset;
+      offset+= count;
+    }
+
+    for (uint32_t x= 0; x < points; ++x)
+    {
+      target[counts[pass][(source[x].value >> shift) & 0xFF]++]= source[x];
+    }
+
+    std::swap(source, target);
+  }
+
+  if (source != items)
+  {
+    memcpy(items, source, sizeof(memcached_continuum_item_st) * points);
+  }
+  libmemcached_free(ptr, scratch);
+
+  return MEMCACHED_SUCCESS;
+}
+
+static inline bool is_live(const memcached_instance_st& instance, bool is_auto_ejecting, time_t now)
+{
+  return is_auto_ejecting == false or instance.next_retry <= now;
+}
+
+static inline bool continuum_item_less(const memcached_continuum_item_st& a, const memcached_continuum_item_st& b)
+{
+  return a.value < b.value or (a.value == b.value and a.index < b.index);
+}
+
+static uint32_t continuum_points_for_server(const Memcached *ptr, const memcached_instance_st& instance,
+                                            uint64_t total_weight, uint32_t live_servers)
+{
+  if (memcached_is_weighted_ketama(ptr))
+  {
+    float pct= (float)instance.weight / (float)total_weight;
+    return (uint32_t) ((::floor((float) (pct * MEMCACHED_POINTS_PER_SERVER_KETAMA / 4 * (float)live_servers + 0.0000000001))) * 4);
+  }
+
+  return MEMCACHED_POINTS_PER_SERVER;
+}
+
+/*
+  Index the sorted continuum by the top lookup_bits of the hash. Entry N
+  holds the first point whose value is at least N << (32 - lookup_bits),
+  so the point for any hash in bucket N lies between entry N and N +1.
+*/
+static memcached_return_t update_continuum_lookup(Memcached *ptr)
+{
+  if (memcached_is_ketama_lookup_table(ptr) == false)
+  {
+    libmemcached_free(ptr, ptr->ketama.lookup);
+    ptr->ketama.lookup= NULL;
+    ptr->ketama.lookup_bits= 0;
+
+    return MEMCACHED_SUCCESS;
+  }
+
+  const uint32_t points= ptr->ketama.continuum_points_counter;
+
+  // Aim for about two points per bucket.
+  uint32_t bits= 1;
+  while (bits < MEMCACHED_KETAMA_LOOKUP_MAX_BITS and (uint32_t(1) << bits) < points / 2)
+  {
+    bits++;
+  }
+
+  const uint32_t buckets= uint32_t(1) << bits;
+  if (bits != ptr->ketama.lookup_bits or ptr->ketama.lookup == NULL)
+  {
+    uint32_t *new_ptr= libmemcached_xrealloc(ptr, ptr->ketama.lookup, buckets +1, uint32_t);
+
+    if (new_ptr == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+
+    ptr->ketama.lookup= new_ptr;
+    ptr->ketama.lookup_bits= bits;
+  }
+
+  const memcached_continuum_item_st *continuum= ptr->ketama.continuum;
+  uint32_t point= 0;
+  for (uint32_t bucket= 0; bucket < buckets; ++bucket)
   {
-    return -1;
+    const uint32_t floor= bucket << (32 - bits);
+    while (point < points and continuum[point].value < floor)
+    {
+      point++;
+    }
+    ptr->ketama.lookup[bucket]= point;
   }
+  ptr->ketama.lookup[buckets]= points;
+
+  return MEMCACHED_SUCCESS;
 }
 
-static memcached_return_t update_continuum(Memcached *ptr)
+/*
+  Make sure the first count points of a server are cached. Each hashed host
+  string gives pointer_per_hash points, and the first N points of a server
+  never depend on how many it ends up with, so a server that is given more
+  points later only hashes the ones it is missing.
+*/
+static memcached_return_t continuum_server_points(Memcached *ptr, memcached_instance_st& instance, uint32_t count)
+{
+  if (instance.ketama.version != ptr->ketama.points_version)
+  {
+    instance.ketama.count= 0;
+    instance.ketama.version= ptr->ketama.points_version;
+  }
+
+  if (instance.ketama.count >= count)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (count > instance.ketama.size)
+  {
+    uint32_t *new_ptr= libmemcached_xrealloc(ptr, instance.ketama.points, count, uint32_t);
+
+    if (new_ptr == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+
+    instance.ketama.points= new_ptr;
+    instance.ketama.size= count;
+  }
+
+  const uint32_t pointer_per_hash= memcached_is_weighted_ketama(ptr) ? 4 : 1;
+  for (uint32_t pointer_index= instance.ketama.count / pointer_per_hash;
+       pointer_index < count / pointer_per_hash;
+       pointer_index++)
+  {
+    char sort_host[1 +MEMCACHED_NI_MAXHOST +1 +MEMCACHED_NI_MAXSERV +1 + MEMCACHED_NI_MAXSERV ]= "";
+    int sort_host_length;
+
+    if (ptr->distribution == MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY)
+    {
+      // Spymemcached ketema key format is: hostname/ip:port-index
+      // If hostname is not available then: /ip:port-index
+      sort_host_length= snprintf(sort_host, sizeof(sort_host),
+                                 "/%s:%u-%u",
+                                 instance._hostname,
+                                 (uint32_t)instance.port(),
+                                 pointer_index);
+    }
+    else if (instance.port() == MEMCACHED_DEFAULT_PORT)
+    {
+      sort_host_length= snprintf(sort_host, sizeof(sort_host),
+                                 "%s-%u",
+                                 instance._hostname,
+                                 pointer_index);
+    }
+    else
+    {
+      sort_host_length= snprintf(sort_host, sizeof(sort_host),
+                                 "%s:%u-%u",
+                                 instance._hostname,
+                                 (uint32_t)instance.port(),
+                                 pointer_index);
+    }
+
+    if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
+                                 memcached_literal_param("snprintf(sizeof(sort_host))"));
+    }
+
+    if (DEBUG)
+    {
+      fprintf(stdout, "update_continuum: key is %s\n", sort_host);
+    }
+
+    if (memcached_is_weighted_ketama(ptr))
+    {
+      for (uint32_t x= 0; x < pointer_per_hash; x++)
+      {
+        instance.ketama.points[instance.ketama.count++]= ketama_server_hash(sort_host, (size_t)sort_host_length, x);
+      }
+    }
+    else
+    {
+      instance.ketama.points[instance.ketama.count++]= hashkit_digest(&ptr->hashkit, sort_host, (size_t)sort_host_length);
+    }
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Leave room for a few more servers, and give memory back once the ring
+  has shrunk to well under half of what was allocated.
+*/
+static memcached_return_t continuum_reserve(Memcached *ptr, uint64_t points_needed)
+{
+  const uint32_t points_per_server= (uint32_t) (memcached_is_weighted_ketama(ptr) ? MEMCACHED_POINTS_PER_SERVER_KETAMA : MEMCACHED_POINTS_PER_SERVER);
+
+  if (points_needed > UINT32_MAX - MEMCACHED_CONTINUUM_ADDITION * points_per_server)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("ketama continuum is too large"));
+  }
+
+  uint32_t points_wanted= uint32_t(points_needed) + MEMCACHED_CONTINUUM_ADDITION * points_per_server;
+  if (points_needed > ptr->ketama.continuum_count or points_wanted < ptr->ketama.continuum_count / 2)
+  {
+    memcached_continuum_item_st *new_ptr;
+
+    new_ptr= libmemcached_xrealloc(ptr, ptr->ketama.continuum, points_wanted, memcached_continuum_item_st);
+
+    if (new_ptr == 0)
+    {
+      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+
+    ptr->ketama.continuum= new_ptr;
+    ptr->ketama.continuum_count= points_wanted;
+  }
+  assert_msg(ptr->ketama.continuum, "Programmer Error, empty ketama continuum");
+
+  return MEMCACHED_SUCCESS;
+}
+
+/*
+  Without weights every server owns the same points no matter which other
+  servers are live, so a change in the live servers only has to drop the
+  points of the servers that left and merge in those of the servers that
+  came back. The ring is ordered by value, then by server, then by the
+  order the points were generated in, which is the order a full rebuild
+  produces.
+*/
+static memcached_return_t update_continuum_live(Memcached *ptr, bool is_auto_ejecting, time_t now)
+{
+  memcached_instance_st* list= memcached_instance_list(ptr);
+  memcached_continuum_item_st *continuum= ptr->ketama.continuum;
+
+  uint32_t kept= 0;
+  for (uint32_t x= 0; x < ptr->ketama.continuum_points_counter; ++x)
+  {
+    if (is_live(list[continuum[x].index], is_auto_ejecting, now))
+    {
+      continuum[kept++]= continuum[x];
+    }
+  }
+
+  uint32_t added= 0;
+  for (uint32_t host_index= 0; host_index < memcached_server_count(ptr); ++host_index)
+  {
+    if (list[host_index].ketama.in_continuum == false and is_live(list[host_index], is_auto_ejecting, now))
+    {
+      added+= MEMCACHED_POINTS_PER_SERVER;
+    }
+  }
+
+  if (added == 0 and kept == ptr->ketama.continuum_points_counter)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_continuum_item_st *points= NULL;
+  if (added)
+  {
+    points= libmemcached_xvalloc(ptr, added, memcached_continuum_item_st);
+    if (points == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  }
+
+  memcached_return_t rc= MEMCACHED_SUCCESS;
+  uint32_t point= 0;
+  for (uint32_t host_index= 0; host_index < memcached_server_count(ptr); ++host_index)
+  {
+    bool live= is_live(list[host_index], is_auto_ejecting, now);
+    if (live and list[host_index].ketama.in_continuum == false)
+    {
+      if (memcached_failed(rc= continuum_server_points(ptr, list[host_index], MEMCACHED_POINTS_PER_SERVER)))
+      {
+        break;
+      }
+
+      for (uint32_t x= 0; x < MEMCACHED_POINTS_PER_SERVER; ++x, ++point)
+      {
+        points[point].index= host_index;
+        points[point].value= list[host_index].ketama.points[x];
+      }
+    }
+    list[host_index].ketama.in_continuum= live;
+  }
+
+  // Points are in server order, a stable sort keeps ties that way.
+  if (memcached_success(rc))
+  {
+    rc= continuum_sort(ptr, points, added);
+  }
+
+  if (memcached_success(rc))
+  {
+    rc= continuum_reserve(ptr, uint64_t(kept) + added);
+  }
+
+  if (memcached_failed(rc))
+  {
+    libmemcached_free(ptr, points);
+
+    // Serve from the servers that stayed, and rebuild on the next pass.
+    ptr->ketama.continuum_points_counter= kept;
+    ptr->ketama.continuum_version= ptr->ketama.points_version -1;
+    (void)update_continuum_lookup(ptr);
+
+    return rc;
+  }
+
+  // Merge from the back so the ring can be updated in place.
+  continuum= ptr->ketama.continuum;
+  uint32_t write= kept + added;
+  uint32_t left= kept;
+  uint32_t right= added;
+  while (right)
+  {
+    if (left and continuum_item_less(points[right -1], continuum[left -1]))
+    {
+      continuum[--write]= continuum[--left];
+    }
+    else
+    {
+      continuum[--write]= points[--right];
+    }
+  }
+  ptr->ketama.continuum_points_counter= kept + added;
+  libmemcached_free(ptr, points);
+
+  return update_continuum_lookup(ptr);
+}
+
+static memcached_return_t update_continuum(Memcached *ptr, bool reuse_points)
 {
   uint32_t continuum_index= 0;
   uint32_t pointer_counter= 0;
-  uint32_t pointer_per_server= MEMCACHED_POINTS_PER_SERVER;
-  uint32_t pointer_per_hash= 1;
   uint32_t live_servers= 0;
   struct timeval now;
 
@@ -146,6 +523,13 @@ static memcached_return_t update_continuum(Memcached *ptr)
     return memcached_set_errno(*ptr, errno, MEMCACHED_AT);
   }
 
+  if (reuse_points == false)
+  {
+    // Hosts, hashing or the distribution may have changed, nothing cached
+    // for a server can be trusted.
+    ptr->ketama.points_version++;
+  }
+
   memcached_instance_st* list= memcached_instance_list(ptr);
 
   /* count live servers (those without a retry delay set) */
@@ -174,53 +558,56 @@ static memcached_return_t update_continuum(Memcached *ptr)
     live_servers= memcached_server_count(ptr);
   }
 
-  uint32_t points_per_server= (uint32_t) (memcached_is_weighted_ketama(ptr) ? MEMCACHED_POINTS_PER_SERVER_KETAMA : MEMCACHED_POINTS_PER_SERVER);
-
   if (live_servers == 0)
   {
     return MEMCACHED_SUCCESS;
   }
 
-  if (live_servers > ptr->ketama.continuum_count)
+  if (reuse_points and memcached_is_weighted_ketama(ptr) == false and
+      ptr->ketama.continuum and ptr->ketama.continuum_version == ptr->ketama.points_version)
   {
-    memcached_continuum_item_st *new_ptr;
-
-    new_ptr= libmemcached_xrealloc(ptr, ptr->ketama.continuum, (live_servers + MEMCACHED_CONTINUUM_ADDITION) * points_per_server, memcached_continuum_item_st);
-
-    if (new_ptr == 0)
-    {
-      return MEMCACHED_MEMORY_ALLOCATION_FAILURE;
-    }
-
-    ptr->ketama.continuum= new_ptr;
-    ptr->ketama.continuum_count= live_servers + MEMCACHED_CONTINUUM_ADDITION;
+    return update_continuum_live(ptr, is_auto_ejecting, now.tv_sec);
   }
-  assert_msg(ptr->ketama.continuum, "Programmer Error, empty ketama continuum");
 
   uint64_t total_weight= 0;
   if (memcached_is_weighted_ketama(ptr))
   {
     for (uint32_t host_index = 0; host_index < memcached_server_count(ptr); ++host_index)
     {
-      if (is_auto_ejecting == false or list[host_index].next_retry <= now.tv_sec)
+      if (is_live(list[host_index], is_auto_ejecting, now.tv_sec))
       {
         total_weight += list[host_index].weight;
       }
     }
   }
 
+  /* size the continuum from the points each live server will contribute */
+  uint64_t points_needed= 0;
   for (uint32_t host_index= 0; host_index < memcached_server_count(ptr); ++host_index)
   {
-    if (is_auto_ejecting and list[host_index].next_retry > now.tv_sec)
+    if (is_live(list[host_index], is_auto_ejecting, now.tv_sec))
+    {
+      points_needed+= continuum_points_for_server(ptr, list[host_index], total_weight, live_servers);
+    }
+  }
+
+  memcached_return_t rc;
+  if (memcached_failed(rc= continuum_reserve(ptr, points_needed)))
+  {
+    return rc;
+  }
+
+  for (uint32_t host_index= 0; host_index < memcached_server_count(ptr); ++host_index)
+  {
+    list[host_index].ketama.in_continuum= is_live(list[host_index], is_auto_ejecting, now.tv_sec);
+    if (list[host_index].ketama.in_continuum == false)
     {
       continue;
     }
 
+    uint32_t pointer_per_server= continuum_points_for_server(ptr, list[host_index], total_weight, live_servers);
     if (memcached_is_weighted_ketama(ptr))
     {
-        float pct= (float)list[host_index].weight / (float)total_weight;
-        pointer_per_server= (uint32_t) ((::floor((float) (pct * MEMCACHED_POINTS_PER_SERVER_KETAMA / 4 * (float)live_servers + 0.0000000001))) * 4);
-        pointer_per_hash= 4;
         if (DEBUG)
         {
           printf("ketama_weighted:%s|%d|%llu|%u\n",
@@ -231,99 +618,15 @@ static memcached_return_t update_continuum(Memcached *ptr)
         }
     }
 
-
-    if (ptr->distribution == MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY)
+    if (memcached_failed(rc= continuum_server_points(ptr, list[host_index], pointer_per_server)))
     {
-      for (uint32_t pointer_index= 0;
-           pointer_index < pointer_per_server / pointer_per_hash;
-           pointer_index++)
-      {
-        char sort_host[1 +MEMCACHED_NI_MAXHOST +1 +MEMCACHED_NI_MAXSERV +1 + MEMCACHED_NI_MAXSERV ]= "";
-        int sort_host_length;
-
-        // Spymemcached ketema key format is: hostname/ip:port-index
-        // If hostname is not available then: /ip:port-index
-        sort_host_length= snprintf(sort_host, sizeof(sort_host),
-                                   "/%s:%u-%u",
-                                   list[host_index]._hostname,
-                                   (uint32_t)list[host_index].port(),
-                                   pointer_index);
-
-        if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0)
-        {
-          return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
-                                     memcached_literal_param("snprintf(sizeof(sort_host))"));
-        }
-
-        if (DEBUG)
-        {
-          fprintf(stdout, "update_continuum: key is %s\n", sort_host);
-        }
-
-        if (memcached_is_weighted_ketama(ptr))
-        {
-          for (uint32_t x= 0; x < pointer_per_hash; x++)
-          {
-            uint32_t value= ketama_server_hash(sort_host, (size_t)sort_host_length, x);
-            ptr->ketama.continuum[continuum_index].index= host_index;
-            ptr->ketama.continuum[continuum_index++].value= value;
-          }
-        }
-        else
-        {
-          uint32_t value= hashkit_digest(&ptr->hashkit, sort_host, (size_t)sort_host_length);
-          ptr->ketama.continuum[continuum_index].index= host_index;
-          ptr->ketama.continuum[continuum_index++].value= value;
-        }
-      }
+      return rc;
     }
-    else
-    {
-      for (uint32_t pointer_index= 1;
-           pointer_index <= pointer_per_server / pointer_per_hash;
-           pointer_index++)
-      {
-        char sort_host[MEMCACHED_NI_MAXHOST +1 +MEMCACHED_NI_MAXSERV +1 +MEMCACHED_NI_MAXSERV]= "";
-        int sort_host_length;
 
-        if (list[host_index].port() == MEMCACHED_DEFAULT_PORT)
-        {
-          sort_host_length= snprintf(sort_host, sizeof(sort_host),
-                                     "%s-%u",
-                                     list[host_index]._hostname,
-                                     pointer_index - 1);
-        }
-        else
-        {
-          sort_host_length= snprintf(sort_host, sizeof(sort_host),
-                                     "%s:%u-%u",
-                                     list[host_index]._hostname,
-                                     (uint32_t)list[host_index].port(),
-                                     pointer_index - 1);
-        }
-
-        if (size_t(sort_host_length) >= sizeof(sort_host) or sort_host_length < 0)
-        {
-          return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT, 
-                                     memcached_literal_param("snprintf(sizeof(sort_host)))"));
-        }
-
-        if (memcached_is_weighted_ketama(ptr))
-        {
-          for (uint32_t x = 0; x < pointer_per_hash; x++)
-          {
-            uint32_t value= ketama_server_hash(sort_host, (size_t)sort_host_length, x);
-            ptr->ketama.continuum[continuum_index].index= host_index;
-            ptr->ketama.continuum[continuum_index++].value= value;
-          }
-        }
-        else
-        {
-          uint32_t value= hashkit_digest(&ptr->hashkit, sort_host, (size_t)sort_host_length);
-          ptr->ketama.continuum[continuum_index].index= host_index;
-          ptr->ketama.continuum[continuum_index++].value= value;
-        }
-      }
+    for (uint32_t x= 0; x < pointer_per_server; ++x)
+    {
+      ptr->ketama.continuum[continuum_index].index= host_index;
+      ptr->ketama.continuum[continuum_index++].value= list[host_index].ketama.points[x];
     }
 
     pointer_counter+= pointer_per_server;
@@ -331,19 +634,24 @@ static memcached_return_t update_continuum(Memcached *ptr)
 
   assert_msg(ptr, "Programmer Error, no valid ptr");
   assert_msg(ptr->ketama.continuum, "Programmer Error, empty ketama continuum");
-  assert_msg(memcached_server_count(ptr) * MEMCACHED_POINTS_PER_SERVER <= MEMCACHED_CONTINUUM_SIZE, "invalid size information being given to qsort()");
+  assert_msg(pointer_counter == continuum_index and pointer_counter == points_needed, "Programmer Error, continuum was not sized for its points");
   ptr->ketama.continuum_points_counter= pointer_counter;
-  qsort(ptr->ketama.continuum, ptr->ketama.continuum_points_counter, sizeof(memcached_continuum_item_st), continuum_item_cmp);
+  ptr->ketama.continuum_version= ptr->ketama.points_version;
+
+  if (memcached_failed(rc= continuum_sort(ptr, ptr->ketama.continuum, ptr->ketama.continuum_points_counter)))
+  {
+    return rc;
+  }
 
   if (DEBUG)
   {
-    for (uint32_t pointer_index= 0; memcached_server_count(ptr) && pointer_index < ((live_servers * MEMCACHED_POINTS_PER_SERVER) - 1); pointer_index++)
+    for (uint32_t pointer_index= 0; pointer_index +1 < ptr->ketama.continuum_points_counter; pointer_index++)
     {
       WATCHPOINT_ASSERT(ptr->ketama.continuum[pointer_index].value <= ptr->ketama.continuum[pointer_index + 1].value);
     }
   }
 
-  return MEMCACHED_SUCCESS;
+  return update_continuum_lookup(ptr);
 }
 
 static memcached_return_t server_add(Memcached *memc, 
@@ -0,0 +1,743 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+
+#define HOT_KEYS_SKETCH_DEPTH 4
+#define HOT_KEYS_SKETCH_WIDTH 4096
+#define HOT_KEYS_SKETCH_PERIOD (HOT_KEYS_SKETCH_WIDTH * 16) // Counters are halved after this many keys
+#define HOT_KEYS_ADDITIONS_BATCH 256 // Handles add to the shared total of keys in batches
+#define HOT_KEYS_HEAP_STRIDE 8 // A full heap is only updated on every eighth request of a key
+
+#define HOT_REPLICAS_SLOTS 4096
+#define HOT_REPLICAS_PROBES 16
+#define HOT_REPLICAS_EMPTY 0
+#define HOT_REPLICAS_DELETED 1
+#define HOT_REPLICAS_PINNED 1 // Low bit of a slot, set for keys pinned by the application
+#define HOT_REPLICAS_COPIED 4 // Set once the copies of the key were written, reads only go to them then
+#define HOT_REPLICAS_STATE (HOT_REPLICAS_PINNED | HOT_REPLICAS_COPIED)
+
+struct hot_keys_entry_st
+{
+  uint64_t hash;
+  uint32_t count;
+  size_t key_length;
+  char key[MEMCACHED_MAX_KEY];
+};
+
+struct memcached_hot_keys_st
+{
+  uint32_t refcount;
+  uint32_t additions;
+  uint32_t floor; // Count of the lightest tracked key once the heap is full, 0 before
+  uint32_t sketch[HOT_KEYS_SKETCH_DEPTH][HOT_KEYS_SKETCH_WIDTH];
+  pthread_mutex_t mutex; // Guards the heap
+  uint32_t size;
+  uint32_t count;
+  hot_keys_entry_st *heap; // Min-heap on count
+};
+
+static uint64_t hot_keys_hash(const char *key, size_t key_length)
+{
+  /* FNV-1a, with a final mix so every 16 bits can index a row */
+  uint64_t hash= 14695981039346656037ULL;
+  for (size_t x= 0; x < key_length; ++x)
+  {
+    hash^= uint8_t(key[x]);
+    hash*= 1099511628211ULL;
+  }
+
+  hash^= hash >> 33;
+  hash*= 0xff51afd7ed558ccdULL;
+  hash^= hash >> 33;
+
+  return hash;
+}
+
+static inline uint32_t sketch_index(uint64_t hash, uint32_t row)
+{
+  return uint32_t(hash >> (row * 16)) & (HOT_KEYS_SKETCH_WIDTH -1);
+}
+
+static uint32_t sketch_estimate(memcached_hot_keys_st *hot, uint64_t hash)
+{
+  uint32_t estimate= UINT32_MAX;
+  for (uint32_t row= 0; row < HOT_KEYS_SKETCH_DEPTH; ++row)
+  {
+    uint32_t count= __atomic_load_n(&hot->sketch[row][sketch_index(hash, row)], __ATOMIC_RELAXED);
+    if (count < estimate)
+    {
+      estimate= count;
+    }
+  }
+
+  return estimate;
+}
+
+static void heap_swap(hot_keys_entry_st& a, hot_keys_entry_st& b)
+{
+  hot_keys_entry_st temp= a;
+  a= b;
+  b= temp;
+}
+
+static void heap_up(memcached_hot_keys_st *hot, uint32_t x)
+{
+  while (x > 0)
+  {
+    uint32_t parent= (x -1) / 2;
+    if (hot->heap[parent].count <= hot->heap[x].count)
+    {
+      break;
+    }
+    heap_swap(hot->heap[parent], hot->heap[x]);
+    x= parent;
+  }
+}
+
+static void heap_down(memcached_hot_keys_st *hot, uint32_t x)
+{
+  while (true)
+  {
+    uint32_t smallest= x;
+    uint32_t left= 2 * x +1;
+    uint32_t right= left +1;
+    if (left < hot->count and hot->heap[left].count < hot->heap[smallest].count)
+    {
+      smallest= left;
+    }
+    if (right < hot->count and hot->heap[right].count < hot->heap[smallest].count)
+    {
+      smallest= right;
+    }
+
+    if (smallest == x)
+    {
+      break;
+    }
+    heap_swap(hot->heap[smallest], hot->heap[x]);
+    x= smallest;
+  }
+}
+
+static void heap_update(memcached_hot_keys_st *hot, uint64_t hash,
+                        const char *key, size_t key_length, uint32_t estimate)
+{
+  uint32_t x;
+  for (x= 0; x < hot->count; ++x)
+  {
+    hot_keys_entry_st& entry= hot->heap[x];
+    if (entry.hash == hash and entry.key_length == key_length and memcmp(entry.key, key, key_length) == 0)
+    {
+      entry.count= estimate;
+      heap_down(hot, x);
+      break;
+    }
+  }
+
+  if (x == hot->count)
+  {
+    if (hot->count < hot->size)
+    {
+      x= hot->count++;
+    }
+    else if (estimate > hot->heap[0].count)
+    {
+      x= 0;
+    }
+    else
+    {
+      return;
+    }
+
+    hot_keys_entry_st& entry= hot->heap[x];
+    entry.hash= hash;
+    entry.count= estimate;
+    entry.key_length= key_length;
+    memcpy(entry.key, key, key_length);
+    heap_up(hot, x);
+    heap_down(hot, x);
+  }
+
+  __atomic_store_n(&hot->floor, hot->count == hot->size ? hot->heap[0].count : 0, __ATOMIC_RELAXED);
+}
+
+static void hot_keys_age(memcached_hot_keys_st *hot)
+{
+  /* Increments racing with this may be lost, the counts are estimates anyway */
+  for (uint32_t row= 0; row < HOT_KEYS_SKETCH_DEPTH; ++row)
+  {
+    for (uint32_t x= 0; x < HOT_KEYS_SKETCH_WIDTH; ++x)
+    {
+      uint32_t count= __atomic_load_n(&hot->sketch[row][x], __ATOMIC_RELAXED);
+      __atomic_store_n(&hot->sketch[row][x], count / 2, __ATOMIC_RELAXED);
+    }
+  }
+
+  /* Halving keeps the heap ordered */
+  pthread_mutex_lock(&hot->mutex);
+  for (uint32_t x= 0; x < hot->count; ++x)
+  {
+    hot->heap[x].count/= 2;
+  }
+  __atomic_store_n(&hot->floor, hot->count == hot->size ? hot->heap[0].count : 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&hot->mutex);
+}
+
+memcached_return_t memcached_hot_keys_create(Memcached *ptr, uint32_t size)
+{
+  memcached_hot_keys_free(ptr);
+
+  memcached_hot_keys_st *hot= (memcached_hot_keys_st *)calloc(1, sizeof(memcached_hot_keys_st));
+  if (hot == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  hot->heap= (hot_keys_entry_st *)calloc(size, sizeof(hot_keys_entry_st));
+  if (hot->heap == NULL)
+  {
+    free(hot);
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  int error;
+  if ((error= pthread_mutex_init(&hot->mutex, NULL)))
+  {
+    free(hot->heap);
+    free(hot);
+    return memcached_set_errno(*ptr, error, MEMCACHED_AT);
+  }
+
+  hot->refcount= 1;
+  hot->size= size;
+  ptr->hot_keys.tracker= hot;
+  ptr->hot_keys.additions= 0;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_hot_keys_clone(Memcached *clone, const Memcached *source)
+{
+  memcached_hot_keys_st *hot= source->hot_keys.tracker;
+  if (hot)
+  {
+    __atomic_add_fetch(&hot->refcount, 1, __ATOMIC_RELAXED);
+  }
+
+  clone->hot_keys.tracker= hot;
+  clone->hot_keys.additions= 0;
+}
+
+void memcached_hot_keys_free(Memcached *ptr)
+{
+  memcached_hot_keys_st *hot= ptr->hot_keys.tracker;
+  ptr->hot_keys.tracker= NULL;
+
+  if (hot == NULL or __atomic_sub_fetch(&hot->refcount, 1, __ATOMIC_ACQ_REL))
+  {
+    return;
+  }
+
+  pthread_mutex_destroy(&hot->mutex);
+  free(hot->heap);
+  free(hot);
+}
+
+uint32_t memcached_hot_keys_estimate(Memcached *ptr, const char *key, size_t key_length)
+{
+  if (ptr->hot_keys.tracker == NULL)
+  {
+    return 0;
+  }
+
+  return sketch_estimate(ptr->hot_keys.tracker, hot_keys_hash(key, key_length));
+}
+
+uint32_t memcached_hot_keys_size(const Memcached *ptr)
+{
+  return ptr->hot_keys.tracker ? ptr->hot_keys.tracker->size : 0;
+}
+
+void memcached_hot_keys_record(Memcached *ptr, const char *key, size_t key_length)
+{
+  memcached_hot_keys_st *hot= ptr->hot_keys.tracker;
+  uint64_t hash= hot_keys_hash(key, key_length);
+
+  uint32_t estimate= UINT32_MAX;
+  for (uint32_t row= 0; row < HOT_KEYS_SKETCH_DEPTH; ++row)
+  {
+    uint32_t count= __atomic_add_fetch(&hot->sketch[row][sketch_index(hash, row)], 1, __ATOMIC_RELAXED);
+    if (count < estimate)
+    {
+      estimate= count;
+    }
+  }
+
+  if (++ptr->hot_keys.additions == HOT_KEYS_ADDITIONS_BATCH)
+  {
+    ptr->hot_keys.additions= 0;
+    if ((__atomic_add_fetch(&hot->additions, HOT_KEYS_ADDITIONS_BATCH, __ATOMIC_RELAXED) % HOT_KEYS_SKETCH_PERIOD) == 0)
+    {
+      hot_keys_age(hot);
+    }
+  }
+
+  /*
+    Most keys are not hot, the ones that are only need the heap now and
+    then since counts are read back from the sketch, and a busy heap is not
+    worth waiting for.
+  */
+  uint32_t floor= __atomic_load_n(&hot->floor, __ATOMIC_RELAXED);
+  if (floor and (estimate <= floor or estimate % HOT_KEYS_HEAP_STRIDE))
+  {
+    return;
+  }
+
+  if (pthread_mutex_trylock(&hot->mutex))
+  {
+    return;
+  }
+
+  heap_update(hot, hash, key, key_length, estimate);
+  pthread_mutex_unlock(&hot->mutex);
+}
+
+memcached_return_t memcached_hot_keys_add(memcached_st *shell, const char *key, size_t key_length)
+{
+  Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL or key == NULL or key_length == 0 or key_length >= MEMCACHED_MAX_KEY)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (ptr->hot_keys.tracker == NULL)
+  {
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  memcached_hot_keys_record(ptr, key, key_length);
+
+  return MEMCACHED_SUCCESS;
+}
+
+memcached_return_t memcached_hot_keys(memcached_st *shell,
+                                      memcached_hot_key_st *keys,
+                                      uint32_t *number_of_keys)
+{
+  Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL or number_of_keys == NULL or (keys == NULL and *number_of_keys))
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memcached_hot_keys_st *hot= ptr->hot_keys.tracker;
+  if (hot == NULL)
+  {
+    *number_of_keys= 0;
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  bool taken[MEMCACHED_MAX_HOT_KEYS]= { false };
+  uint32_t found= 0;
+  pthread_mutex_lock(&hot->mutex);
+
+  /* Bring the counts up to date and heapify again */
+  for (uint32_t x= 0; x < hot->count; ++x)
+  {
+    hot->heap[x].count= sketch_estimate(hot, hot->heap[x].hash);
+  }
+  for (uint32_t x= hot->count / 2; x > 0; --x)
+  {
+    heap_down(hot, x -1);
+  }
+
+  /* Selection of the heaviest first, the heap holds at most MEMCACHED_MAX_HOT_KEYS */
+  for (; found < *number_of_keys and found < hot->count; ++found)
+  {
+    uint32_t heaviest= UINT32_MAX;
+    for (uint32_t x= 0; x < hot->count; ++x)
+    {
+      if (taken[x] == false and (heaviest == UINT32_MAX or hot->heap[x].count > hot->heap[heaviest].count))
+      {
+        heaviest= x;
+      }
+    }
+    taken[heaviest]= true;
+
+    const hot_keys_entry_st& entry= hot->heap[heaviest];
+    memcpy(keys[found].key, entry.key, entry.key_length);
+    keys[found].key[entry.key_length]= 0;
+    keys[found].key_length= entry.key_length;
+    keys[found].count= entry.count;
+  }
+  pthread_mutex_unlock(&hot->mutex);
+
+  for (uint32_t x= 0; x < found; ++x)
+  {
+    keys[x].server_key= memcached_generate_hash_with_redistribution(ptr, keys[x].key, keys[x].key_length);
+  }
+  *number_of_keys= found;
+
+  return MEMCACHED_SUCCESS;
+}
+
+struct memcached_hot_replicas_st
+{
+  uint32_t refcount;
+  uint64_t slots[HOT_REPLICAS_SLOTS]; // Open addressing on the key hash, see hot_replicas_tag()
+};
+
+static inline uint64_t hot_replicas_tag(const char *key, size_t key_length)
+{
+  /* Even, and never mistaken for an empty or a deleted slot */
+  return (hot_keys_hash(key, key_length) & ~uint64_t(HOT_REPLICAS_STATE)) | 2;
+}
+
+/* Set and clear state bits of a key's slot, given up once it holds another key */
+static void hot_replicas_update(uint64_t *slot, uint64_t tag, uint64_t set, uint64_t clear)
+{
+  uint64_t value= __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  while ((value & ~uint64_t(HOT_REPLICAS_STATE)) == tag)
+  {
+    uint64_t wanted= (value | set) & ~clear;
+    if (wanted == value or
+        __atomic_compare_exchange_n(slot, &value, wanted, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      break;
+    }
+  }
+}
+
+static uint64_t *hot_replicas_find(memcached_hot_replicas_st *table, uint64_t tag)
+{
+  for (uint32_t x= 0; x < HOT_REPLICAS_PROBES; ++x)
+  {
+    uint64_t *slot= &table->slots[(tag +x) & (HOT_REPLICAS_SLOTS -1)];
+    uint64_t value= __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (value == HOT_REPLICAS_EMPTY)
+    {
+      break;
+    }
+
+    if ((value & ~uint64_t(HOT_REPLICAS_STATE)) == tag)
+    {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+static bool hot_replicas_insert(memcached_hot_replicas_st *table, uint64_t tag, bool pinned)
+{
+  uint64_t wanted= tag | (pinned ? HOT_REPLICAS_PINNED : 0);
+
+  uint64_t *slot;
+  if ((slot= hot_replicas_find(table, tag)))
+  {
+    if (pinned)
+    {
+      hot_replicas_update(slot, tag, HOT_REPLICAS_PINNED, 0);
+    }
+
+    return true;
+  }
+
+  for (uint32_t x= 0; x < HOT_REPLICAS_PROBES; ++x)
+  {
+    slot= &table->slots[(tag +x) & (HOT_REPLICAS_SLOTS -1)];
+    uint64_t value= __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    while (value == HOT_REPLICAS_EMPTY or value == HOT_REPLICAS_DELETED)
+    {
+      /* On failure value is reloaded, and the slot given up if someone else took it */
+      if (__atomic_compare_exchange_n(slot, &value, wanted, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+        return true;
+      }
+    }
+
+    if ((value & ~uint64_t(HOT_REPLICAS_STATE)) == tag)
+    {
+      if (pinned)
+      {
+        hot_replicas_update(slot, tag, HOT_REPLICAS_PINNED, 0);
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void hot_replicas_remove(memcached_hot_replicas_st *table, uint64_t tag, bool pinned)
+{
+  for (uint32_t x= 0; x < HOT_REPLICAS_PROBES; ++x)
+  {
+    uint64_t *slot= &table->slots[(tag +x) & (HOT_REPLICAS_SLOTS -1)];
+    uint64_t value= __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (value == HOT_REPLICAS_EMPTY)
+    {
+      break;
+    }
+
+    /* Only the application unpins a key, a pinned one just loses its copies */
+    while ((value & ~uint64_t(HOT_REPLICAS_STATE)) == tag)
+    {
+      uint64_t wanted= HOT_REPLICAS_DELETED;
+      if (pinned == false and (value & HOT_REPLICAS_PINNED))
+      {
+        wanted= value & ~uint64_t(HOT_REPLICAS_COPIED);
+      }
+
+      if (wanted == value or
+          __atomic_compare_exchange_n(slot, &value, wanted, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      {
+        break;
+      }
+    }
+  }
+}
+
+memcached_return_t memcached_hot_replicas_create(Memcached *ptr)
+{
+  memcached_hot_replicas_free(ptr);
+
+  memcached_hot_replicas_st *table= (memcached_hot_replicas_st *)calloc(1, sizeof(memcached_hot_replicas_st));
+  if (table == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  table->refcount= 1;
+  ptr->hot_replicas.table= table;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_hot_replicas_clone(Memcached *clone, const Memcached *source)
+{
+  memcached_hot_replicas_st *table= source->hot_replicas.table;
+  if (table)
+  {
+    __atomic_add_fetch(&table->refcount, 1, __ATOMIC_RELAXED);
+  }
+
+  clone->hot_replicas.table= table;
+  clone->hot_replicas.replicas= source->hot_replicas.replicas;
+  clone->hot_replicas.threshold= source->hot_replicas.threshold;
+}
+
+void memcached_hot_replicas_free(Memcached *ptr)
+{
+  memcached_hot_replicas_st *table= ptr->hot_replicas.table;
+  ptr->hot_replicas.table= NULL;
+
+  if (table and __atomic_sub_fetch(&table->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    free(table);
+  }
+}
+
+uint32_t memcached_hot_replicas_count(const Memcached *ptr)
+{
+  uint32_t server_count= memcached_server_count(ptr);
+  if (ptr->hot_replicas.table == NULL or server_count < 2)
+  {
+    return 0;
+  }
+
+  return ptr->hot_replicas.replicas < server_count ? ptr->hot_replicas.replicas : server_count -1;
+}
+
+memcached_hot_replicas_action_t memcached_hot_replicas_write(Memcached *ptr,
+                                                             const char *key, size_t key_length,
+                                                             bool set)
+{
+  memcached_hot_replicas_st *table= ptr->hot_replicas.table;
+  if (memcached_hot_replicas_count(ptr) == 0)
+  {
+    return HOT_REPLICAS_NONE;
+  }
+
+  uint64_t tag= hot_replicas_tag(key, key_length);
+  uint64_t *slot= hot_replicas_find(table, tag);
+  if (set)
+  {
+    bool pinned= slot and (__atomic_load_n(slot, __ATOMIC_RELAXED) & HOT_REPLICAS_PINNED);
+    if (pinned or (ptr->hot_replicas.threshold and
+                   memcached_hot_keys_estimate(ptr, key, key_length) >= ptr->hot_replicas.threshold))
+    {
+      if (pinned or hot_replicas_insert(table, tag, false))
+      {
+        return HOT_REPLICAS_COPY;
+      }
+    }
+  }
+
+  if (slot == NULL)
+  {
+    return HOT_REPLICAS_NONE;
+  }
+
+  /* Copies that are not rewritten are deleted, reads go back to the key's own server */
+  hot_replicas_remove(table, tag, false);
+
+  return HOT_REPLICAS_DROP;
+}
+
+void memcached_hot_replicas_copied(Memcached *ptr, const char *key, size_t key_length)
+{
+  uint64_t tag= hot_replicas_tag(key, key_length);
+
+  uint64_t *slot;
+  if ((slot= hot_replicas_find(ptr->hot_replicas.table, tag)))
+  {
+    hot_replicas_update(slot, tag, HOT_REPLICAS_COPIED, 0);
+  }
+}
+
+void memcached_hot_replicas_drop(Memcached *ptr, uint32_t server_key,
+                                 const char *key, size_t key_length, bool flush)
+{
+  uint32_t replicas= memcached_hot_replicas_count(ptr);
+  for (uint32_t x= 0; x < replicas; ++x)
+  {
+    if (++server_key == memcached_server_count(ptr))
+    {
+      server_key= 0;
+    }
+
+    memcached_instance_st* instance= memcached_instance_fetch(ptr, server_key);
+
+    protocol_binary_request_delete request= {};
+    initialize_binary_request(instance, request.message.header);
+    /* A miss comes back, it must not be taken for the answer to a batched key */
+    request.message.header.request.opaque= htonl(UINT32_MAX);
+    request.message.header.request.opcode= PROTOCOL_BINARY_CMD_DELETEQ;
+    request.message.header.request.keylen= htons(uint16_t(key_length + memcached_array_size(ptr->_namespace)));
+    request.message.header.request.datatype= PROTOCOL_BINARY_RAW_BYTES;
+    request.message.header.request.bodylen= htonl(uint32_t(key_length + memcached_array_size(ptr->_namespace)));
+
+    libmemcached_io_vector_st vector[]=
+    {
+      { NULL, 0 },
+      { request.bytes, sizeof(request.bytes) },
+      { memcached_array_string(ptr->_namespace), memcached_array_size(ptr->_namespace) },
+      { key, key_length }
+    };
+
+    if (memcached_fatal(memcached_vdo(instance, vector, 4, flush)))
+    {
+      memcached_io_reset(instance);
+    }
+    else
+    {
+      memcached_server_response_decrement(instance);
+    }
+  }
+}
+
+void memcached_hot_replicas_changed(Memcached *ptr, uint32_t server_key,
+                                    const char *key, size_t key_length, bool flush)
+{
+  if (ptr->hot_replicas.table and ptr->number_of_replicas == 0 and memcached_is_binary(ptr) and
+      memcached_hot_replicas_write(ptr, key, key_length, false) == HOT_REPLICAS_DROP)
+  {
+    memcached_hot_replicas_drop(ptr, server_key, key, key_length, flush);
+  }
+}
+
+uint32_t memcached_hot_replicas_read(Memcached *ptr, uint32_t server_key,
+                                     const char *key, size_t key_length)
+{
+  uint32_t replicas= memcached_hot_replicas_count(ptr);
+  if (replicas == 0 or ptr->hot_replicas.read_primary)
+  {
+    return server_key;
+  }
+
+  /* A key pinned before any set, or whose copies were deleted, has none to read */
+  uint64_t *slot= hot_replicas_find(ptr->hot_replicas.table, hot_replicas_tag(key, key_length));
+  if (slot == NULL or (__atomic_load_n(slot, __ATOMIC_ACQUIRE) & HOT_REPLICAS_COPIED) == 0)
+  {
+    return server_key;
+  }
+
+  /* Each handle goes round the copies on its own */
+  uint32_t copy= ptr->hot_replicas.next++ % (replicas +1);
+  if (copy)
+  {
+    ptr->hot_replicas.read_replica= true;
+  }
+
+  return (server_key +copy) % memcached_server_count(ptr);
+}
+
+memcached_return_t memcached_hot_key_replicate(memcached_st *shell,
+                                               const char *key, size_t key_length,
+                                               bool replicate)
+{
+  Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL or key == NULL or key_length == 0 or key_length >= MEMCACHED_MAX_KEY)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (ptr->hot_replicas.table == NULL)
+  {
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  uint64_t tag= hot_replicas_tag(key, key_length);
+  if (replicate == false)
+  {
+    hot_replicas_remove(ptr->hot_replicas.table, tag, true);
+    return MEMCACHED_SUCCESS;
+  }
+
+  if (hot_replicas_insert(ptr->hot_replicas.table, tag, true) == false)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT,
+                               memcached_literal_param("No room left for the key in the hot key table"));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Approximate per key request counts, shared by reference count between a
+  handle and every handle cloned from it. Keys are counted in a count-min
+  sketch updated with atomic increments; the heaviest ones are kept in a
+  small heap that is only touched when a key beats the lightest of them,
+  and skipped rather than waited for when another thread holds it.
+*/
+struct memcached_hot_keys_st;
+
+memcached_return_t memcached_hot_keys_create(Memcached *ptr, uint32_t size);
+
+void memcached_hot_keys_clone(Memcached *clone, const Memcached *source);
+
+void memcached_hot_keys_free(Memcached *ptr);
+
+/* Number of keys tracked, 0 when disabled */
+uint32_t memcached_hot_keys_size(const Memcached *ptr);
+
+void memcached_hot_keys_record(Memcached *ptr, const char *key, size_t key_length);
+
+/* Estimated requests of a key, 0 when disabled */
+uint32_t memcached_hot_keys_estimate(Memcached *ptr, const char *key, size_t key_length);
+
+/*
+  Keys copied to the servers following their own, shared like the counts
+  above. A key is in the table once it was written while hot, or pinned
+  by the application, and reads of it are spread over the copies once a
+  set wrote them. The table is read and updated with atomic operations
+  only.
+*/
+struct memcached_hot_replicas_st;
+
+enum memcached_hot_replicas_action_t
+{
+  HOT_REPLICAS_NONE, // The key has no copies
+  HOT_REPLICAS_COPY, // Send the write to the replicas too
+  HOT_REPLICAS_DROP // Delete the copies, they would be out of date
+};
+
+memcached_return_t memcached_hot_replicas_create(Memcached *ptr);
+
+void memcached_hot_replicas_clone(Memcached *clone, const Memcached *source);
+
+void memcached_hot_replicas_free(Memcached *ptr);
+
+/* Copies of a hot key beside the one on its own server */
+uint32_t memcached_hot_replicas_count(const Memcached *ptr);
+
+/*
+  What to do with the copies of a key being written, set is true when the
+  whole value is replaced and so can be copied.
+*/
+memcached_hot_replicas_action_t memcached_hot_replicas_write(Memcached *ptr,
+                                                             const char *key, size_t key_length,
+                                                             bool set);
+
+/* Send a quiet delete of the key to its replicas */
+void memcached_hot_replicas_drop(Memcached *ptr, uint32_t server_key,
+                                 const char *key, size_t key_length, bool flush);
+
+/* The copies of a key were all written, its reads can be spread over them */
+void memcached_hot_replicas_copied(Memcached *ptr, const char *key, size_t key_length);
+
+/*
+  A write other than a set, such as an increment or a touch, changed the
+  key on its own server: delete its copies and read it from there again.
+*/
+void memcached_hot_replicas_changed(Memcached *ptr, uint32_t server_key,
+                                    const char *key, size_t key_length, bool flush);
+
+/* The server to read a key from, its own one or one of its replicas */
+uint32_t memcached_hot_replicas_read(Memcached *ptr, uint32_t server_key,
+                                     const char *key, size_t key_length);
@@ -45,9 +45,11 @@ static inline void _server_init(memcached_instance_st* self, Memcached *root,
   self->options.is_shutting_down= false;
   self->options.is_dead= false;
   self->options.ready= false;
+  self->options.is_readable_registered= false;
   self->_events= 0;
   self->_revents= 0;
   self->cursor_active_= 0;
+  self->stale_responses= 0;
   self->port_= port;
   self->fd= INVALID_SOCKET;
   self->io_bytes_sent= 0;
@@ -87,6 +89,20 @@ static inline void _server_init(memcached_instance_st* self, Memcached *root,
   }
   self->limit_maxbytes= 0;
   self->hostname(hostname);
+
+  self->ketama.points= NULL;
+  self->ketama.count= 0;
+  self->ketama.size= 0;
+  self->ketama.version= 0;
+  self->ketama.in_continuum= false;
+
+  self->stats.counters= NULL;
+  self->stats.started= 0;
+  self->stats.operation= MEMCACHED_OPERATION_GET;
+
+  self->latency.average= 0;
+  self->latency.samples= 0;
+  self->latency.strikes= 0;
 }
 
 static memcached_instance_st* _server_create(memcached_instance_st* self, const memcached_st *memc)
@@ -173,6 +189,11 @@ void __instance_free(memcached_instance_st* self)
 
   memcached_error_free(*self);
 
+  libmemcached_free(self->root, self->ketama.points);
+  self->ketama.points= NULL;
+
+  memcached_server_stats_free(self);
+
   if (memcached_is_allocated(self))
   {
     libmemcached_free(self->root, self);
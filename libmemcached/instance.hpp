@@ -104,6 +104,7 @@ struct memcached_instance_st {
     bool is_shutting_down;
     bool is_dead;
     bool ready;
+    bool is_readable_registered;
   } options;
 
   short _events;
@@ -142,6 +143,7 @@ struct memcached_instance_st {
   void revents(short);
 
   uint32_t cursor_active_;
+  uint32_t stale_responses; // Late replies to a hedged get, dropped before the next request
   in_port_t port_;
   memcached_socket_t fd;
   uint32_t io_bytes_sent; /* # bytes sent since last read */
@@ -176,12 +178,30 @@ struct memcached_instance_st {
   char read_buffer[MEMCACHED_MAX_BUFFER];
   char write_buffer[MEMCACHED_MAX_BUFFER];
   char _hostname[MEMCACHED_NI_MAXHOST];
+  struct {
+    uint32_t *points; // Ketama points of this server, in the order they were generated
+    uint32_t count;
+    uint32_t size;
+    uint32_t version; // root->ketama.points_version the points were generated for
+    bool in_continuum;
+  } ketama;
+  struct {
+    struct memcached_server_stats_st *counters; // Allocated on the first request recorded
+    uint64_t started; // Microseconds, 0 when no request is being timed
+    memcached_operation_t operation;
+  } stats;
+  struct {
+    uint64_t average; // Moving average of the reply latency, in microseconds times 8
+    uint32_t samples; // Replies timed since the server was last put back
+    uint32_t strikes; // Times in a row the server was ejected for being slow
+  } latency;
 
   void clear_addrinfo()
   {
     if (address_info)
     {
-      freeaddrinfo(address_info);
+      // A single allocation made by memcached_dns_getaddrinfo()
+      free(address_info);
       address_info= NULL;
       address_info_next= NULL;
     }
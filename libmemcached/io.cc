@@ -43,6 +43,10 @@
 # include <sys/socket.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+
 void initialize_binary_request(memcached_instance_st* server, protocol_binary_request_header& header)
 {
   server->request_id++;
@@ -417,12 +421,13 @@ memcached_return_t memcached_io_wait_for_read(memcached_instance_st* instance)
   return io_wait(instance, POLLIN);
 }
 
-static memcached_return_t _io_fill(memcached_instance_st* instance)
+static memcached_return_t _io_recv(memcached_instance_st* instance,
+                                   char *buffer, const size_t length,
+                                   ssize_t& data_read)
 {
-  ssize_t data_read;
   do
   {
-    data_read= ::recv(instance->fd, instance->read_buffer, MEMCACHED_MAX_BUFFER, MSG_NOSIGNAL);
+    data_read= ::recv(instance->fd, buffer, length, MSG_NOSIGNAL);
     int local_errno= get_socket_errno(); // We cache in case memcached_quit_server() modifies errno
 
     if (data_read == SOCKET_ERROR)
@@ -488,6 +493,19 @@ static memcached_return_t _io_fill(memcached_instance_st* instance)
   } while (data_read <= 0);
 
   instance->io_bytes_sent= 0;
+
+  return MEMCACHED_SUCCESS;
+}
+
+static memcached_return_t _io_fill(memcached_instance_st* instance)
+{
+  ssize_t data_read;
+  memcached_return_t rc;
+  if (memcached_fatal(rc= _io_recv(instance, instance->read_buffer, MEMCACHED_MAX_BUFFER, data_read)))
+  {
+    return rc;
+  }
+
   instance->read_data_length= (size_t) data_read;
   instance->read_buffer_length= (size_t) data_read;
   instance->read_ptr= instance->read_buffer;
@@ -676,10 +694,237 @@ ssize_t memcached_io_write(memcached_instance_st* instance,
   return ssize_t(written);
 }
 
+#ifndef __MINGW32__
+/*
+  Largest vector we will hand to _io_writev_zero_copy(), every element can
+  add at most two iovec entries (the coalesced write_buffer segment that
+  precedes it, and itself).
+*/
+#define MAX_ZERO_COPY_VECTOR 16
+
+/**
+ * Send a list of iovec with sendmsg(), restarting after partial writes. The
+ * list may reference the write_buffer, so the buffer is marked as empty
+ * before we start so that nothing reentrant (i.e. memcached_purge()) will
+ * send it a second time.
+ */
+static bool io_flush_vector(memcached_instance_st* instance,
+                            struct iovec *iov, size_t iov_count,
+                            const bool with_flush,
+                            memcached_return_t& error)
+{
+  error= MEMCACHED_SUCCESS;
+  instance->write_buffer_offset= 0;
+
+  while (iov_count)
+  {
+    WATCHPOINT_ASSERT(instance->fd != INVALID_SOCKET);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov= iov;
+#ifdef __APPLE__
+    msg.msg_iovlen= int(iov_count);
+#else
+    msg.msg_iovlen= iov_count;
+#endif
+
+    int flags;
+    if (with_flush)
+    {
+      flags= MSG_NOSIGNAL;
+    }
+    else
+    {
+      flags= MSG_NOSIGNAL|MSG_MORE;
+    }
+
+    ssize_t sent_length= ::sendmsg(instance->fd, &msg, flags);
+    int local_errno= get_socket_errno(); // We cache in case memcached_quit_server() modifies errno
+
+    if (sent_length == SOCKET_ERROR)
+    {
+      switch (get_socket_errno())
+      {
+      case ENOBUFS:
+        continue;
+
+#if EWOULDBLOCK != EAGAIN
+      case EWOULDBLOCK:
+#endif
+      case EAGAIN:
+        {
+          if (repack_input_buffer(instance) or process_input_buffer(instance))
+          {
+            continue;
+          }
+
+          memcached_return_t rc= io_wait(instance, POLLOUT);
+          if (memcached_success(rc))
+          {
+            continue;
+          }
+          else if (rc == MEMCACHED_TIMEOUT)
+          {
+            return false;
+          }
+
+          memcached_quit_server(instance, true);
+          error= memcached_set_errno(*instance, local_errno, MEMCACHED_AT);
+          return false;
+        }
+      case ENOTCONN:
+      case EPIPE:
+      default:
+        memcached_quit_server(instance, true);
+        error= memcached_set_errno(*instance, local_errno, MEMCACHED_AT);
+        WATCHPOINT_ASSERT(instance->fd == INVALID_SOCKET);
+        return false;
+      }
+    }
+
+    instance->io_bytes_sent+= uint32_t(sent_length);
+
+    // Skip past everything that was sent, and trim the entry we stopped in.
+    size_t remaining= size_t(sent_length);
+    while (iov_count and remaining >= iov->iov_len)
+    {
+      remaining-= iov->iov_len;
+      ++iov;
+      --iov_count;
+    }
+
+    if (iov_count)
+    {
+      iov->iov_base= static_cast<char *>(iov->iov_base) +remaining;
+      iov->iov_len-= remaining;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Write a vector without copying its large elements. Small elements are
+ * still coalesced in the write_buffer, but any element of at least
+ * io_zero_copy_threshold bytes is handed to sendmsg() pointing at the
+ * caller's memory. Since the caller's memory is only valid for the length of
+ * the call, everything staged is sent before we return, even if with_flush
+ * is false.
+ */
+static bool _io_writev_zero_copy(memcached_instance_st* instance,
+                                 libmemcached_io_vector_st vector[],
+                                 const size_t number_of, const bool with_flush)
+{
+  WATCHPOINT_ASSERT(instance->fd != INVALID_SOCKET);
+
+  if (memcached_purge(instance) == false)
+  {
+    return false;
+  }
+
+  struct iovec iov[(MAX_ZERO_COPY_VECTOR * 2) +1];
+  size_t iov_count= 0;
+  size_t segment_start= 0; // Start of the write_buffer not yet referenced by iov
+  memcached_return_t rc;
+
+  for (size_t x= 0; x < number_of; ++x)
+  {
+    if (vector[x].length == 0)
+    {
+      continue;
+    }
+
+    if (vector[x].length >= instance->root->io_zero_copy_threshold)
+    {
+      if (instance->write_buffer_offset > segment_start)
+      {
+        iov[iov_count].iov_base= instance->write_buffer +segment_start;
+        iov[iov_count].iov_len= instance->write_buffer_offset -segment_start;
+        ++iov_count;
+        segment_start= instance->write_buffer_offset;
+      }
+
+      iov[iov_count].iov_base= const_cast<void *>(vector[x].buffer);
+      iov[iov_count].iov_len= vector[x].length;
+      ++iov_count;
+
+      continue;
+    }
+
+    const char *buffer_ptr= static_cast<const char *>(vector[x].buffer);
+    size_t length= vector[x].length;
+    while (length)
+    {
+      if (instance->write_buffer_offset == MEMCACHED_MAX_BUFFER)
+      {
+        if (instance->write_buffer_offset > segment_start)
+        {
+          iov[iov_count].iov_base= instance->write_buffer +segment_start;
+          iov[iov_count].iov_len= instance->write_buffer_offset -segment_start;
+          ++iov_count;
+        }
+
+        if (io_flush_vector(instance, iov, iov_count, false, rc) == false)
+        {
+          return false;
+        }
+        iov_count= 0;
+        segment_start= 0;
+      }
+
+      size_t should_write= MEMCACHED_MAX_BUFFER -instance->write_buffer_offset;
+      should_write= (should_write < length) ? should_write : length;
+
+      memcpy(instance->write_buffer +instance->write_buffer_offset, buffer_ptr, should_write);
+      instance->write_buffer_offset+= should_write;
+      buffer_ptr+= should_write;
+      length-= should_write;
+    }
+  }
+
+  if (instance->write_buffer_offset > segment_start)
+  {
+    iov[iov_count].iov_base= instance->write_buffer +segment_start;
+    iov[iov_count].iov_len= instance->write_buffer_offset -segment_start;
+    ++iov_count;
+  }
+
+  return io_flush_vector(instance, iov, iov_count, with_flush, rc);
+}
+
+static bool _io_wants_zero_copy(const memcached_instance_st* instance,
+                                const libmemcached_io_vector_st vector[],
+                                const size_t number_of)
+{
+  if (memcached_is_zero_copy(instance->root) == false or number_of > MAX_ZERO_COPY_VECTOR)
+  {
+    return false;
+  }
+
+  for (size_t x= 0; x < number_of; ++x)
+  {
+    if (vector[x].length >= instance->root->io_zero_copy_threshold)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
 bool memcached_io_writev(memcached_instance_st* instance,
                          libmemcached_io_vector_st vector[],
                          const size_t number_of, const bool with_flush)
 {
+#ifndef __MINGW32__
+  if (_io_wants_zero_copy(instance, vector, number_of))
+  {
+    return _io_writev_zero_copy(instance, vector, number_of, with_flush);
+  }
+#endif
+
   ssize_t complete_total= 0;
   ssize_t total= 0;
 
@@ -721,9 +966,12 @@ void memcached_instance_st::reset_socket()
 {
   if (fd != INVALID_SOCKET)
   {
+    memcached_io_readable_remove(this);
     (void)closesocket(fd);
     fd= INVALID_SOCKET;
   }
+  stats.started= 0; // The reply being timed will never come
+  stale_responses= 0;
 }
 
 void memcached_instance_st::close_socket()
@@ -762,47 +1010,194 @@ void memcached_instance_st::close_socket()
   major_version= minor_version= micro_version= UINT8_MAX;
 }
 
-memcached_instance_st* memcached_io_get_readable_server(Memcached *memc, memcached_return_t&)
+/*
+  Every connected socket of a memcached_st is kept in one epoll set so that
+  finding a server with a pending response does not depend on the number of
+  servers. The event carries the position of the instance in the host list
+  together with its fd. The host list can be reallocated or sorted while
+  sockets are open, so the pair is checked before it is trusted.
+*/
+#define MEMCACHED_READABLE_EVENTS 32
+#define MEMCACHED_READABLE_STACK_FDS 64
+
+#ifdef HAVE_SYS_EPOLL_H
+static inline uint64_t readable_key(uint32_t server_key, memcached_socket_t fd)
 {
-#define MAX_SERVERS_TO_POLL 100
-  struct pollfd fds[MAX_SERVERS_TO_POLL];
-  nfds_t host_index= 0;
+  return (uint64_t(server_key) << 32) | uint32_t(fd);
+}
+#endif
 
-  for (uint32_t x= 0; x < memcached_server_count(memc) and host_index < MAX_SERVERS_TO_POLL; ++x)
+void memcached_io_readable_add(memcached_instance_st* instance)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  Memcached *memc= instance->root;
+  if (memc == NULL or instance->fd == INVALID_SOCKET or instance->options.is_readable_registered)
   {
-    memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+    return;
+  }
 
-    if (instance->read_buffer_length > 0) /* I have data in the buffer */
+  if (memcached_is_udp(memc) or instance->type == MEMCACHED_CONNECTION_UDP)
+  {
+    return;
+  }
+
+  // Only instances that live in the host list can be found again by position
+  const memcached_instance_st* list= memcached_instance_list(memc);
+  if (list == NULL or instance < list or instance >= list + memcached_server_count(memc))
+  {
+    return;
+  }
+
+  if (memc->epoll_fd == -1)
+  {
+    // On failure memcached_io_get_readable_server() falls back to poll()
+    if ((memc->epoll_fd= epoll_create1(EPOLL_CLOEXEC)) == -1)
+    {
+      return;
+    }
+  }
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events= EPOLLIN;
+  event.data.u64= readable_key(uint32_t(instance - list), instance->fd);
+  if (epoll_ctl(memc->epoll_fd, EPOLL_CTL_ADD, instance->fd, &event) == 0)
+  {
+    instance->options.is_readable_registered= true;
+  }
+#else
+  (void)instance;
+#endif
+}
+
+void memcached_io_readable_remove(memcached_instance_st* instance)
+{
+  if (instance->options.is_readable_registered)
+  {
+#ifdef HAVE_SYS_EPOLL_H
+    if (instance->root and instance->root->epoll_fd != -1)
+    {
+      struct epoll_event event; // Kernels before 2.6.9 require a non-NULL event
+      memset(&event, 0, sizeof(event));
+      (void)epoll_ctl(instance->root->epoll_fd, EPOLL_CTL_DEL, instance->fd, &event);
+    }
+#endif
+    instance->options.is_readable_registered= false;
+  }
+}
+
+void memcached_io_readable_close(Memcached *memc)
+{
+#ifdef HAVE_SYS_EPOLL_H
+  if (memc->epoll_fd != -1)
+  {
+    (void)close(memc->epoll_fd);
+  }
+#endif
+  memc->epoll_fd= -1;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static memcached_instance_st* epoll_instance(Memcached *memc, const struct epoll_event& event)
+{
+  uint32_t server_key= uint32_t(event.data.u64 >> 32);
+  memcached_socket_t fd= memcached_socket_t(event.data.u64 & UINT32_MAX);
+
+  if (server_key < memcached_server_count(memc))
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(memc, server_key);
+    if (instance->fd == fd)
     {
       return instance;
     }
+  }
 
-    if (instance->response_count() > 0)
+  // The host list has changed underneath us, find the socket and fix the key
+  for (uint32_t x= 0; x < memcached_server_count(memc); ++x)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+
+    if (instance->fd == fd)
     {
-      fds[host_index].events= POLLIN;
-      fds[host_index].revents= 0;
-      fds[host_index].fd= instance->fd;
-      ++host_index;
+      struct epoll_event update;
+      memset(&update, 0, sizeof(update));
+      update.events= EPOLLIN;
+      update.data.u64= readable_key(x, fd);
+      (void)epoll_ctl(memc->epoll_fd, EPOLL_CTL_MOD, fd, &update);
+
+      return instance;
     }
   }
 
-  if (host_index < 2)
+  return NULL;
+}
+
+/*
+  Returns false if the epoll set could not give an answer, in which case
+  the caller should fall back to poll().
+*/
+static bool epoll_readable_server(Memcached *memc, memcached_instance_st*& ready, const int timeout)
+{
+  struct epoll_event events[MEMCACHED_READABLE_EVENTS];
+
+  ready= NULL;
+  int count= epoll_wait(memc->epoll_fd, events, MEMCACHED_READABLE_EVENTS, timeout);
+  switch (count)
   {
-    /* We have 0 or 1 server with pending events.. */
-    for (uint32_t x= 0; x< memcached_server_count(memc); ++x)
+  case -1:
+    memcached_set_errno(*memc, get_socket_errno(), MEMCACHED_AT);
+    /* FALLTHROUGH */
+  case 0:
+    return true;
+
+  default:
+    for (int x= 0; x < count; ++x)
     {
-      memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+      memcached_instance_st* instance= epoll_instance(memc, events[x]);
 
-      if (instance->response_count() > 0)
+      if (instance and instance->response_count() > 0)
       {
-        return instance;
+        ready= instance;
+        return true;
       }
     }
+  }
+
+  // Only sockets we are not waiting on were ready
+  return false;
+}
+#endif
+
+static memcached_instance_st* poll_readable_server(Memcached *memc, const uint32_t pending, const int timeout)
+{
+  struct pollfd stack_fds[MEMCACHED_READABLE_STACK_FDS];
+  struct pollfd *fds= stack_fds;
 
-    return NULL;
+  if (pending > MEMCACHED_READABLE_STACK_FDS)
+  {
+    if ((fds= libmemcached_xcalloc(memc, pending, struct pollfd)) == NULL)
+    {
+      memcached_set_error(*memc, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+      return NULL;
+    }
   }
 
-  int error= poll(fds, host_index, memc->poll_timeout);
+  nfds_t host_index= 0;
+  for (uint32_t x= 0; x < memcached_server_count(memc) and host_index < pending; ++x)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+
+    if (instance->response_count() > 0)
+    {
+      fds[host_index].events= POLLIN;
+      fds[host_index].revents= 0;
+      fds[host_index].fd= instance->fd;
+      ++host_index;
+    }
+  }
+
+  memcached_instance_st* ready= NULL;
+  int error= poll(fds, host_index, timeout);
   switch (error)
   {
   case -1:
@@ -812,24 +1207,88 @@ memcached_instance_st* memcached_io_get_readable_server(Memcached *memc, memcach
     break;
 
   default:
-    for (nfds_t x= 0; x < host_index; ++x)
+    // fds[] was filled in host list order, so walk the list the same way
+    host_index= 0;
+    for (uint32_t x= 0; x < memcached_server_count(memc) and host_index < pending; ++x)
     {
-      if (fds[x].revents & POLLIN)
+      memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+
+      if (instance->response_count() > 0)
       {
-        for (uint32_t y= 0; y < memcached_server_count(memc); ++y)
+        if (fds[host_index].revents & POLLIN)
         {
-          memcached_instance_st* instance= memcached_instance_fetch(memc, y);
-
-          if (instance->fd == fds[x].fd)
-          {
-            return instance;
-          }
+          ready= instance;
+          break;
         }
+        ++host_index;
       }
     }
   }
 
-  return NULL;
+  if (fds != stack_fds)
+  {
+    libmemcached_free(memc, fds);
+  }
+
+  return ready;
+}
+
+static memcached_instance_st* readable_server(Memcached *memc, const int timeout, const bool always_wait)
+{
+  uint32_t pending= 0;
+  bool all_registered= true;
+  memcached_instance_st* first_pending= NULL;
+
+  for (uint32_t x= 0; x < memcached_server_count(memc); ++x)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(memc, x);
+
+    if (instance->read_buffer_length > 0) /* I have data in the buffer */
+    {
+      return instance;
+    }
+
+    if (instance->response_count() > 0)
+    {
+      if (pending == 0)
+      {
+        first_pending= instance;
+      }
+      all_registered= all_registered and instance->options.is_readable_registered;
+      ++pending;
+    }
+  }
+
+  if (pending == 0 or (pending == 1 and always_wait == false))
+  {
+    /* We have 0 or 1 server with pending events.. */
+    return first_pending;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (all_registered and memc->epoll_fd != -1)
+  {
+    memcached_instance_st* ready;
+    if (epoll_readable_server(memc, ready, timeout))
+    {
+      return ready;
+    }
+  }
+#else
+  (void)all_registered;
+#endif
+
+  return poll_readable_server(memc, pending, timeout);
+}
+
+memcached_instance_st* memcached_io_get_readable_server(Memcached *memc, memcached_return_t&)
+{
+  return readable_server(memc, memc->poll_timeout, false);
+}
+
+memcached_instance_st* memcached_io_get_readable_server(Memcached *memc, const int timeout)
+{
+  return readable_server(memc, timeout, true);
 }
 
 /*
@@ -869,6 +1328,58 @@ memcached_return_t memcached_safe_read(memcached_instance_st* instance,
   return MEMCACHED_SUCCESS;
 }
 
+/**
+ * Read a value of a known size into its final destination. Whatever is
+ * already sitting in the read buffer is copied out first, after which the
+ * remainder is recv()'d directly into the caller's buffer. The tail of the
+ * value is read through the read buffer again so that a single recv() can
+ * also pick up the responses that follow it.
+ */
+memcached_return_t memcached_io_read_value(memcached_instance_st* instance,
+                                           void *dta,
+                                           const size_t size)
+{
+  assert(memcached_is_udp(instance->root) == false);
+  char *data= static_cast<char *>(dta);
+  size_t length= size;
+
+  if (instance->fd == INVALID_SOCKET)
+  {
+    return MEMCACHED_CONNECTION_FAILURE;
+  }
+
+  if (instance->read_buffer_length)
+  {
+    size_t difference= (length > instance->read_buffer_length) ? instance->read_buffer_length : length;
+
+    memcpy(data, instance->read_ptr, difference);
+    instance->read_ptr+= difference;
+    instance->read_buffer_length-= difference;
+    data+= difference;
+    length-= difference;
+  }
+
+  while (length >= MEMCACHED_MAX_BUFFER)
+  {
+    ssize_t data_read;
+    memcached_return_t rc;
+    if (memcached_fatal(rc= _io_recv(instance, data, length, data_read)))
+    {
+      return rc;
+    }
+
+    data+= data_read;
+    length-= size_t(data_read);
+  }
+
+  if (length)
+  {
+    return memcached_safe_read(instance, data, length);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
 memcached_return_t memcached_io_readline(memcached_instance_st* instance,
                                          char *buffer_ptr,
                                          size_t size,
@@ -68,6 +68,19 @@ memcached_return_t memcached_safe_read(memcached_instance_st* ptr,
                                        void *dta,
                                        const size_t size);
 
+/* Read n bytes of value data straight into dta, bypassing the read buffer when possible */
+memcached_return_t memcached_io_read_value(memcached_instance_st* ptr,
+                                           void *dta,
+                                           const size_t size);
+
 memcached_instance_st* memcached_io_get_readable_server(memcached_st *memc, memcached_return_t&);
 
+/* Waits at most timeout milliseconds, even for a single server, NULL when none became readable */
+memcached_instance_st* memcached_io_get_readable_server(memcached_st *memc, const int timeout);
+
+/* Keep the readiness set of the root memcached_st in sync with the instance's socket */
+void memcached_io_readable_add(memcached_instance_st* ptr);
+void memcached_io_readable_remove(memcached_instance_st* ptr);
+void memcached_io_readable_close(memcached_st *memc);
+
 memcached_return_t memcached_io_slurp(memcached_instance_st* ptr);
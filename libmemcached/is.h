@@ -58,6 +58,8 @@
 #define memcached_is_tcp_nodelay(__object) ((__object)->flags.tcp_nodelay)
 #define memcached_is_auto_eject_hosts(__object) ((__object)->flags.auto_eject_hosts)
 #define memcached_is_use_sort_hosts(__object) ((__object)->flags.use_sort_hosts)
+#define memcached_is_zero_copy(__object) ((__object)->flags.zero_copy)
+#define memcached_is_ketama_lookup_table(__object) ((__object)->flags.ketama_lookup_table)
 
 #define memcached_is_ready(__object) ((__object)->options.ready)
 
@@ -79,6 +81,7 @@
 #define memcached_set_tcp_nodelay(__object, __flag) ((__object).flags.tcp_nodelay= __flag)
 #define memcached_set_auto_eject_hosts(__object, __flag) ((__object).flags.auto_eject_hosts= __flag)
 #define memcached_set_use_sort_hosts(__object, __flag) ((__object).flags.use_sort_hosts= __flag)
+#define memcached_set_zero_copy(__object, __flag) ((__object).flags.zero_copy= __flag)
 
 #define memcached_has_root(__object) ((__object)->root)
 
@@ -87,6 +90,7 @@
 #define memcached_has_replicas(__object) ((__object)->root->number_of_replicas)
 
 #define memcached_set_processing_input(__object, __value) ((__object)->state.is_processing_input= (__value))
+#define memcached_set_purging(__object, __value) ((__object)->state.is_purging= (__value))
 #define memcached_set_initialized(__object, __value) ((__object)->options.is_initialized= (__value))
 #define memcached_set_allocated(__object, __value) ((__object)->options.is_allocated= (__value))
 
@@ -62,6 +62,35 @@ static inline bool _memcached_init(Memcached *self)
   self->flags.tcp_keepalive= false;
   self->flags.is_aes= false;
   self->flags.is_fetching_version= false;
+  self->flags.zero_copy= false;
+  self->flags.ketama_lookup_table= false;
+  self->flags.server_stats= false;
+
+  self->near_cache.cache= NULL;
+  self->near_cache.budget= 0;
+  self->near_cache.ttl= MEMCACHED_NEAR_CACHE_TTL;
+  self->near_cache.hits= NULL;
+  self->near_cache.hits_count= 0;
+  self->near_cache.hits_fetched= 0;
+  self->near_cache.miss_keys= NULL;
+  self->near_cache.miss_key_length= NULL;
+  self->near_cache.size= 0;
+  self->near_cache.sent= 0;
+
+  self->hot_keys.tracker= NULL;
+  self->hot_keys.additions= 0;
+
+  self->hot_replicas.table= NULL;
+  self->hot_replicas.replicas= 0;
+  self->hot_replicas.threshold= 0;
+  self->hot_replicas.next= 0;
+  self->hot_replicas.read_replica= false;
+  self->hot_replicas.read_primary= false;
+
+  self->dns= NULL;
+
+  self->hedge.percentile= 0;
+  self->hedge.mget= NULL;
 
   self->virtual_bucket= NULL;
 
@@ -79,6 +108,10 @@ static inline bool _memcached_init(Memcached *self)
   self->ketama.continuum_points_counter= 0;
   self->ketama.next_distribution_rebuild= 0;
   self->ketama.weighted_= false;
+  self->ketama.lookup_bits= 0;
+  self->ketama.lookup= NULL;
+  self->ketama.points_version= 0;
+  self->ketama.continuum_version= 0;
 
   self->number_of_hosts= 0;
   self->servers= NULL;
@@ -88,6 +121,7 @@ static inline bool _memcached_init(Memcached *self)
   self->rcv_timeout= 0;
   self->server_failure_limit= MEMCACHED_SERVER_FAILURE_LIMIT;
   self->server_timeout_limit= MEMCACHED_SERVER_TIMEOUT_LIMIT;
+  self->latency_eject_factor= 0;
   self->query_id= 1; // 0 is considered invalid
 
   /* TODO, Document why we picked these defaults */
@@ -97,6 +131,7 @@ static inline bool _memcached_init(Memcached *self)
   self->tcp_keepidle= 0;
 
   self->io_key_prefetch= 0;
+  self->io_zero_copy_threshold= MEMCACHED_ZERO_COPY_THRESHOLD;
   self->poll_timeout= MEMCACHED_DEFAULT_TIMEOUT;
   self->connect_timeout= MEMCACHED_DEFAULT_CONNECT_TIMEOUT;
   self->retry_timeout= MEMCACHED_SERVER_FAILURE_RETRY_TIMEOUT;
@@ -104,9 +139,11 @@ static inline bool _memcached_init(Memcached *self)
 
   self->send_size= -1;
   self->recv_size= -1;
+  self->epoll_fd= -1;
 
   self->user_data= NULL;
   self->number_of_replicas= 0;
+  self->early_refresh= 0;
 
   self->allocators= memcached_allocators_return_default();
 
@@ -115,6 +152,7 @@ static inline bool _memcached_init(Memcached *self)
   self->get_key_failure= NULL;
   self->delete_trigger= NULL;
   self->callbacks= NULL;
+  self->single_flight= NULL;
   self->sasl.callbacks= NULL;
   self->sasl.is_allocated= false;
 
@@ -139,6 +177,8 @@ static void __memcached_free(Memcached *ptr, bool release_st)
 
   memcached_instance_free((memcached_instance_st*)ptr->last_disconnected_server);
 
+  memcached_io_readable_close(ptr);
+
   if (ptr->on_cleanup)
   {
     ptr->on_cleanup(ptr);
@@ -147,6 +187,20 @@ static void __memcached_free(Memcached *ptr, bool release_st)
   libmemcached_free(ptr, ptr->ketama.continuum);
   ptr->ketama.continuum= NULL;
 
+  libmemcached_free(ptr, ptr->ketama.lookup);
+  ptr->ketama.lookup= NULL;
+
+  memcached_single_flight_release(ptr);
+
+  memcached_near_cache_free(ptr);
+
+  memcached_hot_keys_free(ptr);
+
+  memcached_hot_replicas_free(ptr);
+
+  memcached_dns_free(ptr);
+  memcached_hedge_free(ptr);
+
   memcached_array_free(ptr->_namespace);
   ptr->_namespace= NULL;
 
@@ -285,6 +339,12 @@ void memcached_servers_reset(memcached_st *shell)
   {
     libmemcached_free(self, self->ketama.continuum);
     self->ketama.continuum= NULL;
+    self->ketama.continuum_count= 0;
+    self->ketama.continuum_points_counter= 0;
+
+    libmemcached_free(self, self->ketama.lookup);
+    self->ketama.lookup= NULL;
+    self->ketama.lookup_bits= 0;
 
     memcached_instance_list_free(memcached_instance_list(self), self->number_of_hosts);
     memcached_instance_set(self, NULL, 0);
@@ -362,12 +422,22 @@ memcached_st *memcached_clone(memcached_st *clone, const memcached_st *source)
 
   new_clone->get_key_failure= source->get_key_failure;
   new_clone->delete_trigger= source->delete_trigger;
+  memcached_single_flight_clone(new_clone, source);
+  memcached_near_cache_clone(new_clone, source);
+  new_clone->near_cache.ttl= source->near_cache.ttl;
+  memcached_hot_keys_clone(new_clone, source);
+  memcached_hot_replicas_clone(new_clone, source);
+  memcached_dns_clone(new_clone, source);
+  new_clone->hedge.percentile= source->hedge.percentile;
   new_clone->server_failure_limit= source->server_failure_limit;
   new_clone->server_timeout_limit= source->server_timeout_limit;
+  new_clone->latency_eject_factor= source->latency_eject_factor;
   new_clone->io_msg_watermark= source->io_msg_watermark;
   new_clone->io_bytes_watermark= source->io_bytes_watermark;
   new_clone->io_key_prefetch= source->io_key_prefetch;
+  new_clone->io_zero_copy_threshold= source->io_zero_copy_threshold;
   new_clone->number_of_replicas= source->number_of_replicas;
+  new_clone->early_refresh= source->early_refresh;
   new_clone->tcp_keepidle= source->tcp_keepidle;
 
   if (memcached_server_count(source))
@@ -0,0 +1,693 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+
+#define NEAR_CACHE_SHARD_BITS 4
+#define NEAR_CACHE_SHARDS (1 << NEAR_CACHE_SHARD_BITS)
+#define NEAR_CACHE_SKETCH_DEPTH 4
+#define NEAR_CACHE_COUNTER_MAX 15
+#define NEAR_CACHE_MAX_BUCKETS (1 << 20)
+#define NEAR_CACHE_STAMPS 64 // Invalidation stamps per shard, keys share them by hash
+
+struct memcached_near_cache_entry_st
+{
+  memcached_near_cache_entry_st *next; // Bucket chain
+  memcached_near_cache_entry_st *clock_prev;
+  memcached_near_cache_entry_st *clock_next;
+  uint32_t refcount; // The shard holds one, every queued hit another
+  uint32_t hash;
+  bool referenced; // CLOCK bit, set on every hit
+  time_t expires;
+  uint32_t flags;
+  uint64_t cas;
+  size_t key_length; // Namespace followed by the key
+  size_t value_length;
+
+  /* The key and the value, with a terminating zero, follow the entry */
+  char *key()
+  {
+    return reinterpret_cast<char *>(this +1);
+  }
+
+  char *value()
+  {
+    return key() +key_length;
+  }
+
+  size_t size() const
+  {
+    return sizeof(*this) +key_length +value_length +1;
+  }
+};
+
+struct near_cache_shard_st
+{
+  pthread_mutex_t mutex;
+  memcached_near_cache_entry_st **buckets;
+  uint32_t bucket_mask;
+  memcached_near_cache_entry_st *hand; // CLOCK hand over a circular list of every entry
+  uint8_t *sketch; // NEAR_CACHE_SKETCH_DEPTH rows of 4 bit counters, one per byte
+  uint32_t sketch_mask;
+  uint32_t sketch_additions;
+  uint32_t sketch_period; // Counters are halved after this many additions
+  size_t budget;
+  uint64_t invalidated[NEAR_CACHE_STAMPS]; // Count of the cache's invalidations when a key last was
+  memcached_near_cache_stat_st stat;
+};
+
+struct memcached_near_cache_st
+{
+  uint32_t refcount;
+  uint64_t invalidations; // Counted with atomic increments, stamps the shards' keys
+  near_cache_shard_st shards[NEAR_CACHE_SHARDS];
+};
+
+static uint32_t near_cache_hash(const char *prefix, size_t prefix_length,
+                                const char *key, size_t key_length)
+{
+  /* FNV-1a over the namespace and the key */
+  uint32_t hash= 2166136261U;
+  for (size_t x= 0; x < prefix_length; ++x)
+  {
+    hash^= uint8_t(prefix[x]);
+    hash*= 16777619U;
+  }
+
+  for (size_t x= 0; x < key_length; ++x)
+  {
+    hash^= uint8_t(key[x]);
+    hash*= 16777619U;
+  }
+
+  return hash;
+}
+
+static inline near_cache_shard_st& near_cache_shard(memcached_near_cache_st *cache, uint32_t hash)
+{
+  return cache->shards[hash >> (32 -NEAR_CACHE_SHARD_BITS)];
+}
+
+static inline uint64_t& near_cache_stamp(near_cache_shard_st& shard, uint32_t hash)
+{
+  return shard.invalidated[hash & (NEAR_CACHE_STAMPS -1)];
+}
+
+static uint32_t power_of_two(size_t wanted, uint32_t smallest, uint32_t largest)
+{
+  uint32_t size= smallest;
+  while (size < wanted and size < largest)
+  {
+    size<<= 1;
+  }
+
+  return size;
+}
+
+static inline uint32_t sketch_index(const near_cache_shard_st& shard, uint32_t hash, uint32_t row)
+{
+  uint32_t mixed= (hash ^ (row * 0x9e3779b9U)) * 0x85ebca6bU;
+  mixed^= mixed >> 13;
+
+  return row * (shard.sketch_mask +1) +(mixed & shard.sketch_mask);
+}
+
+static void sketch_increment(near_cache_shard_st& shard, uint32_t hash)
+{
+  for (uint32_t row= 0; row < NEAR_CACHE_SKETCH_DEPTH; ++row)
+  {
+    uint8_t& counter= shard.sketch[sketch_index(shard, hash, row)];
+    if (counter < NEAR_CACHE_COUNTER_MAX)
+    {
+      counter++;
+    }
+  }
+
+  /* Age every counter so that keys which went cold can be displaced */
+  if (++shard.sketch_additions >= shard.sketch_period)
+  {
+    for (uint32_t x= 0; x < NEAR_CACHE_SKETCH_DEPTH * (shard.sketch_mask +1); ++x)
+    {
+      shard.sketch[x]>>= 1;
+    }
+    shard.sketch_additions/= 2;
+  }
+}
+
+static uint8_t sketch_estimate(const near_cache_shard_st& shard, uint32_t hash)
+{
+  uint8_t estimate= NEAR_CACHE_COUNTER_MAX;
+  for (uint32_t row= 0; row < NEAR_CACHE_SKETCH_DEPTH; ++row)
+  {
+    uint8_t counter= shard.sketch[sketch_index(shard, hash, row)];
+    if (counter < estimate)
+    {
+      estimate= counter;
+    }
+  }
+
+  return estimate;
+}
+
+static void entry_release(memcached_near_cache_entry_st *entry)
+{
+  if (__atomic_sub_fetch(&entry->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+  {
+    free(entry);
+  }
+}
+
+static memcached_near_cache_entry_st *shard_find(near_cache_shard_st& shard, uint32_t hash,
+                                                 const char *prefix, size_t prefix_length,
+                                                 const char *key, size_t key_length)
+{
+  for (memcached_near_cache_entry_st *entry= shard.buckets[hash & shard.bucket_mask]; entry; entry= entry->next)
+  {
+    if (entry->hash == hash and
+        entry->key_length == prefix_length +key_length and
+        memcmp(entry->key(), prefix, prefix_length) == 0 and
+        memcmp(entry->key() +prefix_length, key, key_length) == 0)
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void shard_insert(near_cache_shard_st& shard, memcached_near_cache_entry_st *entry)
+{
+  memcached_near_cache_entry_st **bucket= &shard.buckets[entry->hash & shard.bucket_mask];
+  entry->next= *bucket;
+  *bucket= entry;
+
+  /* New entries go right behind the hand, the last place it will look */
+  if (shard.hand)
+  {
+    entry->clock_next= shard.hand;
+    entry->clock_prev= shard.hand->clock_prev;
+    shard.hand->clock_prev->clock_next= entry;
+    shard.hand->clock_prev= entry;
+  }
+  else
+  {
+    entry->clock_next= entry->clock_prev= entry;
+    shard.hand= entry;
+  }
+
+  shard.stat.items++;
+  shard.stat.bytes+= entry->size();
+}
+
+static void shard_remove(near_cache_shard_st& shard, memcached_near_cache_entry_st *entry)
+{
+  for (memcached_near_cache_entry_st **next= &shard.buckets[entry->hash & shard.bucket_mask]; *next; next= &(*next)->next)
+  {
+    if (*next == entry)
+    {
+      *next= entry->next;
+      break;
+    }
+  }
+
+  if (entry->clock_next == entry)
+  {
+    shard.hand= NULL;
+  }
+  else
+  {
+    entry->clock_prev->clock_next= entry->clock_next;
+    entry->clock_next->clock_prev= entry->clock_prev;
+    if (shard.hand == entry)
+    {
+      shard.hand= entry->clock_next;
+    }
+  }
+
+  shard.stat.items--;
+  shard.stat.bytes-= entry->size();
+  entry_release(entry);
+}
+
+/* Sweep the hand until it finds an expired entry, or one not hit since the last sweep */
+static memcached_near_cache_entry_st *shard_victim(near_cache_shard_st& shard, time_t now)
+{
+  while (shard.hand)
+  {
+    memcached_near_cache_entry_st *entry= shard.hand;
+    if (entry->expires <= now or entry->referenced == false)
+    {
+      return entry;
+    }
+    entry->referenced= false;
+    shard.hand= entry->clock_next;
+  }
+
+  return NULL;
+}
+
+static void cache_release(memcached_near_cache_st *cache)
+{
+  if (__atomic_sub_fetch(&cache->refcount, 1, __ATOMIC_ACQ_REL))
+  {
+    return;
+  }
+
+  for (uint32_t x= 0; x < NEAR_CACHE_SHARDS; ++x)
+  {
+    near_cache_shard_st& shard= cache->shards[x];
+    if (shard.buckets)
+    {
+      while (shard.hand)
+      {
+        shard_remove(shard, shard.hand);
+      }
+      pthread_mutex_destroy(&shard.mutex);
+    }
+    free(shard.buckets);
+    free(shard.sketch);
+  }
+  free(cache);
+}
+
+memcached_return_t memcached_near_cache_create(Memcached *ptr, uint64_t budget)
+{
+  memcached_near_cache_free(ptr);
+
+  memcached_near_cache_st *cache= (memcached_near_cache_st *)calloc(1, sizeof(memcached_near_cache_st));
+  if (cache == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+  cache->refcount= 1;
+
+  size_t shard_budget= size_t(budget / NEAR_CACHE_SHARDS);
+  for (uint32_t x= 0; x < NEAR_CACHE_SHARDS; ++x)
+  {
+    near_cache_shard_st& shard= cache->shards[x];
+    shard.budget= shard_budget;
+
+    /* Sized for entries of about 256 bytes, the sketch counts twice as many keys */
+    uint32_t buckets= power_of_two(shard_budget / 256, 16, NEAR_CACHE_MAX_BUCKETS);
+    uint32_t width= buckets * 2;
+    shard.bucket_mask= buckets -1;
+    shard.sketch_mask= width -1;
+    shard.sketch_period= width * 10;
+
+    shard.buckets= (memcached_near_cache_entry_st **)calloc(buckets, sizeof(memcached_near_cache_entry_st *));
+    shard.sketch= (uint8_t *)calloc(NEAR_CACHE_SKETCH_DEPTH, width);
+    if (shard.buckets == NULL or shard.sketch == NULL or pthread_mutex_init(&shard.mutex, NULL))
+    {
+      free(shard.buckets);
+      shard.buckets= NULL;
+      cache_release(cache);
+
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  }
+
+  ptr->near_cache.cache= cache;
+  ptr->near_cache.budget= budget;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_near_cache_clone(Memcached *clone, const Memcached *source)
+{
+  memcached_near_cache_st *cache= source->near_cache.cache;
+  if (cache)
+  {
+    __atomic_add_fetch(&cache->refcount, 1, __ATOMIC_RELAXED);
+  }
+
+  clone->near_cache.cache= cache;
+  clone->near_cache.budget= source->near_cache.budget;
+}
+
+void memcached_near_cache_reset(Memcached *ptr)
+{
+  for (uint32_t x= ptr->near_cache.hits_fetched; x < ptr->near_cache.hits_count; ++x)
+  {
+    entry_release(ptr->near_cache.hits[x]);
+  }
+  ptr->near_cache.hits_count= 0;
+  ptr->near_cache.hits_fetched= 0;
+}
+
+void memcached_near_cache_free(Memcached *ptr)
+{
+  memcached_near_cache_reset(ptr);
+
+  libmemcached_free(ptr, ptr->near_cache.hits);
+  libmemcached_free(ptr, ptr->near_cache.miss_keys);
+  libmemcached_free(ptr, ptr->near_cache.miss_key_length);
+  ptr->near_cache.hits= NULL;
+  ptr->near_cache.miss_keys= NULL;
+  ptr->near_cache.miss_key_length= NULL;
+  ptr->near_cache.size= 0;
+
+  if (ptr->near_cache.cache)
+  {
+    cache_release(ptr->near_cache.cache);
+    ptr->near_cache.cache= NULL;
+  }
+  ptr->near_cache.budget= 0;
+}
+
+static memcached_near_cache_entry_st *near_cache_lookup(memcached_near_cache_st *cache,
+                                                        const char *prefix, size_t prefix_length,
+                                                        const char *key, size_t key_length,
+                                                        time_t now)
+{
+  uint32_t hash= near_cache_hash(prefix, prefix_length, key, key_length);
+  near_cache_shard_st& shard= near_cache_shard(cache, hash);
+
+  pthread_mutex_lock(&shard.mutex);
+  sketch_increment(shard, hash);
+
+  memcached_near_cache_entry_st *entry= shard_find(shard, hash, prefix, prefix_length, key, key_length);
+  if (entry and entry->expires <= now)
+  {
+    shard_remove(shard, entry);
+    entry= NULL;
+  }
+
+  if (entry)
+  {
+    entry->referenced= true;
+    __atomic_add_fetch(&entry->refcount, 1, __ATOMIC_RELAXED);
+    shard.stat.hits++;
+  }
+  else
+  {
+    shard.stat.misses++;
+  }
+  pthread_mutex_unlock(&shard.mutex);
+
+  return entry;
+}
+
+memcached_return_t memcached_near_cache_mget(Memcached *ptr,
+                                             const char * const *keys,
+                                             const size_t *key_length,
+                                             size_t number_of_keys,
+                                             const char * const **miss_keys,
+                                             const size_t **miss_key_length,
+                                             size_t *number_of_misses)
+{
+  memcached_near_cache_reset(ptr);
+
+  if (number_of_keys > ptr->near_cache.size)
+  {
+    memcached_near_cache_entry_st **hits= libmemcached_xrealloc(ptr, ptr->near_cache.hits, number_of_keys, memcached_near_cache_entry_st *);
+    if (hits)
+    {
+      ptr->near_cache.hits= hits;
+    }
+
+    const char **keys_missed= libmemcached_xrealloc(ptr, ptr->near_cache.miss_keys, number_of_keys, const char *);
+    if (keys_missed)
+    {
+      ptr->near_cache.miss_keys= keys_missed;
+    }
+
+    size_t *lengths_missed= libmemcached_xrealloc(ptr, ptr->near_cache.miss_key_length, number_of_keys, size_t);
+    if (lengths_missed)
+    {
+      ptr->near_cache.miss_key_length= lengths_missed;
+    }
+
+    if (hits == NULL or keys_missed == NULL or lengths_missed == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+    ptr->near_cache.size= uint32_t(number_of_keys);
+  }
+
+  /* Values for keys invalidated after this point may be older than the change */
+  ptr->near_cache.sent= __atomic_load_n(&ptr->near_cache.cache->invalidations, __ATOMIC_ACQUIRE);
+
+  const char *prefix= memcached_array_string(ptr->_namespace);
+  size_t prefix_length= memcached_array_size(ptr->_namespace);
+  time_t now= time(NULL);
+
+  size_t misses= 0;
+  for (size_t x= 0; x < number_of_keys; ++x)
+  {
+    memcached_near_cache_entry_st *entry= near_cache_lookup(ptr->near_cache.cache, prefix, prefix_length,
+                                                            keys[x], key_length[x], now);
+    if (entry)
+    {
+      ptr->near_cache.hits[ptr->near_cache.hits_count++]= entry;
+    }
+    else
+    {
+      ptr->near_cache.miss_keys[misses]= keys[x];
+      ptr->near_cache.miss_key_length[misses]= key_length[x];
+      misses++;
+    }
+  }
+
+  *miss_keys= ptr->near_cache.miss_keys;
+  *miss_key_length= ptr->near_cache.miss_key_length;
+  *number_of_misses= misses;
+
+  return MEMCACHED_SUCCESS;
+}
+
+bool memcached_near_cache_fetch(Memcached *ptr, memcached_result_st *result)
+{
+  while (ptr->near_cache.hits_fetched < ptr->near_cache.hits_count)
+  {
+    memcached_near_cache_entry_st *entry= ptr->near_cache.hits[ptr->near_cache.hits_fetched++];
+
+    size_t prefix_length= memcached_array_size(ptr->_namespace);
+    bool copied= memcached_string_set(result->value, entry->value(), entry->value_length);
+    if (copied)
+    {
+      result->key_length= entry->key_length -prefix_length;
+      memcpy(result->item_key, entry->key() +prefix_length, result->key_length);
+      result->item_key[result->key_length]= 0;
+      result->item_flags= entry->flags;
+      result->item_cas= entry->cas;
+      result->item_expiration= 0;
+    }
+    entry_release(entry);
+
+    if (copied)
+    {
+      return true;
+    }
+  }
+
+  ptr->near_cache.hits_count= 0;
+  ptr->near_cache.hits_fetched= 0;
+
+  return false;
+}
+
+void memcached_near_cache_store(Memcached *ptr, const memcached_result_st *result)
+{
+  memcached_near_cache_st *cache= ptr->near_cache.cache;
+  if (cache == NULL or result->key_length == 0)
+  {
+    return;
+  }
+
+  const char *prefix= memcached_array_string(ptr->_namespace);
+  size_t prefix_length= memcached_array_size(ptr->_namespace);
+  size_t value_length= memcached_string_length(&result->value);
+
+  uint32_t hash= near_cache_hash(prefix, prefix_length, result->item_key, result->key_length);
+  near_cache_shard_st& shard= near_cache_shard(cache, hash);
+
+  /* A single value may not take more than an eighth of its shard */
+  if (sizeof(memcached_near_cache_entry_st) +prefix_length +result->key_length +value_length +1 > shard.budget / 8)
+  {
+    return;
+  }
+
+  memcached_near_cache_entry_st *entry= (memcached_near_cache_entry_st *)malloc(sizeof(memcached_near_cache_entry_st) +prefix_length +result->key_length +value_length +1);
+  if (entry == NULL)
+  {
+    return;
+  }
+
+  time_t now= time(NULL);
+  entry->refcount= 1;
+  entry->hash= hash;
+  entry->referenced= false;
+  entry->expires= now +ptr->near_cache.ttl;
+  entry->flags= result->item_flags;
+  entry->cas= result->item_cas;
+  entry->key_length= prefix_length +result->key_length;
+  entry->value_length= value_length;
+  memcpy(entry->key(), prefix, prefix_length);
+  memcpy(entry->key() +prefix_length, result->item_key, result->key_length);
+  memcpy(entry->value(), memcached_string_value(&result->value), value_length);
+  entry->value()[value_length]= 0;
+
+  pthread_mutex_lock(&shard.mutex);
+  /* The key was changed while the request was on its way, the value may predate it */
+  if (near_cache_stamp(shard, hash) > ptr->near_cache.sent)
+  {
+    shard.stat.rejections++;
+    pthread_mutex_unlock(&shard.mutex);
+    free(entry);
+
+    return;
+  }
+
+  memcached_near_cache_entry_st *existing= shard_find(shard, hash, prefix, prefix_length, result->item_key, result->key_length);
+  if (existing)
+  {
+    shard_remove(shard, existing);
+  }
+
+  while (shard.stat.bytes +entry->size() > shard.budget)
+  {
+    memcached_near_cache_entry_st *victim= shard_victim(shard, now);
+    if (victim == NULL)
+    {
+      break;
+    }
+
+    /* TinyLFU admission, a key seen less often than the victim stays out */
+    if (victim->expires > now and sketch_estimate(shard, hash) <= sketch_estimate(shard, victim->hash))
+    {
+      shard.stat.rejections++;
+      pthread_mutex_unlock(&shard.mutex);
+      free(entry);
+
+      return;
+    }
+
+    shard_remove(shard, victim);
+    shard.stat.evictions++;
+  }
+
+  shard_insert(shard, entry);
+  pthread_mutex_unlock(&shard.mutex);
+}
+
+void memcached_near_cache_invalidate(Memcached *ptr, const char *key, size_t key_length)
+{
+  memcached_near_cache_st *cache= ptr->near_cache.cache;
+  if (cache == NULL)
+  {
+    return;
+  }
+
+  const char *prefix= memcached_array_string(ptr->_namespace);
+  size_t prefix_length= memcached_array_size(ptr->_namespace);
+  uint32_t hash= near_cache_hash(prefix, prefix_length, key, key_length);
+  near_cache_shard_st& shard= near_cache_shard(cache, hash);
+
+  pthread_mutex_lock(&shard.mutex);
+  near_cache_stamp(shard, hash)= __atomic_add_fetch(&cache->invalidations, 1, __ATOMIC_ACQ_REL);
+  memcached_near_cache_entry_st *entry= shard_find(shard, hash, prefix, prefix_length, key, key_length);
+  if (entry)
+  {
+    shard_remove(shard, entry);
+    shard.stat.invalidations++;
+  }
+  pthread_mutex_unlock(&shard.mutex);
+}
+
+void memcached_near_cache_invalidate_all(Memcached *ptr)
+{
+  memcached_near_cache_st *cache= ptr->near_cache.cache;
+  if (cache == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t x= 0; x < NEAR_CACHE_SHARDS; ++x)
+  {
+    near_cache_shard_st& shard= cache->shards[x];
+    pthread_mutex_lock(&shard.mutex);
+    uint64_t stamp= __atomic_add_fetch(&cache->invalidations, 1, __ATOMIC_ACQ_REL);
+    for (uint32_t y= 0; y < NEAR_CACHE_STAMPS; ++y)
+    {
+      shard.invalidated[y]= stamp;
+    }
+
+    while (shard.hand)
+    {
+      shard_remove(shard, shard.hand);
+      shard.stat.invalidations++;
+    }
+    pthread_mutex_unlock(&shard.mutex);
+  }
+}
+
+memcached_return_t memcached_near_cache_stats(const memcached_st *shell,
+                                              memcached_near_cache_stat_st *stat)
+{
+  const Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL or stat == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  memset(stat, 0, sizeof(memcached_near_cache_stat_st));
+
+  memcached_near_cache_st *cache= ptr->near_cache.cache;
+  if (cache == NULL)
+  {
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  for (uint32_t x= 0; x < NEAR_CACHE_SHARDS; ++x)
+  {
+    near_cache_shard_st& shard= cache->shards[x];
+    pthread_mutex_lock(&shard.mutex);
+    stat->hits+= shard.stat.hits;
+    stat->misses+= shard.stat.misses;
+    stat->evictions+= shard.stat.evictions;
+    stat->rejections+= shard.stat.rejections;
+    stat->invalidations+= shard.stat.invalidations;
+    stat->items+= shard.stat.items;
+    stat->bytes+= shard.stat.bytes;
+    pthread_mutex_unlock(&shard.mutex);
+  }
+
+  return MEMCACHED_SUCCESS;
+}
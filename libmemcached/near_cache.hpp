@@ -0,0 +1,84 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Bounded in-process cache of values read from the servers, shared by
+  reference count between a handle and every handle cloned from it. It is
+  split in shards, each with its own lock, CLOCK eviction and a small
+  count-min sketch deciding, TinyLFU style, whether a new entry is worth
+  its victim.
+*/
+struct memcached_near_cache_st;
+struct memcached_near_cache_entry_st;
+
+memcached_return_t memcached_near_cache_create(Memcached *ptr, uint64_t budget);
+
+void memcached_near_cache_clone(Memcached *clone, const Memcached *source);
+
+void memcached_near_cache_free(Memcached *ptr);
+
+/*
+  Look all keys up. Hits are queued on the handle for
+  memcached_near_cache_fetch(), the keys left to ask the servers for are
+  returned in miss_keys, which belong to the handle.
+*/
+memcached_return_t memcached_near_cache_mget(Memcached *ptr,
+                                             const char * const *keys,
+                                             const size_t *key_length,
+                                             size_t number_of_keys,
+                                             const char * const **miss_keys,
+                                             const size_t **miss_key_length,
+                                             size_t *number_of_misses);
+
+/* Move the next queued hit into result, false when there are none left. */
+bool memcached_near_cache_fetch(Memcached *ptr, memcached_result_st *result);
+
+/* Drop the queued hits of a previous memcached_mget() */
+void memcached_near_cache_reset(Memcached *ptr);
+
+/* Remember a value that was just read from a server */
+void memcached_near_cache_store(Memcached *ptr, const memcached_result_st *result);
+
+/*
+  Drop a key about to be written, and again once the server has answered,
+  as a read answered in between may still have cached the old value.
+*/
+void memcached_near_cache_invalidate(Memcached *ptr, const char *key, size_t key_length);
+
+void memcached_near_cache_invalidate_all(Memcached *ptr);
@@ -39,8 +39,6 @@
 
 #include <libmemcached/common.h>
 
-#define memcached_set_purging(__object, __value) ((__object)->state.is_purging= (__value))
-
 class Purge
 {
 public:
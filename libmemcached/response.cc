@@ -149,7 +149,7 @@ static memcached_return_t textual_value_fetch(memcached_instance_st* instance,
       some people lazy about using the return length.
     */
     size_t to_read= (value_length) + 2;
-    memcached_return_t rrc= memcached_io_read(instance, value_ptr, to_read, read_length);
+    memcached_return_t rrc= memcached_io_read_value(instance, value_ptr, to_read);
     if (memcached_failed(rrc) and rrc == MEMCACHED_IN_PROGRESS)
     {
       memcached_quit_server(instance, true);
@@ -159,6 +159,7 @@ static memcached_return_t textual_value_fetch(memcached_instance_st* instance,
     {
       return rrc;
     }
+    read_length= ssize_t(to_read);
   }
 
   if (read_length != (ssize_t)(value_length + 2))
@@ -495,7 +496,8 @@ static memcached_return_t textual_read_one_response(memcached_instance_st* insta
 
 static memcached_return_t binary_read_one_response(memcached_instance_st* instance,
                                                    char *buffer, const size_t buffer_length,
-                                                   memcached_result_st *result)
+                                                   memcached_result_st *result,
+                                                   uint32_t *opaque)
 {
   memcached_return_t rc;
   protocol_binary_response_header header;
@@ -522,6 +524,11 @@ static memcached_return_t binary_read_one_response(memcached_instance_st* instan
   header.response.cas= memcached_ntohll(header.response.cas);
   uint32_t bodylen= header.response.bodylen;
 
+  if (opaque)
+  {
+    *opaque= ntohl(header.response.opaque);
+  }
+
   if (header.response.status == PROTOCOL_BINARY_RESPONSE_SUCCESS or
       header.response.status == PROTOCOL_BINARY_RESPONSE_AUTH_CONTINUE)
   {
@@ -578,7 +585,7 @@ static memcached_return_t binary_read_one_response(memcached_instance_st* instan
         }
 
         char *vptr= memcached_string_value_mutable(&result->value);
-        if (memcached_failed(rc= memcached_safe_read(instance, vptr, bodylen)))
+        if (memcached_failed(rc= memcached_io_read_value(instance, vptr, bodylen)))
         {
           WATCHPOINT_ERROR(rc);
           return MEMCACHED_UNKNOWN_READ_FAILURE;
@@ -782,7 +789,13 @@ static memcached_return_t binary_read_one_response(memcached_instance_st* instan
     case PROTOCOL_BINARY_CMD_REPLACEQ:
     case PROTOCOL_BINARY_CMD_APPENDQ:
     case PROTOCOL_BINARY_CMD_PREPENDQ:
-      return binary_read_one_response(instance, buffer, buffer_length, result);
+    case PROTOCOL_BINARY_CMD_DELETEQ:
+      // Callers matching on opaque want to know which quiet command failed
+      if (opaque)
+      {
+        break;
+      }
+      return binary_read_one_response(instance, buffer, buffer_length, result, opaque);
 
     default:
       break;
@@ -835,8 +848,11 @@ static memcached_return_t binary_read_one_response(memcached_instance_st* instan
 
 static memcached_return_t _read_one_response(memcached_instance_st* instance,
                                              char *buffer, const size_t buffer_length,
-                                             memcached_result_st *result)
+                                             memcached_result_st *result,
+                                             uint32_t *opaque= NULL)
 {
+  // Replies to older requests are read first, only the last one is timed
+  const bool is_last_response= instance->response_count() <= 1;
   memcached_server_response_decrement(instance);
 
   if (result == NULL)
@@ -848,13 +864,18 @@ static memcached_return_t _read_one_response(memcached_instance_st* instance,
   memcached_return_t rc;
   if (memcached_is_binary(instance->root))
   {
-    rc= binary_read_one_response(instance, buffer, buffer_length, result);
+    rc= binary_read_one_response(instance, buffer, buffer_length, result, opaque);
   }
   else
   {
     rc= textual_read_one_response(instance, buffer, buffer_length, result);
   }
 
+  if (is_last_response)
+  {
+    memcached_server_stats_end(instance, rc);
+  }
+
   if (memcached_fatal(rc))
   {
     memcached_io_reset(instance);
@@ -877,6 +898,21 @@ memcached_return_t memcached_read_one_response(memcached_instance_st* instance,
   return _read_one_response(instance, buffer, sizeof(buffer), result);
 }
 
+memcached_return_t memcached_read_one_response(memcached_instance_st* instance,
+                                               memcached_result_st *result,
+                                               uint32_t& opaque)
+{
+  char buffer[SMALL_STRING_LEN];
+
+  if (memcached_is_binary(instance->root) == false)
+  {
+    return memcached_set_error(*instance, MEMCACHED_NOT_SUPPORTED, MEMCACHED_AT);
+  }
+
+  opaque= UINT32_MAX;
+  return _read_one_response(instance, buffer, sizeof(buffer), result, &opaque);
+}
+
 memcached_return_t memcached_response(memcached_instance_st* instance,
                                       memcached_result_st *result)
 {
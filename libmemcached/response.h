@@ -41,6 +41,14 @@
 memcached_return_t memcached_read_one_response(memcached_instance_st* ptr,
                                                memcached_result_st *result);
 
+/*
+  Read a single binary response and hand back its opaque. Failures of quiet
+  commands are returned instead of being skipped.
+*/
+memcached_return_t memcached_read_one_response(memcached_instance_st* ptr,
+                                               memcached_result_st *result,
+                                               uint32_t& opaque);
+
 memcached_return_t memcached_response(memcached_instance_st* ptr,
                                       memcached_result_st *result);
 
@@ -0,0 +1,357 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <libmemcached/common.h>
+
+#include <cmath>
+
+#define SERVER_STATS_SUB_BUCKETS 4 // Buckets for each power of two
+#define SERVER_STATS_READ_SAMPLES 20 // Reads timed before their percentiles are trusted
+#define LATENCY_EJECT_SAMPLES 16 // Replies between two looks at the average of a server
+#define LATENCY_EJECT_MINIMUM 1000 // Microseconds, a server answering faster is never ejected
+#define LATENCY_EJECT_MAX_BACKOFF 5 // The ejection doubles up to retry_timeout << 5
+
+uint64_t memcached_server_stats_clock()
+{
+#if defined(HAVE_CLOCK_GETTIME) && HAVE_CLOCK_GETTIME
+  struct timespec monotonic;
+  if (clock_gettime(CLOCK_MONOTONIC, &monotonic) == 0)
+  {
+    return uint64_t(monotonic.tv_sec) * 1000000 + uint64_t(monotonic.tv_nsec) / 1000;
+  }
+#endif
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return uint64_t(now.tv_sec) * 1000000 + uint64_t(now.tv_usec);
+}
+
+static uint32_t server_stats_bucket(uint64_t latency)
+{
+  if (latency > UINT32_MAX)
+  {
+    latency= UINT32_MAX;
+  }
+
+  if (latency < SERVER_STATS_SUB_BUCKETS)
+  {
+    return uint32_t(latency);
+  }
+
+  uint32_t power= 31 - __builtin_clz(uint32_t(latency));
+  uint32_t sub_bucket= uint32_t(latency >> (power -2)) & (SERVER_STATS_SUB_BUCKETS -1);
+
+  return (power -1) * SERVER_STATS_SUB_BUCKETS + sub_bucket;
+}
+
+/* Largest latency which falls in a bucket */
+static uint64_t server_stats_bucket_max(uint32_t bucket)
+{
+  if (bucket < SERVER_STATS_SUB_BUCKETS)
+  {
+    return bucket;
+  }
+
+  uint32_t power= bucket / SERVER_STATS_SUB_BUCKETS +1;
+  uint64_t lowest= uint64_t(SERVER_STATS_SUB_BUCKETS + bucket % SERVER_STATS_SUB_BUCKETS) << (power -2);
+
+  return lowest + (uint64_t(1) << (power -2)) -1;
+}
+
+/*
+  Take the server out of the consistent hashing ring when its average
+  latency is latency_eject_factor times the mean average of the servers
+  still in it. It comes back after retry_timeout, doubled each time it is
+  found slow again as soon as it has answered LATENCY_EJECT_SAMPLES
+  requests, and reset once it keeps up.
+*/
+static void server_latency_check(memcached_instance_st* instance)
+{
+  Memcached *root= instance->root;
+  uint64_t average= instance->latency.average / 8;
+
+  if (average < LATENCY_EJECT_MINIMUM)
+  {
+    instance->latency.strikes= 0;
+    return;
+  }
+
+  if (_is_auto_eject_host(root) == false or memcached_is_consistent_distribution(root) == false)
+  {
+    return;
+  }
+
+  struct timeval now;
+  if (gettimeofday(&now, NULL))
+  {
+    return;
+  }
+
+  uint64_t others_total= 0;
+  uint32_t others= 0;
+  uint32_t ejected= 0;
+  for (uint32_t x= 0; x < memcached_server_count(root); x++)
+  {
+    memcached_instance_st* other= memcached_instance_fetch(root, x);
+    if (other == instance)
+    {
+      continue;
+    }
+
+    if (other->next_retry > now.tv_sec)
+    {
+      ejected++;
+    }
+    else if (other->latency.samples >= LATENCY_EJECT_SAMPLES)
+    {
+      others_total+= other->latency.average / 8;
+      others++;
+    }
+  }
+
+  if (others == 0)
+  {
+    return;
+  }
+
+  if (average <= uint64_t(root->latency_eject_factor) * (others_total / others))
+  {
+    instance->latency.strikes= 0;
+    return;
+  }
+
+  // Never leave less than half of the servers in the ring
+  if ((ejected +1) * 2 > memcached_server_count(root))
+  {
+    return;
+  }
+
+  uint32_t backoff= instance->latency.strikes < LATENCY_EJECT_MAX_BACKOFF ? instance->latency.strikes : LATENCY_EJECT_MAX_BACKOFF;
+  time_t retry_timeout= root->retry_timeout > 0 ? root->retry_timeout : 1;
+
+  instance->latency.strikes++;
+  instance->latency.samples= 0;
+  instance->latency.average= 0;
+  instance->next_retry= now.tv_sec + (retry_timeout << backoff);
+
+  (void)run_distribution_for_auto_eject(root);
+}
+
+static void server_latency_update(memcached_instance_st* instance, uint64_t latency)
+{
+  if (latency > UINT32_MAX)
+  {
+    latency= UINT32_MAX;
+  }
+
+  // Each reply weighs 1/8 of the average
+  if (instance->latency.samples == 0)
+  {
+    instance->latency.average= latency * 8;
+  }
+  else
+  {
+    instance->latency.average= instance->latency.average - instance->latency.average / 8 + latency;
+  }
+  instance->latency.samples++;
+
+  if (instance->latency.samples % LATENCY_EJECT_SAMPLES == 0)
+  {
+    server_latency_check(instance);
+  }
+}
+
+void memcached_server_stats_arm(memcached_instance_st* instance, memcached_operation_t operation)
+{
+  if ((instance->root->flags.server_stats or instance->root->hedge.percentile) and instance->stats.counters == NULL)
+  {
+    // The latency is still used for ejection when this fails
+    instance->stats.counters= libmemcached_xcalloc(instance->root, 1, memcached_server_stats_st);
+  }
+
+  instance->stats.operation= operation;
+  instance->stats.started= memcached_server_stats_clock() | 1; // Never 0, which means not armed
+}
+
+void memcached_server_stats_record(memcached_instance_st* instance, memcached_return_t rc)
+{
+  uint64_t latency= memcached_server_stats_clock() - instance->stats.started;
+  instance->stats.started= 0;
+
+  if (latency > UINT64_MAX / 2) // The clock went back
+  {
+    latency= 0;
+  }
+
+  if (instance->root->latency_eject_factor)
+  {
+    server_latency_update(instance, latency);
+  }
+
+  if (instance->stats.counters == NULL)
+  {
+    return;
+  }
+
+  memcached_server_stats_st *counters= instance->stats.counters;
+  counters->operation[instance->stats.operation].count++;
+  if (memcached_fatal(rc))
+  {
+    counters->operation[instance->stats.operation].errors++;
+  }
+  counters->operation[instance->stats.operation].latency_total+= latency;
+  if (latency > counters->operation[instance->stats.operation].latency_max)
+  {
+    counters->operation[instance->stats.operation].latency_max= latency;
+  }
+  counters->operation[instance->stats.operation].histogram[server_stats_bucket(latency)]++;
+}
+
+void memcached_server_stats_free(memcached_instance_st* instance)
+{
+  libmemcached_free(instance->root, instance->stats.counters);
+  instance->stats.counters= NULL;
+  instance->stats.started= 0;
+}
+
+memcached_return_t memcached_server_stats(const memcached_instance_st *instance,
+                                          memcached_server_stats_st *stats)
+{
+  if (instance == NULL or stats == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (instance->root->flags.server_stats == false)
+  {
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  if (instance->stats.counters)
+  {
+    *stats= *instance->stats.counters;
+  }
+  else
+  {
+    memset(stats, 0, sizeof(memcached_server_stats_st));
+  }
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_server_stats_reset(memcached_st *shell)
+{
+  Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL)
+  {
+    return;
+  }
+
+  for (uint32_t x= 0; x < memcached_server_count(ptr); x++)
+  {
+    memcached_instance_st* instance= memcached_instance_fetch(ptr, x);
+    if (instance->stats.counters)
+    {
+      memset(instance->stats.counters, 0, sizeof(memcached_server_stats_st));
+    }
+  }
+}
+
+/* Percentile of the requests counted in histogram, and in other unless it is NULL */
+static uint64_t server_stats_histogram_percentile(const uint64_t *histogram, const uint64_t *other,
+                                                  uint64_t count, uint64_t latency_max,
+                                                  double percentile)
+{
+  if (percentile > 100)
+  {
+    percentile= 100;
+  }
+
+  uint64_t wanted= uint64_t(ceil(double(count) * percentile / 100));
+  uint64_t seen= 0;
+  for (uint32_t x= 0; x < MEMCACHED_LATENCY_BUCKETS; x++)
+  {
+    seen+= histogram[x] + (other ? other[x] : 0);
+    if (seen and seen >= wanted)
+    {
+      uint64_t latency= server_stats_bucket_max(x);
+      return latency < latency_max ? latency : latency_max;
+    }
+  }
+
+  return latency_max;
+}
+
+uint64_t memcached_server_stats_read_latency(const memcached_instance_st* instance, uint32_t percentile)
+{
+  const memcached_server_stats_st *counters= instance->stats.counters;
+  if (counters == NULL)
+  {
+    return 0;
+  }
+
+  uint64_t count= counters->operation[MEMCACHED_OPERATION_GET].count + counters->operation[MEMCACHED_OPERATION_MGET].count;
+  if (count < SERVER_STATS_READ_SAMPLES)
+  {
+    return 0;
+  }
+
+  uint64_t latency_max= counters->operation[MEMCACHED_OPERATION_GET].latency_max;
+  if (counters->operation[MEMCACHED_OPERATION_MGET].latency_max > latency_max)
+  {
+    latency_max= counters->operation[MEMCACHED_OPERATION_MGET].latency_max;
+  }
+
+  return server_stats_histogram_percentile(counters->operation[MEMCACHED_OPERATION_GET].histogram,
+                                           counters->operation[MEMCACHED_OPERATION_MGET].histogram,
+                                           count, latency_max, percentile);
+}
+
+uint64_t memcached_server_stats_percentile(const memcached_server_stats_st *stats,
+                                           memcached_operation_t operation,
+                                           double percentile)
+{
+  if (stats == NULL or operation >= MEMCACHED_OPERATION_MAX or stats->operation[operation].count == 0)
+  {
+    return 0;
+  }
+
+  return server_stats_histogram_percentile(stats->operation[operation].histogram, NULL,
+                                           stats->operation[operation].count,
+                                           stats->operation[operation].latency_max,
+                                           percentile);
+}
@@ -0,0 +1,74 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Client side latency of every server, per handle, while
+  MEMCACHED_BEHAVIOR_SERVER_STATS or MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR
+  is set. A request which expects a reply arms its instance right before it
+  is sent, and its first reply, read once the replies to older requests are
+  out of the way, records the time elapsed. Pipelined requests therefore
+  only count the time to their first reply.
+*/
+void memcached_server_stats_arm(memcached_instance_st* instance, memcached_operation_t operation);
+
+void memcached_server_stats_record(memcached_instance_st* instance, memcached_return_t rc);
+
+void memcached_server_stats_free(memcached_instance_st* instance);
+
+/* Microseconds of a monotonic clock when there is one */
+uint64_t memcached_server_stats_clock();
+
+/* Latency of the given percentile of the gets of a server, 0 until enough of them were timed */
+uint64_t memcached_server_stats_read_latency(const memcached_instance_st* instance, uint32_t percentile);
+
+static inline void memcached_server_stats_start(memcached_instance_st* instance, memcached_operation_t operation)
+{
+  if (instance->root->flags.server_stats or instance->root->latency_eject_factor or instance->root->hedge.percentile)
+  {
+    memcached_server_stats_arm(instance, operation);
+  }
+}
+
+static inline void memcached_server_stats_end(memcached_instance_st* instance, memcached_return_t rc)
+{
+  if (instance->stats.started)
+  {
+    memcached_server_stats_record(instance, rc);
+  }
+}
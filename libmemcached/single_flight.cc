@@ -0,0 +1,324 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include <libmemcached/common.h>
+
+#include <pthread.h>
+
+#define MEMCACHED_SINGLE_FLIGHT_BUCKETS 64
+
+/* One load in progress, the waiters free it once the loader has finished. */
+struct memcached_single_flight_call_st
+{
+  memcached_single_flight_call_st *next;
+  pthread_cond_t cond;
+  char *key; // namespace followed by the key
+  size_t key_length;
+  bool done;
+  uint32_t waiters;
+  memcached_return_t rc;
+  char *value;
+  size_t value_length;
+  uint32_t flags;
+};
+
+struct memcached_single_flight_st
+{
+  pthread_mutex_t mutex;
+  uint32_t refcount;
+  uint64_t loads;
+  uint64_t coalesced;
+  memcached_single_flight_call_st *calls[MEMCACHED_SINGLE_FLIGHT_BUCKETS];
+};
+
+memcached_return_t memcached_single_flight_create(Memcached *ptr)
+{
+  if (ptr->single_flight)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  memcached_single_flight_st *flight= (memcached_single_flight_st *)calloc(1, sizeof(memcached_single_flight_st));
+  if (flight == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+  }
+
+  int error;
+  if ((error= pthread_mutex_init(&flight->mutex, NULL)))
+  {
+    free(flight);
+    return memcached_set_errno(*ptr, error, MEMCACHED_AT);
+  }
+  flight->refcount= 1;
+
+  ptr->single_flight= flight;
+
+  return MEMCACHED_SUCCESS;
+}
+
+void memcached_single_flight_clone(Memcached *clone, const Memcached *source)
+{
+  memcached_single_flight_st *flight= source->single_flight;
+  if (flight)
+  {
+    pthread_mutex_lock(&flight->mutex);
+    flight->refcount++;
+    pthread_mutex_unlock(&flight->mutex);
+  }
+
+  clone->single_flight= flight;
+}
+
+void memcached_single_flight_release(Memcached *ptr)
+{
+  memcached_single_flight_st *flight= ptr->single_flight;
+  if (flight == NULL)
+  {
+    return;
+  }
+  ptr->single_flight= NULL;
+
+  pthread_mutex_lock(&flight->mutex);
+  bool last= --flight->refcount == 0;
+  pthread_mutex_unlock(&flight->mutex);
+
+  /* A loader or a waiter holds a handle, so nothing can be in flight here. */
+  if (last)
+  {
+    pthread_mutex_destroy(&flight->mutex);
+    free(flight);
+  }
+}
+
+static void call_free(memcached_single_flight_call_st *call)
+{
+  pthread_cond_destroy(&call->cond);
+  free(call->value);
+  free(call->key);
+  free(call);
+}
+
+static memcached_single_flight_call_st *call_find(memcached_single_flight_call_st *call,
+                                                 const char *prefix, size_t prefix_length,
+                                                 const char *key, size_t key_length)
+{
+  for (; call; call= call->next)
+  {
+    if (call->key_length == prefix_length +key_length and
+        memcmp(call->key, prefix, prefix_length) == 0 and
+        memcmp(call->key +prefix_length, key, key_length) == 0)
+    {
+      return call;
+    }
+  }
+
+  return NULL;
+}
+
+static char *call_wait(Memcached *ptr, memcached_single_flight_st *flight,
+                       memcached_single_flight_call_st *call,
+                       size_t *value_length,
+                       uint32_t *flags,
+                       memcached_return_t *error)
+{
+  call->waiters++;
+  flight->coalesced++;
+  while (call->done == false)
+  {
+    pthread_cond_wait(&call->cond, &flight->mutex);
+  }
+  pthread_mutex_unlock(&flight->mutex);
+
+  /* The call no longer changes, copy it without holding the lock. */
+  char *value= NULL;
+  *error= call->rc;
+  if (call->value)
+  {
+    value= static_cast<char *>(libmemcached_malloc(ptr, call->value_length +1));
+    if (value)
+    {
+      memcpy(value, call->value, call->value_length +1);
+      *value_length= call->value_length;
+      *flags= call->flags;
+    }
+    else
+    {
+      *error= memcached_set_error(*ptr, MEMCACHED_MEMORY_ALLOCATION_FAILURE, MEMCACHED_AT);
+    }
+  }
+
+  if (value == NULL and value_length)
+  {
+    *value_length= 0;
+  }
+
+  pthread_mutex_lock(&flight->mutex);
+  bool last= --call->waiters == 0;
+  pthread_mutex_unlock(&flight->mutex);
+
+  if (last)
+  {
+    call_free(call);
+  }
+
+  return value;
+}
+
+char *memcached_single_flight_load(Memcached *ptr,
+                                   const char *key, size_t key_length,
+                                   size_t *value_length,
+                                   uint32_t *flags,
+                                   memcached_return_t *error,
+                                   memcached_single_flight_load_fn load)
+{
+  memcached_single_flight_st *flight= ptr->single_flight;
+  const char *prefix= memcached_array_string(ptr->_namespace);
+  size_t prefix_length= memcached_array_size(ptr->_namespace);
+  memcached_single_flight_call_st **bucket= &flight->calls[libhashkit_fnv1a_32(key, key_length) % MEMCACHED_SINGLE_FLIGHT_BUCKETS];
+
+  pthread_mutex_lock(&flight->mutex);
+  memcached_single_flight_call_st *call= call_find(*bucket, prefix, prefix_length, key, key_length);
+  if (call)
+  {
+    return call_wait(ptr, flight, call, value_length, flags, error);
+  }
+
+  call= (memcached_single_flight_call_st *)calloc(1, sizeof(memcached_single_flight_call_st));
+  if (call)
+  {
+    call->key_length= prefix_length +key_length;
+    call->key= static_cast<char *>(malloc(call->key_length));
+    if (call->key == NULL or pthread_cond_init(&call->cond, NULL))
+    {
+      free(call->key);
+      free(call);
+      call= NULL;
+    }
+  }
+
+  if (call == NULL)
+  {
+    /* Without a call to publish the load simply goes uncoalesced. */
+    flight->loads++;
+    pthread_mutex_unlock(&flight->mutex);
+    return load(ptr, key, key_length, value_length, flags, error);
+  }
+
+  memcpy(call->key, prefix, prefix_length);
+  memcpy(call->key +prefix_length, key, key_length);
+  call->next= *bucket;
+  *bucket= call;
+  flight->loads++;
+  pthread_mutex_unlock(&flight->mutex);
+
+  char *value= load(ptr, key, key_length, value_length, flags, error);
+
+  call->rc= *error;
+  if (value)
+  {
+    call->value= static_cast<char *>(malloc(*value_length +1));
+    if (call->value)
+    {
+      memcpy(call->value, value, *value_length +1);
+      call->value_length= *value_length;
+      call->flags= *flags;
+    }
+    else
+    {
+      call->rc= MEMCACHED_MEMORY_ALLOCATION_FAILURE;
+    }
+  }
+
+  pthread_mutex_lock(&flight->mutex);
+  for (memcached_single_flight_call_st **next= bucket; *next; next= &(*next)->next)
+  {
+    if (*next == call)
+    {
+      *next= call->next;
+      break;
+    }
+  }
+  call->done= true;
+  bool unused= call->waiters == 0;
+  pthread_cond_broadcast(&call->cond);
+  pthread_mutex_unlock(&flight->mutex);
+
+  if (unused)
+  {
+    call_free(call);
+  }
+
+  return value;
+}
+
+memcached_return_t memcached_single_flight_stats(const memcached_st *shell,
+                                                 uint64_t *loads,
+                                                 uint64_t *coalesced)
+{
+  const Memcached* ptr= memcached2Memcached(shell);
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  uint64_t unused;
+  if (loads == NULL)
+  {
+    loads= &unused;
+  }
+  if (coalesced == NULL)
+  {
+    coalesced= &unused;
+  }
+
+  memcached_single_flight_st *flight= ptr->single_flight;
+  if (flight == NULL)
+  {
+    *loads= 0;
+    *coalesced= 0;
+    return MEMCACHED_NOT_SUPPORTED;
+  }
+
+  pthread_mutex_lock(&flight->mutex);
+  *loads= flight->loads;
+  *coalesced= flight->coalesced;
+  pthread_mutex_unlock(&flight->mutex);
+
+  return MEMCACHED_SUCCESS;
+}
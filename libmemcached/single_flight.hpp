@@ -0,0 +1,70 @@
+/*  vim:expandtab:shiftwidth=2:tabstop=2:smarttab:
+ * 
+ *  Libmemcached library
+ *
+ *  Copyright (C) 2011 Data Differential, http://datadifferential.com/
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *  notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above
+ *  copyright notice, this list of conditions and the following disclaimer
+ *  in the documentation and/or other materials provided with the
+ *  distribution.
+ *
+ *      * The names of its contributors may not be used to endorse or
+ *  promote products derived from this software without specific prior
+ *  written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+/*
+  Coalesces concurrent get_key_failure loads of the same key. A single
+  memcached_single_flight_st is shared, by reference count, between a handle
+  and every handle cloned from it, so a master and its pool run at most one
+  loader per key at any time.
+*/
+struct memcached_single_flight_st;
+
+typedef char *(*memcached_single_flight_load_fn)(Memcached *ptr,
+                                                 const char *key, size_t key_length,
+                                                 size_t *value_length,
+                                                 uint32_t *flags,
+                                                 memcached_return_t *error);
+
+memcached_return_t memcached_single_flight_create(Memcached *ptr);
+
+void memcached_single_flight_clone(Memcached *clone, const Memcached *source);
+
+void memcached_single_flight_release(Memcached *ptr);
+
+/*
+  Run load for key unless another handle sharing the state is already
+  loading it, in which case wait for that load and return a copy of its
+  value.
+*/
+char *memcached_single_flight_load(Memcached *ptr,
+                                   const char *key, size_t key_length,
+                                   size_t *value_length,
+                                   uint32_t *flags,
+                                   memcached_return_t *error,
+                                   memcached_single_flight_load_fn load);
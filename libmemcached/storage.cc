@@ -150,12 +150,17 @@ static memcached_return_t memcached_send_binary(Memcached *ptr,
                                                 const uint64_t cas,
                                                 const bool flush,
                                                 const bool reply,
-                                                memcached_storage_action_t verb)
+                                                memcached_storage_action_t verb,
+                                                const uint32_t *opaque)
 {
   protocol_binary_request_set request= {};
   size_t send_length= sizeof(request.bytes);
 
   initialize_binary_request(server, request.message.header);
+  if (opaque)
+  {
+    request.message.header.request.opaque= htonl(*opaque);
+  }
 
   request.message.header.request.opcode= get_com_code(verb, reply);
   request.message.header.request.keylen= htons((uint16_t)(key_length + memcached_array_size(ptr->_namespace)));
@@ -189,6 +194,11 @@ static memcached_return_t memcached_send_binary(Memcached *ptr,
   };
 
   /* write the header */
+  if (flush and reply)
+  {
+    memcached_server_stats_start(server, MEMCACHED_OPERATION_SET);
+  }
+
   memcached_return_t rc;
   if ((rc= memcached_vdo(server, vector, 5, flush)) != MEMCACHED_SUCCESS)
   {
@@ -205,12 +215,32 @@ static memcached_return_t memcached_send_binary(Memcached *ptr,
     return memcached_last_error(server->root);
   }
 
-  if (verb == SET_OP and ptr->number_of_replicas > 0)
+  uint32_t replicas= verb == SET_OP ? ptr->number_of_replicas : 0;
+  bool hot_copy= false;
+  if (ptr->number_of_replicas == 0 and ptr->hot_replicas.table)
+  {
+    switch (memcached_hot_replicas_write(ptr, key, key_length, verb == SET_OP))
+    {
+    case HOT_REPLICAS_COPY:
+      replicas= memcached_hot_replicas_count(ptr);
+      hot_copy= true;
+      break;
+
+    case HOT_REPLICAS_DROP:
+      memcached_hot_replicas_drop(ptr, server_key, key, key_length, flush);
+      break;
+
+    case HOT_REPLICAS_NONE:
+      break;
+    }
+  }
+
+  if (replicas > 0)
   {
     request.message.header.request.opcode= PROTOCOL_BINARY_CMD_SETQ;
     WATCHPOINT_STRING("replicating");
 
-    for (uint32_t x= 0; x < ptr->number_of_replicas; x++)
+    for (uint32_t x= 0; x < replicas; x++)
     {
       ++server_key;
       if (server_key == memcached_server_count(ptr))
@@ -220,15 +250,22 @@ static memcached_return_t memcached_send_binary(Memcached *ptr,
 
       memcached_instance_st* instance= memcached_instance_fetch(ptr, server_key);
 
-      if (memcached_vdo(instance, vector, 5, false) != MEMCACHED_SUCCESS)
+      /* Copies of hot keys are read by other handles straight away */
+      if (memcached_vdo(instance, vector, 5, flush and ptr->number_of_replicas == 0) != MEMCACHED_SUCCESS)
       {
         memcached_io_reset(instance);
+        hot_copy= false;
       }
       else
       {
         memcached_server_response_decrement(instance);
       }
     }
+
+    if (hot_copy)
+    {
+      memcached_hot_replicas_copied(ptr, key, key_length);
+    }
   }
 
   if (flush == false)
@@ -310,6 +347,11 @@ static memcached_return_t memcached_send_ascii(Memcached *ptr,
     { memcached_literal_param("\r\n") }
   };
 
+  if (flush and reply)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_SET);
+  }
+
   /* Send command header */
   memcached_return_t rc=  memcached_vdo(instance, vector, 12, flush);
 
@@ -371,6 +413,12 @@ static inline memcached_return_t memcached_send(memcached_st *shell,
   {
     return memcached_last_error(ptr);
   }
+  memcached_near_cache_invalidate(ptr, key, key_length);
+
+  if (ptr->hot_keys.tracker)
+  {
+    memcached_hot_keys_record(ptr, key, key_length);
+  }
 
   uint32_t server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
   memcached_instance_st* instance= memcached_instance_fetch(ptr, server_key);
@@ -409,7 +457,7 @@ static inline memcached_return_t memcached_send(memcached_st *shell,
     rc= memcached_send_binary(ptr, instance, server_key,
                               key, key_length,
                               value, value_length, expiration,
-                              flags, cas, flush, reply, verb);
+                              flags, cas, flush, reply, verb, NULL);
   }
   else
   {
@@ -419,6 +467,9 @@ static inline memcached_return_t memcached_send(memcached_st *shell,
                              flags, cas, flush, reply, verb);
   }
 
+  // A read answered before the server applied the write may have cached the old value
+  memcached_near_cache_invalidate(ptr, key, key_length);
+
   hashkit_string_free(destination);
 
   return rc;
@@ -596,3 +647,138 @@ memcached_return_t memcached_cas_by_key(memcached_st *ptr,
                          expiration, flags, cas, CAS_OP);
 }
 
+struct mset_context_st
+{
+  const char * const *keys;
+  const size_t *key_length;
+  const char * const *values;
+  const size_t *value_length;
+  time_t expiration;
+  uint32_t flags;
+};
+
+static memcached_return_t mset_send(Memcached *ptr,
+                                    memcached_instance_st* instance,
+                                    uint32_t server_key,
+                                    uint32_t position,
+                                    bool reply,
+                                    void *context)
+{
+  mset_context_st *mset= static_cast<mset_context_st *>(context);
+  const char *value= mset->values[position];
+  size_t value_length= mset->value_length[position];
+  hashkit_string_st* destination= NULL;
+
+  if (memcached_is_encrypted(ptr))
+  {
+    if ((destination= hashkit_encrypt(&ptr->hashkit, value, value_length)) == NULL)
+    {
+      return memcached_set_error(*ptr, MEMCACHED_FAILURE, MEMCACHED_AT,
+                                 memcached_literal_param("hashkit_encrypt() failed"));
+    }
+    value= hashkit_string_c_str(destination);
+    value_length= hashkit_string_length(destination);
+  }
+
+  memcached_return_t rc;
+  if (memcached_is_binary(ptr))
+  {
+    // Always quiet, only failures come back and they carry the opaque
+    rc= memcached_send_binary(ptr, instance, server_key,
+                              mset->keys[position], mset->key_length[position],
+                              value, value_length, mset->expiration,
+                              mset->flags, 0, false, false, SET_OP, &position);
+  }
+  else
+  {
+    rc= memcached_send_ascii(ptr, instance,
+                             mset->keys[position], mset->key_length[position],
+                             value, value_length, mset->expiration,
+                             mset->flags, 0, false, reply, SET_OP);
+  }
+
+  hashkit_string_free(destination);
+
+  return rc;
+}
+
+static memcached_return_t mset_response(Memcached *,
+                                        uint32_t,
+                                        memcached_return_t rc,
+                                        memcached_result_st *,
+                                        void *)
+{
+  if (rc == MEMCACHED_STORED or rc == MEMCACHED_SUCCESS)
+  {
+    return MEMCACHED_SUCCESS;
+  }
+
+  return rc;
+}
+
+static memcached_return_t mset_by_key(Memcached *ptr,
+                                      const char *group_key, size_t group_key_length,
+                                      const char * const *keys,
+                                      const size_t *key_length,
+                                      const char * const *values,
+                                      const size_t *value_length,
+                                      const size_t number_of_keys,
+                                      const time_t expiration,
+                                      const uint32_t flags,
+                                      memcached_return_t *results)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  if (values == NULL or value_length == NULL)
+  {
+    return memcached_set_error(*ptr, MEMCACHED_INVALID_ARGUMENTS, MEMCACHED_AT,
+                               memcached_literal_param("Values were NULL"));
+  }
+
+  mset_context_st context= { keys, key_length, values, value_length, expiration, flags };
+
+  memcached_batch_st batch;
+  batch.send= mset_send;
+  batch.response= mset_response;
+  batch.context= &context;
+  batch.reply= memcached_is_replying(ptr);
+
+  return memcached_batch(ptr, group_key, group_key_length,
+                         keys, key_length, number_of_keys,
+                         batch, results);
+}
+
+memcached_return_t memcached_mset(memcached_st *ptr,
+                                  const char * const *keys,
+                                  const size_t *key_length,
+                                  const char * const *values,
+                                  const size_t *value_length,
+                                  size_t number_of_keys,
+                                  time_t expiration,
+                                  uint32_t flags,
+                                  memcached_return_t *results)
+{
+  return mset_by_key(ptr, NULL, 0,
+                     keys, key_length, values, value_length, number_of_keys,
+                     expiration, flags, results);
+}
+
+memcached_return_t memcached_mset_by_key(memcached_st *ptr,
+                                         const char *group_key,
+                                         size_t group_key_length,
+                                         const char * const *keys,
+                                         const size_t *key_length,
+                                         const char * const *values,
+                                         const size_t *value_length,
+                                         size_t number_of_keys,
+                                         time_t expiration,
+                                         uint32_t flags,
+                                         memcached_return_t *results)
+{
+  return mset_by_key(ptr, group_key, group_key_length,
+                     keys, key_length, values, value_length, number_of_keys,
+                     expiration, flags, results);
+}
@@ -40,7 +40,9 @@
 
 static memcached_return_t ascii_touch(memcached_instance_st* instance,
                                       const char *key, size_t key_length,
-                                      time_t expiration)
+                                      time_t expiration,
+                                      const bool reply= true,
+                                      const bool should_flush= true)
 {
   char expiration_buffer[MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
   int expiration_buffer_length= snprintf(expiration_buffer, sizeof(expiration_buffer), " %llu", (unsigned long long)expiration);
@@ -57,11 +59,17 @@ static memcached_return_t ascii_touch(memcached_instance_st* instance,
     { memcached_array_string(instance->root->_namespace), memcached_array_size(instance->root->_namespace) },
     { key, key_length },
     { expiration_buffer, size_t(expiration_buffer_length) },
+    { " noreply", reply ? 0 : memcached_literal_param_size(" noreply") },
     { memcached_literal_param("\r\n") }
   };
 
+  if (should_flush)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_TOUCH);
+  }
+
   memcached_return_t rc;
-  if (memcached_failed(rc= memcached_vdo(instance, vector, 6, true)))
+  if (memcached_failed(rc= memcached_vdo(instance, vector, 7, should_flush)))
   {
     memcached_io_reset(instance);
     return memcached_set_error(*instance, MEMCACHED_WRITE_FAILURE, MEMCACHED_AT);
@@ -72,11 +80,17 @@ static memcached_return_t ascii_touch(memcached_instance_st* instance,
 
 static memcached_return_t binary_touch(memcached_instance_st* instance,
                                        const char *key, size_t key_length,
-                                       time_t expiration)
+                                       time_t expiration,
+                                       const uint32_t *opaque= NULL,
+                                       const bool should_flush= true)
 {
   protocol_binary_request_touch request= {}; //{.bytes= {0}};
 
   initialize_binary_request(instance, request.message.header);
+  if (opaque)
+  {
+    request.message.header.request.opaque= htonl(*opaque);
+  }
 
   request.message.header.request.opcode= PROTOCOL_BINARY_CMD_TOUCH;
   request.message.header.request.extlen= 4;
@@ -93,8 +107,13 @@ static memcached_return_t binary_touch(memcached_instance_st* instance,
     { key, key_length }
   };
 
+  if (should_flush)
+  {
+    memcached_server_stats_start(instance, MEMCACHED_OPERATION_TOUCH);
+  }
+
   memcached_return_t rc;
-  if (memcached_failed(rc= memcached_vdo(instance, vector, 4, true)))
+  if (memcached_failed(rc= memcached_vdo(instance, vector, 4, should_flush)))
   {
     memcached_io_reset(instance);
     return memcached_set_error(*instance, MEMCACHED_WRITE_FAILURE, MEMCACHED_AT);
@@ -128,9 +147,11 @@ memcached_return_t memcached_touch_by_key(memcached_st *shell,
   {
     return memcached_set_error(*ptr, rc, MEMCACHED_AT);
   }
+  memcached_near_cache_invalidate(ptr, key, key_length);
 
   uint32_t server_key= memcached_generate_hash_with_redistribution(ptr, group_key, group_key_length);
   memcached_instance_st* instance= memcached_instance_fetch(ptr, server_key);
+  memcached_hot_replicas_changed(ptr, server_key, key, key_length, true);
 
   if (ptr->flags.binary_protocol)
   {
@@ -149,6 +170,9 @@ memcached_return_t memcached_touch_by_key(memcached_st *shell,
   char buffer[MEMCACHED_DEFAULT_COMMAND_SIZE];
   rc= memcached_response(instance, buffer, sizeof(buffer), NULL);
 
+  // A read answered before the server applied the touch may have cached the old expiration
+  memcached_near_cache_invalidate(ptr, key, key_length);
+
   if (rc == MEMCACHED_SUCCESS or rc == MEMCACHED_NOTFOUND)
   {
     return rc;
@@ -156,3 +180,93 @@ memcached_return_t memcached_touch_by_key(memcached_st *shell,
 
   return memcached_set_error(*instance, rc, MEMCACHED_AT, memcached_literal_param("Error occcured while reading response"));
 }
+
+struct mtouch_context_st
+{
+  const char * const *keys;
+  const size_t *key_length;
+  time_t expiration;
+};
+
+static memcached_return_t mtouch_send(Memcached *ptr,
+                                      memcached_instance_st* instance,
+                                      uint32_t server_key,
+                                      uint32_t position,
+                                      bool reply,
+                                      void *context)
+{
+  mtouch_context_st *mtouch= static_cast<mtouch_context_st *>(context);
+  memcached_hot_replicas_changed(ptr, server_key,
+                                 mtouch->keys[position], mtouch->key_length[position], false);
+
+  // There is no quiet TOUCH, every key is answered and matched by its opaque
+  if (memcached_is_binary(ptr))
+  {
+    return binary_touch(instance,
+                        mtouch->keys[position], mtouch->key_length[position],
+                        mtouch->expiration, &position, false);
+  }
+
+  return ascii_touch(instance,
+                     mtouch->keys[position], mtouch->key_length[position],
+                     mtouch->expiration, reply, false);
+}
+
+static memcached_return_t mtouch_response(Memcached *,
+                                          uint32_t,
+                                          memcached_return_t rc,
+                                          memcached_result_st *,
+                                          void *)
+{
+  return rc;
+}
+
+static memcached_return_t mtouch_by_key(Memcached *ptr,
+                                        const char *group_key, size_t group_key_length,
+                                        const char * const *keys,
+                                        const size_t *key_length,
+                                        size_t number_of_keys,
+                                        time_t expiration,
+                                        memcached_return_t *results)
+{
+  if (ptr == NULL)
+  {
+    return MEMCACHED_INVALID_ARGUMENTS;
+  }
+
+  mtouch_context_st context= { keys, key_length, expiration };
+
+  memcached_batch_st batch;
+  batch.send= mtouch_send;
+  batch.response= mtouch_response;
+  batch.context= &context;
+  batch.reply= memcached_is_binary(ptr) or memcached_is_replying(ptr);
+
+  return memcached_batch(ptr, group_key, group_key_length,
+                         keys, key_length, number_of_keys,
+                         batch, results);
+}
+
+memcached_return_t memcached_mtouch(memcached_st *shell,
+                                    const char * const *keys,
+                                    const size_t *key_length,
+                                    size_t number_of_keys,
+                                    time_t expiration,
+                                    memcached_return_t *results)
+{
+  return mtouch_by_key(memcached2Memcached(shell), NULL, 0,
+                       keys, key_length, number_of_keys, expiration, results);
+}
+
+memcached_return_t memcached_mtouch_by_key(memcached_st *shell,
+                                           const char *group_key,
+                                           size_t group_key_length,
+                                           const char * const *keys,
+                                           const size_t *key_length,
+                                           size_t number_of_keys,
+                                           time_t expiration,
+                                           memcached_return_t *results)
+{
+  return mtouch_by_key(memcached2Memcached(shell), group_key, group_key_length,
+                       keys, key_length, number_of_keys, expiration, results);
+}
@@ -28,6 +28,15 @@ typedef protocol_binary_response_status
                                                   uint32_t bodylen,
                                                   uint32_t flags,
                                                   uint64_t cas);
+/**
+ * Callback to release a body which was sent by reference
+ *
+ * @param cookie The cookie of the client the body was sent to
+ * @param context The context given along with the callback
+ */
+typedef void (*memcached_binary_protocol_release_func)(const void *cookie,
+                                                       void *context);
+
 /**
  * Callback to send data back from a STAT command
  *
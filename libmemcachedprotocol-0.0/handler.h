@@ -213,6 +213,22 @@ int memcached_protocol_client_get_errno(memcached_protocol_client_st *client);
 LIBMEMCACHED_API
 memcached_binary_protocol_raw_response_handler memcached_binary_protocol_get_raw_response_handler(const void *cookie);
 
+/**
+ * Send the body of the next call to the get response handler from where
+ * it is, instead of copying it into the send buffers. The body must stay
+ * valid until release is called, which happens once it is sent or the
+ * client is destroyed. A small body is copied and released right away,
+ * and release is also called if the command ends without sending a body.
+ *
+ * @param cookie the cookie passed along into the callback
+ * @param release the function to call once the body isn't needed anymore
+ * @param context passed along to release
+ */
+LIBMEMCACHED_API
+void memcached_binary_protocol_reference_body(const void *cookie,
+                                              memcached_binary_protocol_release_func release,
+                                              void *context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -311,7 +311,7 @@ ascii_get_response_handler(const void *cookie,
   }
 
   client->root->spool(client, buffer, strlen(buffer));
-  client->root->spool(client, body, bodylen);
+  client->root->spool_body(client, body, bodylen);
   client->root->spool(client, "\r\n", 2);
 
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
@@ -978,8 +978,7 @@ static int process_prepend_command(memcached_protocol_client_st *client,
  */
 memcached_protocol_event_t memcached_ascii_protocol_process_data(memcached_protocol_client_st *client, ssize_t *length, void **endptr)
 {
-  char *ptr= (char*)client->root->input_buffer;
-  *endptr= ptr;
+  char *ptr= (char*)*endptr;
 
   do {
     /* Do we have \n (indicating the command preamble)*/
@@ -236,7 +236,7 @@ static protocol_binary_response_status get_response_handler(const void *cookie,
   const protocol_binary_response_status success= PROTOCOL_BINARY_RESPONSE_SUCCESS;
   if ((rval= client->root->spool(client, response.bytes, sizeof(response.bytes))) != success ||
       (rval= client->root->spool(client, key, keylen)) != success ||
-      (rval= client->root->spool(client, body, bodylen)) != success)
+      (rval= client->root->spool_body(client, body, bodylen)) != success)
   {
     return rval;
   }
@@ -1114,8 +1114,9 @@ static protocol_binary_response_status execute_command(memcached_protocol_client
 memcached_protocol_event_t memcached_binary_protocol_process_data(memcached_protocol_client_st *client, ssize_t *length, void **endptr)
 {
   /* try to parse all of the received packets */
+  uint8_t *buffer= *endptr;
   protocol_binary_request_header *header;
-  header= (void*)client->root->input_buffer;
+  header= (void*)buffer;
   if (header->request.magic != (uint8_t)PROTOCOL_BINARY_REQ)
   {
     client->error= EINVAL;
@@ -1154,8 +1155,8 @@ memcached_protocol_event_t memcached_binary_protocol_process_data(memcached_prot
       else
       {
         /* Fix alignment */
-        memmove(client->root->input_buffer, (void*)ptr, (size_t)len);
-        header= (void*)client->root->input_buffer;
+        memmove(buffer, (void*)ptr, (size_t)len);
+        header= (void*)buffer;
       }
     }
     *length= len;
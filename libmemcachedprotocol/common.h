@@ -56,6 +56,14 @@ typedef protocol_binary_response_status (*spool_func)(memcached_protocol_client_
                                                       const void *data,
                                                       size_t length);
 
+/*
+ * The per-connection input buffers come in INPUT_BUFFER_CLASSES sizes,
+ * from INPUT_BUFFER_MINSIZE and four times bigger for every class. A
+ * command which doesn't fit in the largest one is refused.
+ */
+#define INPUT_BUFFER_MINSIZE 4096
+#define INPUT_BUFFER_CLASSES 6
+
 /**
  * Definition of the per instance structure.
  */
@@ -70,6 +78,8 @@ struct memcached_protocol_st {
    */
   drain_func drain;
   spool_func spool;
+  /* Spool the body of a value, which may be referenced instead */
+  spool_func spool_body;
 
   /*
    * To avoid keeping a buffer in each client all the time I have a
@@ -84,6 +94,10 @@ struct memcached_protocol_st {
   bool pedantic;
   /* @todo use multiple sized buffers */
   cache_t *buffer_cache;
+  /* The chunks referencing the data of a body */
+  cache_t *reference_cache;
+  /* The per-connection input buffers, a cache for every size */
+  cache_t *input_cache[INPUT_BUFFER_CLASSES];
 };
 
 struct chunk_st {
@@ -97,10 +111,19 @@ struct chunk_st {
   size_t size;
   /* Pointer to the next buffer in the chain */
   struct chunk_st *next;
+  /* Called once referenced data is sent, NULL if the data is in the chunk */
+  memcached_binary_protocol_release_func release;
+  void *release_context;
 };
 
 #define CHUNK_BUFFERSIZE 2048
+/* Bodies smaller than this are copied even if they could be referenced */
+#define REFERENCE_MINSIZE (4 * CHUNK_BUFFERSIZE)
 
+/*
+ * Parse and execute the commands in the *length bytes at *endptr. Upon
+ * return *length and *endptr tell the incomplete command left, if any.
+ */
 typedef memcached_protocol_event_t (*process_data)(struct memcached_protocol_client_st *client, ssize_t *length, void **endptr);
 
 enum ascii_cmd {
@@ -133,14 +156,19 @@ struct memcached_protocol_client_st {
   struct chunk_st *output;
   struct chunk_st *output_tail;
 
+  /* How to release the next body, see memcached_binary_protocol_reference_body */
+  memcached_binary_protocol_release_func body_release;
+  void *body_release_context;
+
   /*
    * While we process input data, this is where we spool incomplete commands
-   * if we need to receive more data....
-   * @todo use the buffercace
+   * if we need to receive more data. The rest of the command is received
+   * right behind it, and it is parsed from there.
    */
   uint8_t *input_buffer;
   size_t input_buffer_size;
   size_t input_buffer_offset;
+  int input_buffer_class;
 
   /* The callback to the protocol handler to use (ascii or binary) */
   process_data work;
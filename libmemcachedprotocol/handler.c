@@ -48,6 +48,17 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <limits.h>
+#ifndef __MINGW32__
+# include <sys/uio.h>
+#endif
+
+/* The most chunks handed to a single sendmsg() while draining the output */
+#ifdef IOV_MAX
+# define DRAIN_IOV_MAX IOV_MAX
+#else
+# define DRAIN_IOV_MAX 16
+#endif
 
 /*
 ** **********************************************************************
@@ -95,6 +106,86 @@ static ssize_t default_send(const void *cookie,
   return send(fd, buf, nbytes, MSG_NOSIGNAL);
 }
 
+/**
+ * Run the release callback set for the next body, if it wasn't used
+ *
+ * @param client the client the body was meant for
+ */
+static void release_body(struct memcached_protocol_client_st *client)
+{
+  memcached_binary_protocol_release_func release= client->body_release;
+
+  if (release != NULL)
+  {
+    client->body_release= NULL;
+    release(client, client->body_release_context);
+  }
+}
+
+/**
+ * Give an output chunk back, releasing the data it references
+ *
+ * @param client the client the chunk was spooled for
+ * @param chunk the chunk to free
+ */
+static void free_output_chunk(struct memcached_protocol_client_st *client,
+                              struct chunk_st *chunk)
+{
+  if (chunk->release != NULL)
+  {
+    chunk->release(client, chunk->release_context);
+    cache_free(client->root->reference_cache, chunk);
+  }
+  else
+  {
+    cache_free(client->root->buffer_cache, chunk);
+  }
+}
+
+/**
+ * Send as much of the output list as possible. With the default send
+ * function the chunks go out with a single sendmsg(), otherwise they are
+ * handed to the send function one at a time.
+ *
+ * @param client the client to send the output of
+ * @return the number of bytes sent or -1 upon error
+ */
+static ssize_t send_output(struct memcached_protocol_client_st *client)
+{
+#ifndef __MINGW32__
+  if (client->root->send == default_send && client->output->next != NULL)
+  {
+    struct iovec iov[DRAIN_IOV_MAX];
+    size_t count= 0;
+
+    for (struct chunk_st *chunk= client->output;
+         chunk != NULL && count < DRAIN_IOV_MAX;
+         chunk= chunk->next)
+    {
+      iov[count].iov_base= chunk->data + chunk->offset;
+      iov[count].iov_len= chunk->nbytes - chunk->offset;
+      ++count;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov= iov;
+#ifdef __APPLE__
+    msg.msg_iovlen= (int)count;
+#else
+    msg.msg_iovlen= count;
+#endif
+
+    return sendmsg(client->sock, &msg, MSG_NOSIGNAL);
+  }
+#endif
+
+  return client->root->send(client,
+                            client->sock,
+                            client->output->data + client->output->offset,
+                            client->output->nbytes - client->output->offset);
+}
+
 /**
  * Try to drain the output buffers without blocking
  *
@@ -115,10 +206,7 @@ static bool drain_output(struct memcached_protocol_client_st *client)
   /* Do we have pending data to send? */
   while (client->output != NULL)
   {
-    ssize_t len= client->root->send(client,
-                            client->sock,
-                            client->output->data + client->output->offset,
-                            client->output->nbytes - client->output->offset);
+    ssize_t len= send_output(client);
 
     if (len == -1)
     {
@@ -134,17 +222,25 @@ static bool drain_output(struct memcached_protocol_client_st *client)
     }
     else
     {
-      client->output->offset += (size_t)len;
-      if (client->output->offset == client->output->nbytes)
+      size_t sent= (size_t)len;
+
+      /* Drop the buffers which were sent completely */
+      while (client->output != NULL &&
+             sent >= client->output->nbytes - client->output->offset)
       {
-        /* This was the complete buffer */
         struct chunk_st *old= client->output;
-        client->output= client->output->next;
+        sent-= old->nbytes - old->offset;
+        client->output= old->next;
         if (client->output == NULL)
         {
           client->output_tail= NULL;
         }
-        cache_free(client->root->buffer_cache, old);
+        free_output_chunk(client, old);
+      }
+
+      if (client->output != NULL)
+      {
+        client->output->offset+= sent;
       }
     }
   }
@@ -171,6 +267,7 @@ static struct chunk_st *allocate_output_chunk(struct memcached_protocol_client_s
   ret->next= NULL;
   ret->size= CHUNK_BUFFERSIZE;
   ret->data= (void*)(ret + 1);
+  ret->release= NULL;
   if (client->output == NULL)
   {
     client->output= client->output_tail= ret;
@@ -209,7 +306,7 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
 
   size_t offset= 0;
 
-  struct chunk_st *chunk= client->output;
+  struct chunk_st *chunk= client->output_tail;
   while (offset < length)
   {
     if (chunk == NULL || (chunk->size - chunk->nbytes) == 0)
@@ -226,7 +323,7 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
       bulk= chunk->size - chunk->nbytes;
     }
 
-    memcpy(chunk->data + chunk->nbytes, data, bulk);
+    memcpy(chunk->data + chunk->nbytes, (const char*)data + offset, bulk);
     chunk->nbytes += bulk;
     offset += bulk;
   }
@@ -234,6 +331,61 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
   return PROTOCOL_BINARY_RESPONSE_SUCCESS;
 }
 
+/**
+ * Spool the body of a value for a client. If the caller asked for it to
+ * be referenced and it is large enough, it is chained into the output as
+ * it is, and released once it has been sent.
+ *
+ * @param client the client to spool the body for
+ * @param data the body to spool
+ * @param length the number of bytes in the body
+ * @return PROTOCOL_BINARY_RESPONSE_SUCCESS if success,
+ *         PROTOCOL_BINARY_RESPONSE_ENOMEM if we failed to allocate memory
+ */
+static protocol_binary_response_status spool_body(struct memcached_protocol_client_st *client,
+                                                  const void *data,
+                                                  size_t length)
+{
+  if (client->body_release == NULL || client->mute || length < REFERENCE_MINSIZE)
+  {
+    protocol_binary_response_status rval= spool_output(client, data, length);
+    release_body(client);
+    return rval;
+  }
+
+  if (client->is_verbose)
+  {
+    fprintf(stderr, "%s:%d %s reference length:%d\n", __FILE__, __LINE__, __func__, (int)length);
+  }
+
+  struct chunk_st *chunk= cache_alloc(client->root->reference_cache);
+  if (chunk == NULL)
+  {
+    release_body(client);
+    return PROTOCOL_BINARY_RESPONSE_ENOMEM;
+  }
+
+  chunk->data= (char*)data;
+  chunk->offset= 0;
+  chunk->nbytes= chunk->size= length;
+  chunk->next= NULL;
+  chunk->release= client->body_release;
+  chunk->release_context= client->body_release_context;
+  client->body_release= NULL;
+
+  if (client->output == NULL)
+  {
+    client->output= client->output_tail= chunk;
+  }
+  else
+  {
+    client->output_tail->next= chunk;
+    client->output_tail= chunk;
+  }
+
+  return PROTOCOL_BINARY_RESPONSE_SUCCESS;
+}
+
 /**
  * Try to determine the protocol used on this connection.
  * If the first byte contains the magic byte PROTOCOL_BINARY_REQ we should
@@ -244,7 +396,7 @@ static protocol_binary_response_status spool_output(struct memcached_protocol_cl
  */
 static memcached_protocol_event_t determine_protocol(struct memcached_protocol_client_st *client, ssize_t *length, void **endptr)
 {
-  if (*client->root->input_buffer == (uint8_t)PROTOCOL_BINARY_REQ)
+  if (*(uint8_t*)*endptr == (uint8_t)PROTOCOL_BINARY_REQ)
   {
     if (client->is_verbose)
     {
@@ -289,6 +441,109 @@ static memcached_protocol_event_t determine_protocol(struct memcached_protocol_c
   return client->work(client, length, endptr);
 }
 
+/**
+ * The number of bytes needed to hold an incomplete command, which is known
+ * once the header of a binary command is in. Otherwise the buffer just
+ * needs room for more.
+ *
+ * @param client the client the command came from
+ * @param data the incomplete command
+ * @param length the number of bytes of it received so far
+ * @return the size of the buffer to keep the command in
+ */
+static size_t input_needed(struct memcached_protocol_client_st *client,
+                           const void *data,
+                           size_t length)
+{
+  const protocol_binary_request_header *header= data;
+
+  if (client->work == memcached_binary_protocol_process_data &&
+      length >= sizeof(*header))
+  {
+    size_t total= sizeof(*header) + ntohl(header->request.bodylen);
+    if (total > length)
+    {
+      return total;
+    }
+  }
+
+  return length + 1;
+}
+
+/**
+ * Give the input buffer of a client back to its cache
+ *
+ * @param client the client owning the buffer
+ */
+static void release_input_buffer(struct memcached_protocol_client_st *client)
+{
+  if (client->input_buffer != NULL)
+  {
+    cache_free(client->root->input_cache[client->input_buffer_class],
+               client->input_buffer);
+    client->input_buffer= NULL;
+    client->input_buffer_size= 0;
+  }
+  client->input_buffer_offset= 0;
+}
+
+/**
+ * Keep an incomplete command in the input buffer of the client, so that
+ * the rest of it can be received behind it. The buffer is taken from the
+ * smallest size class which holds the complete command, and is only
+ * replaced when the command outgrows it.
+ *
+ * @param client the client the command came from
+ * @param data the incomplete command (may be inside the client's buffer)
+ * @param length the number of bytes of it received so far
+ * @return false if the command is too large or we failed to allocate memory
+ */
+static bool keep_input(struct memcached_protocol_client_st *client,
+                       const void *data,
+                       size_t length)
+{
+  size_t needed= input_needed(client, data, length);
+
+  if (client->input_buffer != NULL && needed <= client->input_buffer_size)
+  {
+    if (data != client->input_buffer)
+    {
+      memmove(client->input_buffer, data, length);
+    }
+    client->input_buffer_offset= length;
+
+    return true;
+  }
+
+  int cls= 0;
+  size_t size= INPUT_BUFFER_MINSIZE;
+  while (size < needed)
+  {
+    if (++cls == INPUT_BUFFER_CLASSES)
+    {
+      client->error= EMSGSIZE;
+      return false;
+    }
+    size*= 4;
+  }
+
+  uint8_t *buffer= cache_alloc(client->root->input_cache[cls]);
+  if (buffer == NULL)
+  {
+    client->error= ENOMEM;
+    return false;
+  }
+
+  memcpy(buffer, data, length);
+  release_input_buffer(client);
+  client->input_buffer= buffer;
+  client->input_buffer_size= size;
+  client->input_buffer_offset= length;
+  client->input_buffer_class= cls;
+
+  return true;
+}
+
 /*
 ** **********************************************************************
 ** * PUBLIC INTERFACE
@@ -304,6 +559,7 @@ struct memcached_protocol_st *memcached_protocol_create_instance(void)
     ret->send= default_send;
     ret->drain= drain_output;
     ret->spool= spool_output;
+    ret->spool_body= spool_body;
     ret->input_buffer_size= 1 * 1024 * 1024;
     ret->input_buffer= malloc(ret->input_buffer_size);
     if (ret->input_buffer == NULL)
@@ -322,6 +578,26 @@ struct memcached_protocol_st *memcached_protocol_create_instance(void)
       free(ret->input_buffer);
       free(ret);
       ret= NULL;
+
+      return NULL;
+    }
+
+    ret->reference_cache= cache_create("protocol_reference",
+                                        sizeof(struct chunk_st), 0, NULL, NULL);
+    if (ret->reference_cache == NULL)
+    {
+      memcached_protocol_destroy_instance(ret);
+      return NULL;
+    }
+
+    size_t size= INPUT_BUFFER_MINSIZE;
+    for (int x= 0; x < INPUT_BUFFER_CLASSES; ++x, size*= 4)
+    {
+      if ((ret->input_cache[x]= cache_create("protocol_input", size, 0, NULL, NULL)) == NULL)
+      {
+        memcached_protocol_destroy_instance(ret);
+        return NULL;
+      }
     }
   }
 
@@ -330,6 +606,17 @@ struct memcached_protocol_st *memcached_protocol_create_instance(void)
 
 void memcached_protocol_destroy_instance(struct memcached_protocol_st *instance)
 {
+  for (int x= 0; x < INPUT_BUFFER_CLASSES; ++x)
+  {
+    if (instance->input_cache[x] != NULL)
+    {
+      cache_destroy(instance->input_cache[x]);
+    }
+  }
+  if (instance->reference_cache != NULL)
+  {
+    cache_destroy(instance->reference_cache);
+  }
   cache_destroy(instance->buffer_cache);
   free(instance->input_buffer);
   free(instance);
@@ -350,9 +637,28 @@ struct memcached_protocol_client_st *memcached_protocol_create_client(struct mem
 
 void memcached_protocol_client_destroy(struct memcached_protocol_client_st *client)
 {
+  while (client->output != NULL)
+  {
+    struct chunk_st *old= client->output;
+    client->output= old->next;
+    free_output_chunk(client, old);
+  }
+  release_body(client);
+  release_input_buffer(client);
   free(client);
 }
 
+void memcached_binary_protocol_reference_body(const void *cookie,
+                                              memcached_binary_protocol_release_func release,
+                                              void *context)
+{
+  memcached_protocol_client_st *client= (void*)cookie;
+
+  release_body(client);
+  client->body_release= release;
+  client->body_release_context= context;
+}
+
 void memcached_protocol_client_set_verbose(struct memcached_protocol_client_st *client, bool arg)
 {
   if (client)
@@ -367,27 +673,31 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
   bool more_data= true;
   do
   {
+    /*
+     * Read into the shared buffer of the instance, unless an incomplete
+     * command is kept for the client, which there is room behind.
+     */
+    uint8_t *buffer= client->root->input_buffer;
+    size_t size= client->root->input_buffer_size;
+    if (client->input_buffer != NULL)
+    {
+      buffer= client->input_buffer;
+      size= client->input_buffer_size;
+    }
+
     ssize_t len= client->root->recv(client,
                                     client->sock,
-                                    client->root->input_buffer + client->input_buffer_offset,
-                                    client->root->input_buffer_size - client->input_buffer_offset);
+                                    buffer + client->input_buffer_offset,
+                                    size - client->input_buffer_offset);
 
     if (len > 0)
     {
-      /* Do we have the complete packet? */
-      if (client->input_buffer_offset > 0)
-      {
-        memcpy(client->root->input_buffer, client->input_buffer,
-               client->input_buffer_offset);
-        len += (ssize_t)client->input_buffer_offset;
+      len += (ssize_t)client->input_buffer_offset;
 
-        /* @todo use buffer-cache! */
-        free(client->input_buffer);
-        client->input_buffer_offset= 0;
-      }
-
-      void *endptr;
+      void *endptr= buffer;
       memcached_protocol_event_t events= client->work(client, &len, &endptr);
+      /* In case a command asked for a body to be referenced but sent none */
+      release_body(client);
       if (events == MEMCACHED_PROTOCOL_ERROR_EVENT)
       {
         return MEMCACHED_PROTOCOL_ERROR_EVENT;
@@ -396,17 +706,16 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
       if (len > 0)
       {
         /* save the data for later on */
-        /* @todo use buffer-cache */
-        client->input_buffer= malloc((size_t)len);
-        if (client->input_buffer == NULL)
+        if (keep_input(client, endptr, (size_t)len) == false)
         {
-          client->error= ENOMEM;
           return MEMCACHED_PROTOCOL_ERROR_EVENT;
         }
-        memcpy(client->input_buffer, endptr, (size_t)len);
-        client->input_buffer_offset= (size_t)len;
         more_data= false;
       }
+      else
+      {
+        release_input_buffer(client);
+      }
     }
     else if (len == 0)
     {
@@ -434,7 +743,7 @@ memcached_protocol_event_t memcached_protocol_client_work(struct memcached_proto
   memcached_protocol_event_t ret= MEMCACHED_PROTOCOL_READ_EVENT;
   if (client->output)
   {
-    ret|= MEMCACHED_PROTOCOL_READ_EVENT;
+    ret|= MEMCACHED_PROTOCOL_WRITE_EVENT;
   }
 
   return ret;
@@ -50,6 +50,9 @@ typedef struct memcached_pool_st memcached_pool_st;
 LIBMEMCACHED_API
 memcached_pool_st *memcached_pool_create(memcached_st* mmc, uint32_t initial, uint32_t max);
 
+LIBMEMCACHED_API
+memcached_pool_st *memcached_pool_create_lock_free(memcached_st* mmc, uint32_t initial, uint32_t max);
+
 LIBMEMCACHED_API
 memcached_pool_st *memcached_pool(const char *option_string, size_t option_string_length);
 
@@ -42,6 +42,148 @@
 #include <cerrno>
 #include <pthread.h>
 #include <memory>
+#include <sched.h>
+
+struct memcached_pool_st;
+
+/*
+  The slot a thread keeps its last released handle in, so that its next
+  fetch does not touch anything shared. A handle parked here can still be
+  taken by another thread when the pool runs dry. Slots live as long as the
+  pool, the slot of a thread that has exited goes to the next thread that
+  needs one.
+*/
+struct pool_affinity_st
+{
+  memcached_st *memc;
+  uint32_t in_use;
+  memcached_pool_st *pool;
+  pool_affinity_st *next;
+};
+
+/*
+  Bounded multi-producer/multi-consumer queue of idle handles. Each cell has
+  a sequence number that tells producers and consumers whether it is theirs
+  for the current lap, so they only ever contend on the two positions.
+*/
+struct pool_free_list_st
+{
+  struct cell_st
+  {
+    uint32_t sequence;
+    memcached_st *memc;
+  };
+
+  cell_st *cells;
+  uint32_t mask;
+  char _pad_enqueue[64];
+  uint32_t enqueue_position;
+  char _pad_dequeue[64];
+  uint32_t dequeue_position;
+  char _pad_end[64];
+
+  pool_free_list_st() :
+    cells(NULL),
+    mask(0),
+    enqueue_position(0),
+    dequeue_position(0)
+  {
+  }
+
+  ~pool_free_list_st()
+  {
+    delete [] cells;
+  }
+
+  bool init(uint32_t capacity)
+  {
+    uint32_t length= 1;
+    while (length < capacity)
+    {
+      length<<= 1;
+    }
+
+    if ((cells= new (std::nothrow) cell_st[length]) == NULL)
+    {
+      return false;
+    }
+
+    for (uint32_t x= 0; x < length; ++x)
+    {
+      cells[x].sequence= x;
+      cells[x].memc= NULL;
+    }
+    mask= length -1;
+
+    return true;
+  }
+
+  bool push(memcached_st *memc)
+  {
+    uint32_t position= __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+    while (true)
+    {
+      cell_st& cell= cells[position & mask];
+      int32_t diff= int32_t(__atomic_load_n(&cell.sequence, __ATOMIC_ACQUIRE) -position);
+
+      if (diff == 0)
+      {
+        if (__atomic_compare_exchange_n(&enqueue_position, &position, position +1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+          cell.memc= memc;
+          __atomic_store_n(&cell.sequence, position +1, __ATOMIC_RELEASE);
+          return true;
+        }
+      }
+      else if (diff < 0)
+      {
+        // Only full if it is not a consumer a lap behind still emptying the cell
+        if (position -__atomic_load_n(&dequeue_position, __ATOMIC_ACQUIRE) > mask)
+        {
+          return false;
+        }
+        sched_yield();
+        position= __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+      }
+      else
+      {
+        position= __atomic_load_n(&enqueue_position, __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  memcached_st *pop()
+  {
+    uint32_t position= __atomic_load_n(&dequeue_position, __ATOMIC_RELAXED);
+    while (true)
+    {
+      cell_st& cell= cells[position & mask];
+      int32_t diff= int32_t(__atomic_load_n(&cell.sequence, __ATOMIC_ACQUIRE) -(position +1));
+
+      if (diff == 0)
+      {
+        if (__atomic_compare_exchange_n(&dequeue_position, &position, position +1, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+          memcached_st *memc= cell.memc;
+          __atomic_store_n(&cell.sequence, position +mask +1, __ATOMIC_RELEASE);
+          return memc;
+        }
+      }
+      else if (diff < 0)
+      {
+        return NULL;
+      }
+      else
+      {
+        position= __atomic_load_n(&dequeue_position, __ATOMIC_RELAXED);
+      }
+    }
+  }
+};
+
+static void pool_affinity_release(void *);
 
 struct memcached_pool_st
 {
@@ -54,14 +196,22 @@ struct memcached_pool_st
   uint32_t current_size;
   bool _owns_master;
   struct timespec _timeout;
+  const bool _lock_free;
+  pool_free_list_st _free_list;
+  pthread_key_t _affinity_key;
+  pool_affinity_st *_affinity;
+  uint32_t _waiters;
 
-  memcached_pool_st(memcached_st *master_arg, size_t max_arg) :
+  memcached_pool_st(memcached_st *master_arg, size_t max_arg, bool lock_free_arg) :
     master(master_arg),
     server_pool(NULL),
     firstfree(-1),
     size(uint32_t(max_arg)),
     current_size(0),
-    _owns_master(false)
+    _owns_master(false),
+    _lock_free(lock_free_arg),
+    _affinity(NULL),
+    _waiters(0)
   {
     pthread_mutex_init(&mutex, NULL);
     pthread_cond_init(&cond, NULL);
@@ -81,6 +231,16 @@ struct memcached_pool_st
 
   bool init(uint32_t initial);
 
+  memcached_st *clone(bool have_lock);
+  memcached_st *grow(bool have_lock);
+  memcached_st *acquire(bool have_lock);
+  memcached_st *refresh(memcached_st *, bool have_lock);
+  pool_affinity_st *affinity();
+  void wake();
+
+  memcached_st *lock_free_fetch(const struct timespec&, memcached_return_t& rc);
+  bool lock_free_release(memcached_st*, memcached_return_t& rc);
+
   ~memcached_pool_st()
   {
     for (int x= 0; x <= firstfree; ++x)
@@ -89,6 +249,25 @@ struct memcached_pool_st
       server_pool[x]= NULL;
     }
 
+    if (_lock_free and _free_list.cells)
+    {
+      pthread_key_delete(_affinity_key);
+
+      memcached_st *memc;
+      while ((memc= _free_list.pop()))
+      {
+        memcached_free(memc);
+      }
+
+      while (_affinity)
+      {
+        pool_affinity_st *next= _affinity->next;
+        memcached_free(_affinity->memc);
+        delete _affinity;
+        _affinity= next;
+      }
+    }
+
     int error;
     if ((error= pthread_mutex_destroy(&mutex)) != 0)
     {
@@ -109,7 +288,7 @@ struct memcached_pool_st
 
   void increment_version()
   {
-    ++master->configure.version;
+    __atomic_add_fetch(&master->configure.version, 1, __ATOMIC_RELEASE);
   }
 
   bool compare_version(const memcached_st *arg) const
@@ -119,7 +298,7 @@ struct memcached_pool_st
 
   int32_t version() const
   {
-    return master->configure.version;
+    return __atomic_load_n(&master->configure.version, __ATOMIC_ACQUIRE);
   }
 };
 
@@ -147,6 +326,33 @@ static bool grow_pool(memcached_pool_st* pool)
 
 bool memcached_pool_st::init(uint32_t initial)
 {
+  if (_lock_free)
+  {
+    if (_free_list.init(size) == false)
+    {
+      return false;
+    }
+
+    if (pthread_key_create(&_affinity_key, pool_affinity_release) != 0)
+    {
+      delete [] _free_list.cells;
+      _free_list.cells= NULL;
+      return false;
+    }
+
+    for (uint32_t x= 0; x < initial; ++x)
+    {
+      memcached_st *memc;
+      if ((memc= grow(false)) == NULL)
+      {
+        break;
+      }
+      _free_list.push(memc);
+    }
+
+    return true;
+  }
+
   server_pool= new (std::nothrow) memcached_st *[size];
   if (server_pool == NULL)
   {
@@ -169,14 +375,14 @@ bool memcached_pool_st::init(uint32_t initial)
 }
 
 
-static inline memcached_pool_st *_pool_create(memcached_st* master, uint32_t initial, uint32_t max)
+static inline memcached_pool_st *_pool_create(memcached_st* master, uint32_t initial, uint32_t max, bool lock_free)
 {
   if (initial == 0 or max == 0 or (initial > max))
   {
     return NULL;
   }
 
-  memcached_pool_st *object= new (std::nothrow) memcached_pool_st(master, max);
+  memcached_pool_st *object= new (std::nothrow) memcached_pool_st(master, max, lock_free);
   if (object == NULL)
   {
     return NULL;
@@ -197,7 +403,12 @@ static inline memcached_pool_st *_pool_create(memcached_st* master, uint32_t ini
 
 memcached_pool_st *memcached_pool_create(memcached_st* master, uint32_t initial, uint32_t max)
 {
-  return _pool_create(master, initial, max);
+  return _pool_create(master, initial, max, false);
+}
+
+memcached_pool_st *memcached_pool_create_lock_free(memcached_st* master, uint32_t initial, uint32_t max)
+{
+  return _pool_create(master, initial, max, true);
 }
 
 memcached_pool_st * memcached_pool(const char *option_string, size_t option_string_length)
@@ -250,6 +461,11 @@ memcached_st* memcached_pool_st::fetch(memcached_return_t& rc)
 
 memcached_st* memcached_pool_st::fetch(const struct timespec& relative_time, memcached_return_t& rc)
 {
+  if (_lock_free)
+  {
+    return lock_free_fetch(relative_time, rc);
+  }
+
   rc= MEMCACHED_SUCCESS;
 
   int error;
@@ -331,6 +547,11 @@ bool memcached_pool_st::release(memcached_st *released, memcached_return_t& rc)
     return false;
   }
 
+  if (_lock_free)
+  {
+    return lock_free_release(released, rc);
+  }
+
   int error;
   if ((error= pthread_mutex_lock(&mutex)))
   {
@@ -346,6 +567,7 @@ bool memcached_pool_st::release(memcached_st *released, memcached_return_t& rc)
     memcached_st *memc;
     if ((memc= memcached_clone(NULL, master)))
     {
+      memc->configure.version= version();
       memcached_free(released);
       released= memc;
     }
@@ -369,6 +591,295 @@ bool memcached_pool_st::release(memcached_st *released, memcached_return_t& rc)
   return true;
 }
 
+/*
+  Lock free mode. The mutex only guards the master, which is cloned when the
+  pool grows or a handle is out of date, and the condition variable is only
+  used once the pool is exhausted.
+*/
+static void pool_affinity_release(void *arg)
+{
+  pool_affinity_st *affinity= static_cast<pool_affinity_st *>(arg);
+
+  // The thread has exited, its parked handle goes back to everyone
+  memcached_st *memc;
+  if ((memc= __atomic_exchange_n(&affinity->memc, NULL, __ATOMIC_ACQUIRE)))
+  {
+    affinity->pool->_free_list.push(memc);
+    affinity->pool->wake();
+  }
+
+  __atomic_store_n(&affinity->in_use, 0, __ATOMIC_RELEASE);
+}
+
+memcached_st *memcached_pool_st::clone(bool have_lock)
+{
+  if (have_lock == false and pthread_mutex_lock(&mutex) != 0)
+  {
+    return NULL;
+  }
+
+  memcached_st *memc;
+  if ((memc= memcached_clone(NULL, master)))
+  {
+    memc->configure.version= version();
+  }
+
+  if (have_lock == false)
+  {
+    int error;
+    if ((error= pthread_mutex_unlock(&mutex)) != 0)
+    {
+      assert_vmsg(error != 0, "pthread_mutex_unlock() %s", strerror(error));
+    }
+  }
+
+  return memc;
+}
+
+memcached_st *memcached_pool_st::grow(bool have_lock)
+{
+  uint32_t current= __atomic_load_n(&current_size, __ATOMIC_RELAXED);
+  while (current < size)
+  {
+    if (__atomic_compare_exchange_n(&current_size, &current, current +1, true,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+      memcached_st *memc;
+      if ((memc= clone(have_lock)) == NULL)
+      {
+        __atomic_sub_fetch(&current_size, 1, __ATOMIC_RELAXED);
+      }
+
+      return memc;
+    }
+  }
+
+  return NULL;
+}
+
+memcached_st *memcached_pool_st::acquire(bool have_lock)
+{
+  memcached_st *memc;
+  if ((memc= _free_list.pop()) or (memc= grow(have_lock)))
+  {
+    return memc;
+  }
+
+  // Take a handle that another thread has parked
+  for (pool_affinity_st *slot= __atomic_load_n(&_affinity, __ATOMIC_ACQUIRE); slot; slot= slot->next)
+  {
+    if (__atomic_load_n(&slot->memc, __ATOMIC_RELAXED) and
+        (memc= __atomic_exchange_n(&slot->memc, NULL, __ATOMIC_ACQUIRE)))
+    {
+      return memc;
+    }
+  }
+
+  return NULL;
+}
+
+memcached_st *memcached_pool_st::refresh(memcached_st *memc, bool have_lock)
+{
+  // Someone updated the behavior on the pool since this handle was cloned
+  if (compare_version(memc) == false)
+  {
+    memcached_st *fresh;
+    if ((fresh= clone(have_lock)))
+    {
+      memcached_free(memc);
+      return fresh;
+    }
+  }
+
+  return memc;
+}
+
+pool_affinity_st *memcached_pool_st::affinity()
+{
+  pool_affinity_st *slot;
+  if ((slot= static_cast<pool_affinity_st *>(pthread_getspecific(_affinity_key))))
+  {
+    return slot;
+  }
+
+  for (slot= __atomic_load_n(&_affinity, __ATOMIC_ACQUIRE); slot; slot= slot->next)
+  {
+    uint32_t unused= 0;
+    if (__atomic_compare_exchange_n(&slot->in_use, &unused, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      break;
+    }
+  }
+
+  if (slot == NULL)
+  {
+    if ((slot= new (std::nothrow) pool_affinity_st) == NULL)
+    {
+      return NULL;
+    }
+    slot->memc= NULL;
+    slot->in_use= 1;
+    slot->pool= this;
+    slot->next= __atomic_load_n(&_affinity, __ATOMIC_RELAXED);
+    while (__atomic_compare_exchange_n(&_affinity, &slot->next, slot, true,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED) == false)
+    { }
+  }
+
+  if (pthread_setspecific(_affinity_key, slot) != 0)
+  {
+    __atomic_store_n(&slot->in_use, 0, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
+  return slot;
+}
+
+void memcached_pool_st::wake()
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&_waiters, __ATOMIC_RELAXED))
+  {
+    int error;
+    if ((error= pthread_mutex_lock(&mutex)) == 0)
+    {
+      if ((error= pthread_cond_broadcast(&cond)) != 0)
+      {
+        assert_vmsg(error != 0, "pthread_cond_broadcast() %s", strerror(error));
+      }
+
+      if ((error= pthread_mutex_unlock(&mutex)) != 0)
+      {
+        assert_vmsg(error != 0, "pthread_mutex_unlock() %s", strerror(error));
+      }
+    }
+  }
+}
+
+memcached_st* memcached_pool_st::lock_free_fetch(const struct timespec& relative_time, memcached_return_t& rc)
+{
+  rc= MEMCACHED_SUCCESS;
+
+  // Fast path, the handle this thread released last
+  memcached_st *ret= NULL;
+  pool_affinity_st *slot;
+  if ((slot= static_cast<pool_affinity_st *>(pthread_getspecific(_affinity_key))))
+  {
+    ret= __atomic_exchange_n(&slot->memc, NULL, __ATOMIC_ACQUIRE);
+  }
+
+  if (ret == NULL and (ret= acquire(false)) == NULL)
+  {
+    if (relative_time.tv_sec == 0 and relative_time.tv_nsec == 0)
+    {
+      rc= MEMCACHED_NOTFOUND;
+      return NULL;
+    }
+
+    int error;
+    if ((error= pthread_mutex_lock(&mutex)) != 0)
+    {
+      rc= MEMCACHED_IN_PROGRESS;
+      return NULL;
+    }
+
+    struct timespec time_to_wait= {0, 0};
+    time_to_wait.tv_sec= time(NULL) +relative_time.tv_sec;
+    time_to_wait.tv_nsec= relative_time.tv_nsec;
+
+    // Anyone releasing from now on sees us waiting, or we see their handle
+    __atomic_add_fetch(&_waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    while ((ret= acquire(true)) == NULL)
+    {
+      int thread_ret;
+      if ((thread_ret= pthread_cond_timedwait(&cond, &mutex, &time_to_wait)) != 0)
+      {
+        if (thread_ret == ETIMEDOUT)
+        {
+          rc= MEMCACHED_TIMEOUT;
+        }
+        else
+        {
+          errno= thread_ret;
+          rc= MEMCACHED_ERRNO;
+        }
+        break;
+      }
+    }
+
+    __atomic_sub_fetch(&_waiters, 1, __ATOMIC_SEQ_CST);
+
+    if (ret)
+    {
+      ret= refresh(ret, true);
+    }
+
+    if ((error= pthread_mutex_unlock(&mutex)) != 0)
+    {
+      assert_vmsg(error != 0, "pthread_mutex_unlock() %s", strerror(error));
+    }
+
+    return ret;
+  }
+
+  return refresh(ret, false);
+}
+
+bool memcached_pool_st::lock_free_release(memcached_st *released, memcached_return_t& rc)
+{
+  released= refresh(released, false);
+
+  // Park the handle for this thread's next fetch, unless someone is waiting
+  memcached_st *parked= NULL;
+  pool_affinity_st *slot;
+  if (__atomic_load_n(&_waiters, __ATOMIC_SEQ_CST) == 0 and (slot= affinity()))
+  {
+    // The handle parked before goes back to everyone
+    memcached_st *displaced= __atomic_exchange_n(&slot->memc, released, __ATOMIC_SEQ_CST);
+    if (displaced == released)
+    {
+      rc= MEMCACHED_INVALID_ARGUMENTS;
+      return false;
+    }
+    released= displaced;
+
+    // A waiter turned up, hand the handle over unless it already took it
+    if (__atomic_load_n(&_waiters, __ATOMIC_SEQ_CST))
+    {
+      parked= __atomic_exchange_n(&slot->memc, NULL, __ATOMIC_ACQUIRE);
+    }
+  }
+
+  // There is room for every handle the pool can ever create, so a handle
+  // which does not fit is not one of ours or was released twice
+  bool pushed= true;
+  if (parked and _free_list.push(parked) == false)
+  {
+    pushed= false;
+  }
+
+  if (released and _free_list.push(released) == false)
+  {
+    pushed= false;
+  }
+
+  if (parked or released)
+  {
+    wake();
+  }
+
+  if (pushed == false)
+  {
+    rc= MEMCACHED_INVALID_ARGUMENTS;
+    return false;
+  }
+
+  return true;
+}
+
 memcached_st* memcached_pool_fetch(memcached_pool_st* pool, struct timespec* relative_time, memcached_return_t* rc)
 {
   if (pool == NULL)
@@ -468,7 +979,11 @@ memcached_return_t memcached_pool_behavior_set(memcached_pool_st *pool,
   /* update the clones */
   for (int xx= 0; xx <= pool->firstfree; ++xx)
   {
-    if (memcached_success(memcached_behavior_set(pool->server_pool[xx], flag, data)))
+    /* Single flight, near cache, hot key and DNS cache state belong to the master, only a new clone shares them. */
+    if (flag != MEMCACHED_BEHAVIOR_SINGLE_FLIGHT and flag != MEMCACHED_BEHAVIOR_NEAR_CACHE and
+        flag != MEMCACHED_BEHAVIOR_HOT_KEYS and flag != MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS and
+        flag != MEMCACHED_BEHAVIOR_DNS_CACHE_TTL and
+        memcached_success(memcached_behavior_set(pool->server_pool[xx], flag, data)))
     {
       pool->server_pool[xx]->configure.version= pool->version();
     }
@@ -39,4 +39,8 @@
 test_return_t auto_eject_hosts(memcached_st *);
 test_return_t ketama_compatibility_libmemcached(memcached_st *);
 test_return_t ketama_compatibility_spymemcached(memcached_st *);
+test_return_t ketama_lookup_table_TEST(memcached_st *);
+test_return_t ketama_large_ring_TEST(memcached_st *);
+test_return_t ketama_auto_eject_incremental_TEST(memcached_st *);
+test_return_t ketama_rebuild_benchmark_TEST(memcached_st *);
 test_return_t user_supplied_bug18(memcached_st *);
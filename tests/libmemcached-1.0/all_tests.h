@@ -75,6 +75,8 @@ test_st tests[] ={
   {"decrement", false, (test_callback_fn*)decrement_test },
   {"memcached_decrement_with_initial(3)", true, (test_callback_fn*)decrement_with_initial_test },
   {"memcached_decrement_with_initial(999)", true, (test_callback_fn*)decrement_with_initial_999_test },
+  {"memcached_mincrement()", true, (test_callback_fn*)memcached_mincrement_TEST },
+  {"memcached_mincrement_with_initial()", true, (test_callback_fn*)memcached_mincrement_with_initial_TEST },
   {"increment_by_key", false, (test_callback_fn*)increment_by_key_test },
   {"increment_with_initial_by_key", true, (test_callback_fn*)increment_with_initial_by_key_test },
   {"decrement_by_key", false, (test_callback_fn*)decrement_by_key_test },
@@ -93,9 +95,24 @@ test_st tests[] ={
   {"get_stats_keys", false, (test_callback_fn*)get_stats_keys },
   {"version_string_test", true, (test_callback_fn*)version_string_test},
   {"memcached_mget() mixed memcached_get()", true, (test_callback_fn*)memcached_mget_mixed_memcached_get_TEST},
+  {"memcached_mget() large values", true, (test_callback_fn*)memcached_mget_large_values_TEST},
+  {"memcached_mset()", true, (test_callback_fn*)memcached_mset_TEST},
+  {"memcached_mset(MEMCACHED_E2BIG)", true, (test_callback_fn*)memcached_mset_E2BIG_TEST},
+  {"memcached_mdelete()", true, (test_callback_fn*)memcached_mdelete_TEST},
   {"bad_key", true, (test_callback_fn*)bad_key_test },
   {"memcached_server_cursor", true, (test_callback_fn*)memcached_server_cursor_test },
+  {"memcached_connect_all", true, (test_callback_fn*)memcached_connect_all_TEST },
   {"read_through", true, (test_callback_fn*)read_through },
+  {"MEMCACHED_BEHAVIOR_EARLY_REFRESH", true, (test_callback_fn*)early_refresh_TEST },
+  {"MEMCACHED_BEHAVIOR_NEAR_CACHE", true, (test_callback_fn*)near_cache_TEST },
+  {"MEMCACHED_BEHAVIOR_NEAR_CACHE write race", true, (test_callback_fn*)near_cache_write_race_TEST },
+  {"MEMCACHED_BEHAVIOR_HOT_KEYS", true, (test_callback_fn*)hot_keys_TEST },
+  {"MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS", true, (test_callback_fn*)hot_key_replicas_TEST },
+  {"MEMCACHED_BEHAVIOR_DNS_CACHE_TTL", true, (test_callback_fn*)dns_cache_TEST },
+  {"MEMCACHED_BEHAVIOR_SERVER_STATS", true, (test_callback_fn*)server_stats_TEST },
+  {"MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR", true, (test_callback_fn*)latency_eject_TEST },
+  {"MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR slow server", true, (test_callback_fn*)latency_eject_slow_server_TEST },
+  {"MEMCACHED_BEHAVIOR_HEDGED_READS", true, (test_callback_fn*)hedged_reads_TEST },
   {"delete_through", true, (test_callback_fn*)test_MEMCACHED_CALLBACK_DELETE_TRIGGER },
   {"noreply", true, (test_callback_fn*)noreply_test},
   {"analyzer", true, (test_callback_fn*)analyzer_test},
@@ -114,6 +131,7 @@ test_st tests[] ={
   {"memcached_exist_by_key(MEMCACHED_SUCCESS)", true, (test_callback_fn*)memcached_exist_by_key_SUCCESS },
   {"memcached_touch", 0, (test_callback_fn*)test_memcached_touch},
   {"memcached_touch_with_prefix", 0, (test_callback_fn*)test_memcached_touch_by_key},
+  {"memcached_mtouch", 0, (test_callback_fn*)test_memcached_mtouch},
 #if 0
   {"memcached_dump() no data", true, (test_callback_fn*)memcached_dump_TEST },
 #endif
@@ -124,6 +142,7 @@ test_st tests[] ={
 test_st touch_tests[] ={
   {"memcached_touch", 0, (test_callback_fn*)test_memcached_touch},
   {"memcached_touch_with_prefix", 0, (test_callback_fn*)test_memcached_touch_by_key},
+  {"memcached_mtouch", 0, (test_callback_fn*)test_memcached_mtouch},
   {0, 0, 0}
 };
 
@@ -145,6 +164,7 @@ test_st behavior_tests[] ={
   {"MEMCACHED_BEHAVIOR_CORK", false, (test_callback_fn*)MEMCACHED_BEHAVIOR_CORK_test},
   {"MEMCACHED_BEHAVIOR_TCP_KEEPALIVE", false, (test_callback_fn*)MEMCACHED_BEHAVIOR_TCP_KEEPALIVE_test},
   {"MEMCACHED_BEHAVIOR_TCP_KEEPIDLE", false, (test_callback_fn*)MEMCACHED_BEHAVIOR_TCP_KEEPIDLE_test},
+  {"MEMCACHED_BEHAVIOR_ZERO_COPY", true, (test_callback_fn*)MEMCACHED_BEHAVIOR_ZERO_COPY_test},
   {"MEMCACHED_BEHAVIOR_POLL_TIMEOUT", false, (test_callback_fn*)MEMCACHED_BEHAVIOR_POLL_TIMEOUT_test},
   {"MEMCACHED_BEHAVIOR_IO_KEY_PREFETCH_TEST", true, (test_callback_fn*)MEMCACHED_BEHAVIOR_IO_KEY_PREFETCH_TEST },
   {"MEMCACHED_CALLBACK_DELETE_TRIGGER_and_MEMCACHED_BEHAVIOR_NOREPLY", false, (test_callback_fn*)test_MEMCACHED_CALLBACK_DELETE_TRIGGER_and_MEMCACHED_BEHAVIOR_NOREPLY},
@@ -291,6 +311,10 @@ test_st regression_tests[]= {
 test_st ketama_compatibility[]= {
   {"libmemcached", true, (test_callback_fn*)ketama_compatibility_libmemcached },
   {"spymemcached", true, (test_callback_fn*)ketama_compatibility_spymemcached },
+  {"lookup table", true, (test_callback_fn*)ketama_lookup_table_TEST },
+  {"large ring", true, (test_callback_fn*)ketama_large_ring_TEST },
+  {"auto eject incremental", true, (test_callback_fn*)ketama_auto_eject_incremental_TEST },
+  {"rebuild benchmark", true, (test_callback_fn*)ketama_rebuild_benchmark_TEST },
   {0, 0, (test_callback_fn*)0}
 };
 
@@ -418,6 +442,11 @@ test_st memcached_server_add_TESTS[] ={
 
 test_st pool_TESTS[] ={
   {"lp:962815", true, (test_callback_fn*)regression_bug_962815 },
+  {"lp:962815 lock free", true, (test_callback_fn*)regression_bug_962815_lock_free },
+  {"memcached_pool_create_lock_free()", true, (test_callback_fn*)connection_pool_lock_free_test },
+  {"memcached_pool_create_lock_free() release from another thread", true, (test_callback_fn*)connection_pool3_lock_free_test },
+  {"memcached_pool_st contention", true, (test_callback_fn*)memcached_pool_contention_TEST },
+  {"MEMCACHED_BEHAVIOR_SINGLE_FLIGHT", true, (test_callback_fn*)memcached_pool_single_flight_TEST },
   {0, 0, (test_callback_fn*)0}
 };
 
@@ -126,6 +126,13 @@ static test_return_t pre_nonblock(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+static test_return_t pre_binary(memcached_st *memc)
+{
+  test_skip(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+
+  return TEST_SUCCESS;
+}
+
 /*
   Set the value, then quit to make sure it is flushed.
   Come back in and test that add fails.
@@ -255,6 +262,44 @@ static test_return_t post_allocate(memcached_st *)
   return TEST_SUCCESS;
 }
 
+#define LARGE_SET_VALUE_LENGTH (256 * 1024)
+#define LARGE_SET_TEST_LOOP 2000
+
+static test_return_t large_set_benchmark(memcached_st *memc, bool zero_copy)
+{
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ZERO_COPY, zero_copy));
+
+  libtest::vchar_t value;
+  libtest::vchar::make(value, LARGE_SET_VALUE_LENGTH);
+
+  libtest::Timer timer;
+  timer.reset();
+  for (ptrdiff_t x= 0; x < LARGE_SET_TEST_LOOP; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, test_literal_param("large_set_benchmark"),
+                               &value[0], value.size(),
+                               time_t(0), uint32_t(0)));
+  }
+  timer.sample();
+
+  uint64_t milliseconds= timer.elapsed_milliseconds();
+  uint64_t bytes= uint64_t(LARGE_SET_VALUE_LENGTH) * LARGE_SET_TEST_LOOP;
+  Out << (zero_copy ? "zero-copy" : "copy") << " " << (bytes * 1000 / (milliseconds ? milliseconds : 1)) << " bytes/sec";
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t large_set_copy_benchmark(memcached_st *memc)
+{
+  return large_set_benchmark(memc, false);
+}
+
+static test_return_t large_set_zero_copy_benchmark(memcached_st *memc)
+{
+  return large_set_benchmark(memc, true);
+}
 
 test_st micro_tests[] ={
   {"memcached_create", 1, (test_callback_fn*)memcached_create_benchmark },
@@ -262,11 +307,19 @@ test_st micro_tests[] ={
   {0, 0, 0}
 };
 
+test_st large_set_tests[] ={
+  {"memcached_set(copy)", true, (test_callback_fn*)large_set_copy_benchmark },
+  {"memcached_set(zero-copy)", true, (test_callback_fn*)large_set_zero_copy_benchmark },
+  {0, 0, 0}
+};
+
 
 collection_st collection[] ={
   {"smash", 0, 0, smash_tests},
   {"smash_nonblock", (test_callback_fn*)pre_nonblock, 0, smash_tests},
   {"micro-benchmark", (test_callback_fn*)pre_allocate, (test_callback_fn*)post_allocate, micro_tests},
+  {"large-set-benchmark", 0, 0, large_set_tests},
+  {"large-set-benchmark-binary", (test_callback_fn*)pre_binary, 0, large_set_tests},
   {0, 0, 0, 0}
 };
 
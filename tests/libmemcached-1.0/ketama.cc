@@ -36,6 +36,10 @@
 
 #include <mem_config.h>
 #include <libtest/test.hpp>
+using namespace libtest;
+
+#include <sys/time.h>
+#include <vector>
 
 #include <libmemcached-1.0/memcached.h>
 
@@ -289,3 +293,270 @@ test_return_t ketama_compatibility_spymemcached(memcached_st *)
 
   return TEST_SUCCESS;
 }
+
+/*
+  The lookup table only narrows the search, every key must land on the same
+  server with and without it.
+*/
+test_return_t ketama_lookup_table_TEST(memcached_st *)
+{
+  const memcached_server_distribution_t distributions[]= {
+    MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA,
+    MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA_SPY,
+    MEMCACHED_DISTRIBUTION_CONSISTENT_WEIGHTED
+  };
+
+  for (size_t d= 0; d < sizeof(distributions) / sizeof(distributions[0]); ++d)
+  {
+    memcached_st *memc= memcached_create(NULL);
+    test_true(memc);
+
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set_distribution(memc, distributions[d]));
+
+    for (uint32_t x= 0; x < 100; ++x)
+    {
+      char hostname[32];
+      snprintf(hostname, sizeof(hostname), "10.0.%u.%u", x / 8, x % 8 +1);
+      uint32_t weight= distributions[d] == MEMCACHED_DISTRIBUTION_CONSISTENT_WEIGHTED ? x % 7 +1 : 1;
+      test_compare(MEMCACHED_SUCCESS,
+                   memcached_server_add_with_weight(memc, hostname, in_port_t(11211 + x % 3), weight));
+    }
+
+    /* VDEAAAAA hashes after the last continuum point and wraps around. */
+    test_compare(memc->ketama.continuum[0].index, memcached_generate_hash(memc, test_literal_param("VDEAAAAA")));
+
+    std::vector<uint32_t> expected;
+    for (uint32_t x= 0; x < 20000; ++x)
+    {
+      char key[32];
+      int key_length= snprintf(key, sizeof(key), "key%u", x);
+      expected.push_back(memcached_generate_hash(memc, key, size_t(key_length)));
+    }
+
+    test_false(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE));
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE, true));
+    test_true(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE));
+    test_true(memc->ketama.lookup);
+
+    test_compare(memc->ketama.continuum[0].index, memcached_generate_hash(memc, test_literal_param("VDEAAAAA")));
+    for (uint32_t x= 0; x < 20000; ++x)
+    {
+      char key[32];
+      int key_length= snprintf(key, sizeof(key), "key%u", x);
+      test_compare(expected[x], memcached_generate_hash(memc, key, size_t(key_length)));
+    }
+
+    /* Every continuum point must be found from its own value. */
+    for (uint32_t x= 0; x < memc->ketama.continuum_points_counter; ++x)
+    {
+      uint32_t value= memc->ketama.continuum[x].value;
+      uint32_t bucket= value >> (32 - memc->ketama.lookup_bits);
+      test_true(memc->ketama.lookup[bucket] <= x);
+      test_true(x < memc->ketama.lookup[bucket +1]);
+    }
+
+    /* A clone carries the behavior and rebuilds its own table. */
+    memcached_st *clone= memcached_clone(NULL, memc);
+    test_true(clone);
+    test_true(clone->ketama.lookup);
+    test_true(clone->ketama.lookup != memc->ketama.lookup);
+    test_compare(expected[0], memcached_generate_hash(clone, test_literal_param("key0")));
+    memcached_free(clone);
+
+    test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_KETAMA_LOOKUP_TABLE, false));
+    test_null(memc->ketama.lookup);
+
+    memcached_free(memc);
+  }
+
+  return TEST_SUCCESS;
+}
+
+/*
+  Rings well past the old 100 server limit, including one that turns
+  weighted after its first server was added.
+*/
+test_return_t ketama_large_ring_TEST(memcached_st *)
+{
+  const uint32_t server_counts[]= { 101, 420, 1000 };
+
+  for (size_t c= 0; c < sizeof(server_counts) / sizeof(server_counts[0]); ++c)
+  {
+    for (uint32_t weighted= 0; weighted < 2; ++weighted)
+    {
+      memcached_st *memc= memcached_create(NULL);
+      test_true(memc);
+      test_compare(MEMCACHED_SUCCESS, memcached_behavior_set_distribution(memc, MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA));
+
+      for (uint32_t x= 0; x < server_counts[c]; ++x)
+      {
+        char hostname[32];
+        snprintf(hostname, sizeof(hostname), "10.%u.%u.%u", x / 250, x % 250, x % 3 +1);
+        uint32_t weight= (weighted and x) ? x % 5 +1 : 1;
+        test_compare(MEMCACHED_SUCCESS,
+                     memcached_server_add_with_weight(memc, hostname, 11211, weight));
+      }
+      test_compare(server_counts[c], memcached_server_count(memc));
+      test_compare(bool(weighted), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_KETAMA_WEIGHTED));
+
+      uint32_t points= memc->ketama.continuum_points_counter;
+      test_true(points <= memc->ketama.continuum_count);
+      if (weighted)
+      {
+        test_true(points <= server_counts[c] * MEMCACHED_POINTS_PER_SERVER_KETAMA);
+        test_true(points > server_counts[c] * (MEMCACHED_POINTS_PER_SERVER_KETAMA - 8));
+      }
+      else
+      {
+        test_compare(server_counts[c] * MEMCACHED_POINTS_PER_SERVER, points);
+      }
+
+      std::vector<uint32_t> per_server(server_counts[c]);
+      for (uint32_t x= 0; x < points; ++x)
+      {
+        if (x)
+        {
+          test_true(memc->ketama.continuum[x -1].value <= memc->ketama.continuum[x].value);
+        }
+        test_true(memc->ketama.continuum[x].index < server_counts[c]);
+        per_server[memc->ketama.continuum[x].index]++;
+      }
+
+      for (uint32_t x= 0; x < server_counts[c]; ++x)
+      {
+        test_true(per_server[x]);
+      }
+
+      memcached_free(memc);
+    }
+  }
+
+  return TEST_SUCCESS;
+}
+
+static memcached_st *create_ketama_ring(uint32_t server_count, bool weighted)
+{
+  memcached_st *memc= memcached_create(NULL);
+  if (memc)
+  {
+    memcached_behavior_set_distribution(memc, weighted ? MEMCACHED_DISTRIBUTION_CONSISTENT_WEIGHTED : MEMCACHED_DISTRIBUTION_CONSISTENT_KETAMA);
+    memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_AUTO_EJECT_HOSTS, true);
+
+    for (uint32_t x= 0; x < server_count; ++x)
+    {
+      char hostname[32];
+      snprintf(hostname, sizeof(hostname), "10.%u.%u.%u", x / 250, x % 250, x % 3 +1);
+      memcached_server_add_with_weight(memc, hostname, in_port_t(x % 2 ? 11211 : 11300), weighted ? x % 5 +1 : 1);
+    }
+  }
+
+  return memc;
+}
+
+static void ketama_set_next_retry(memcached_st *memc, uint32_t server_key, time_t next_retry)
+{
+  memcached_instance_next_retry(memcached_server_instance_by_position(memc, server_key), next_retry);
+}
+
+/*
+  Ejecting and restoring servers updates the ring in place, it has to end
+  up exactly where a full rebuild with the same live servers would.
+*/
+test_return_t ketama_auto_eject_incremental_TEST(memcached_st *)
+{
+  for (uint32_t weighted= 0; weighted < 2; ++weighted)
+  {
+    const uint32_t server_count= 40;
+    memcached_st *incremental= create_ketama_ring(server_count, weighted);
+    test_true(incremental);
+    memcached_st *rebuilt= create_ketama_ring(server_count, weighted);
+    test_true(rebuilt);
+
+    for (uint32_t step= 0; step < 200; ++step)
+    {
+      time_t now= time(NULL);
+      uint32_t server_key= (step * 7919) % server_count;
+      time_t next_retry= (step % 3) ? now +100 : 0;
+
+      // Every so often eject everything, and bring it all back after.
+      for (uint32_t x= 0; x < server_count; ++x)
+      {
+        if (x == server_key or step % 50 == 25 or step % 50 == 26)
+        {
+          time_t retry= (step % 50 == 26) ? 0 : next_retry;
+          ketama_set_next_retry(incremental, x, retry);
+          ketama_set_next_retry(rebuilt, x, retry);
+        }
+      }
+
+      incremental->ketama.next_distribution_rebuild= now -1;
+      memcached_autoeject(incremental);
+      test_compare(MEMCACHED_SUCCESS,
+                   memcached_behavior_set(rebuilt, MEMCACHED_BEHAVIOR_DISTRIBUTION, memcached_behavior_get(rebuilt, MEMCACHED_BEHAVIOR_DISTRIBUTION)));
+
+      test_compare(rebuilt->ketama.continuum_points_counter, incremental->ketama.continuum_points_counter);
+      for (uint32_t x= 0; x < rebuilt->ketama.continuum_points_counter; ++x)
+      {
+        test_compare(rebuilt->ketama.continuum[x].value, incremental->ketama.continuum[x].value);
+        test_compare(rebuilt->ketama.continuum[x].index, incremental->ketama.continuum[x].index);
+      }
+    }
+
+    memcached_free(incremental);
+    memcached_free(rebuilt);
+  }
+
+  return TEST_SUCCESS;
+}
+
+/*
+  Reports how long it takes to build the ring from scratch, and to eject
+  and restore one server, for rings of 100, 500 and 1000 servers.
+*/
+test_return_t ketama_rebuild_benchmark_TEST(memcached_st *)
+{
+  const uint32_t server_counts[]= { 100, 500, 1000 };
+  const uint32_t rounds= 10;
+
+  for (uint32_t weighted= 0; weighted < 2; ++weighted)
+  {
+    for (size_t c= 0; c < sizeof(server_counts) / sizeof(server_counts[0]); ++c)
+    {
+      memcached_st *memc= create_ketama_ring(server_counts[c], weighted);
+      test_true(memc);
+      test_compare(server_counts[c], memcached_server_count(memc));
+
+      struct timeval start, end;
+      gettimeofday(&start, NULL);
+      for (uint32_t x= 0; x < rounds; ++x)
+      {
+        test_compare(MEMCACHED_SUCCESS,
+                     memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_DISTRIBUTION, memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_DISTRIBUTION)));
+      }
+      gettimeofday(&end, NULL);
+      uint64_t rebuild= uint64_t(end.tv_sec - start.tv_sec) * 1000000 + uint64_t(end.tv_usec - start.tv_usec);
+
+      gettimeofday(&start, NULL);
+      for (uint32_t x= 0; x < rounds; ++x)
+      {
+        time_t now= time(NULL);
+        ketama_set_next_retry(memc, x, now +100);
+        memc->ketama.next_distribution_rebuild= now -1;
+        memcached_autoeject(memc);
+
+        ketama_set_next_retry(memc, x, 0);
+        memc->ketama.next_distribution_rebuild= now -1;
+        memcached_autoeject(memc);
+      }
+      gettimeofday(&end, NULL);
+      uint64_t eject= uint64_t(end.tv_sec - start.tv_sec) * 1000000 + uint64_t(end.tv_usec - start.tv_usec);
+
+      Out << (weighted ? "weighted " : "") << server_counts[c] << " servers: rebuild "
+        << rebuild / rounds << "us, eject or restore " << eject / (rounds * 2) << "us";
+
+      memcached_free(memc);
+    }
+  }
+
+  return TEST_SUCCESS;
+}
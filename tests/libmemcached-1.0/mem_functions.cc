@@ -55,16 +55,21 @@
 #include <libtest/memcached.hpp>
 
 #include <cerrno>
+#include <map>
 #include <memory>
+#include <netinet/in.h>
+#include <poll.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <signal.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <iostream>
+#include <string>
 
 #include <libtest/server.h>
 
@@ -466,7 +471,7 @@ test_return_t libmemcached_string_behavior_test(memcached_st *)
   {
     test_true(libmemcached_string_behavior(memcached_behavior_t(x)));
   }
-  test_compare(37, int(MEMCACHED_BEHAVIOR_MAX));
+  test_compare(51, int(MEMCACHED_BEHAVIOR_MAX));
 
   return TEST_SUCCESS;
 }
@@ -667,6 +672,175 @@ test_return_t memcached_mget_mixed_memcached_get_TEST(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+/*
+  Values are pipelined back to back so that value reads have to deal with
+  a partially filled read buffer, and with values that end anywhere
+  relative to MEMCACHED_MAX_BUFFER.
+*/
+test_return_t memcached_mget_large_values_TEST(memcached_st *memc)
+{
+  const size_t value_sizes[]= { 1, MEMCACHED_MAX_BUFFER -1, MEMCACHED_MAX_BUFFER, MEMCACHED_MAX_BUFFER +1,
+    (MEMCACHED_MAX_BUFFER *3) +7, 512 *1024, 20, (MEMCACHED_MAX_BUFFER *2) -2 };
+  const size_t number_of= sizeof(value_sizes) / sizeof(value_sizes[0]);
+
+  char key_buffer[number_of][MEMCACHED_MAXIMUM_INTEGER_DISPLAY_LENGTH +1];
+  const char *keys[number_of];
+  size_t key_lengths[number_of];
+  libtest::vchar_t values[number_of];
+
+  for (size_t x= 0; x < number_of; x++)
+  {
+    int key_length= snprintf(key_buffer[x], sizeof(key_buffer[x]), "large%u", uint32_t(x));
+    keys[x]= key_buffer[x];
+    key_lengths[x]= size_t(key_length);
+    libtest::vchar::make(values[x], value_sizes[x]);
+
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys[x], key_lengths[x],
+                               &values[x][0], values[x].size(),
+                               time_t(0), uint32_t(x)));
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget(memc, keys, key_lengths, number_of));
+
+  memcached_result_st result_obj;
+  memcached_result_st *result= memcached_result_create(memc, &result_obj);
+  test_true(result);
+
+  size_t result_count= 0;
+  memcached_return_t rc;
+  while (memcached_fetch_result(memc, result, &rc))
+  {
+    test_compare(MEMCACHED_SUCCESS, rc);
+    uint32_t which= memcached_result_flags(result);
+    test_true(which < number_of);
+    test_compare(key_lengths[which], memcached_result_key_length(result));
+    test_memcmp(keys[which], memcached_result_key_value(result), key_lengths[which]);
+    test_compare(values[which].size(), memcached_result_length(result));
+    test_memcmp(&values[which][0], memcached_result_value(result), values[which].size());
+    result_count++;
+  }
+  test_compare(MEMCACHED_END, rc);
+  test_compare(number_of, result_count);
+  memcached_result_free(result);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  More keys than MEMCACHED_BEHAVIOR_IO_MSG_WATERMARK so that each server
+  sees more than one window.
+*/
+test_return_t memcached_mset_TEST(memcached_st *memc)
+{
+  keys_st keys(2000);
+  std::vector<memcached_return_t> results(keys.size(), MEMCACHED_FAILURE);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mset(memc,
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.size(),
+                              time_t(0), uint32_t(7), &results[0]));
+
+  for (size_t x= 0; x < results.size(); ++x)
+  {
+    test_compare(MEMCACHED_SUCCESS, results[x]);
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mget(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size()));
+
+  memcached_result_st result_obj;
+  memcached_result_st *result= memcached_result_create(memc, &result_obj);
+  test_true(result);
+
+  size_t result_count= 0;
+  memcached_return_t rc;
+  while (memcached_fetch_result(memc, result, &rc))
+  {
+    test_compare(memcached_result_key_length(result), memcached_result_length(result));
+    test_memcmp(memcached_result_key_value(result), memcached_result_value(result), memcached_result_length(result));
+    test_compare(uint32_t(7), memcached_result_flags(result));
+    result_count++;
+  }
+  test_compare(keys.size(), result_count);
+  memcached_result_free(result);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_mset_E2BIG_TEST(memcached_st *memc)
+{
+  libtest::vchar_t too_large;
+  too_large.resize(2048 * 1024);
+
+  const char *keys[]= { "mset_first", "mset_too_large", "mset_last" };
+  size_t key_lengths[]= { strlen(keys[0]), strlen(keys[1]), strlen(keys[2]) };
+  const char *values[]= { "first", &too_large[0], "last" };
+  size_t value_lengths[]= { strlen(values[0]), too_large.size(), strlen(values[2]) };
+  memcached_return_t results[3];
+
+  test_compare(MEMCACHED_SOME_ERRORS,
+               memcached_mset(memc, keys, key_lengths, values, value_lengths, 3,
+                              time_t(0), uint32_t(0), results));
+
+  test_compare(MEMCACHED_SUCCESS, results[0]);
+  test_compare(MEMCACHED_E2BIG, results[1]);
+  test_compare(MEMCACHED_SUCCESS, results[2]);
+
+  for (size_t x= 0; x < 3; x+= 2)
+  {
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(memc, keys[x], key_lengths[x], &value_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(value_lengths[x], value_length);
+    test_memcmp(values[x], value, value_length);
+    free(value);
+  }
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_mdelete_TEST(memcached_st *memc)
+{
+  keys_st keys(2000);
+  std::vector<memcached_return_t> results(keys.size(), MEMCACHED_FAILURE);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mset(memc,
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.size(),
+                              time_t(0), uint32_t(0), NULL));
+
+  // Every other key is deleted ahead of time
+  for (size_t x= 0; x < keys.size(); x+= 2)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_delete(memc, keys.key_at(x), keys.length_at(x), 0));
+  }
+
+  test_compare(MEMCACHED_SOME_ERRORS,
+               memcached_mdelete(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(), &results[0]));
+
+  for (size_t x= 0; x < results.size(); ++x)
+  {
+    test_compare(x % 2 ? MEMCACHED_SUCCESS : MEMCACHED_NOTFOUND, results[x]);
+  }
+
+  for (size_t x= 0; x < keys.size(); ++x)
+  {
+    test_compare(MEMCACHED_NOTFOUND,
+                 memcached_exist(memc, keys.key_at(x), keys.length_at(x)));
+  }
+
+  return TEST_SUCCESS;
+}
+
 test_return_t cas2_test(memcached_st *memc)
 {
   const char *keys[]= {"fudge", "son", "food"};
@@ -1095,48 +1269,626 @@ static memcached_return_t read_through_trigger(memcached_st *, // memc
   return memcached_result_set_value(result, READ_THROUGH_VALUE, strlen(READ_THROUGH_VALUE));
 }
 
-#ifndef __INTEL_COMPILER
-#pragma GCC diagnostic ignored "-Wstrict-aliasing"
-#endif
-
-test_return_t read_through(memcached_st *memc)
+#ifndef __INTEL_COMPILER
+#pragma GCC diagnostic ignored "-Wstrict-aliasing"
+#endif
+
+test_return_t read_through(memcached_st *memc)
+{
+  memcached_trigger_key_fn cb= (memcached_trigger_key_fn)read_through_trigger;
+
+  size_t string_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *string= memcached_get(memc,
+                              test_literal_param(__func__),
+                              &string_length, &flags, &rc);
+
+  test_compare(MEMCACHED_NOTFOUND, rc);
+  test_false(string_length);
+  test_false(string);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(memc, MEMCACHED_CALLBACK_GET_FAILURE, *(void **)&cb));
+
+  string= memcached_get(memc,
+                        test_literal_param(__func__),
+                        &string_length, &flags, &rc);
+
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(sizeof(READ_THROUGH_VALUE) -1, string_length);
+  test_compare(0, string[sizeof(READ_THROUGH_VALUE) -1]);
+  test_strcmp(READ_THROUGH_VALUE, string);
+  free(string);
+
+  string= memcached_get(memc,
+                        test_literal_param(__func__),
+                        &string_length, &flags, &rc);
+
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(string);
+  test_compare(string_length, sizeof(READ_THROUGH_VALUE) -1);
+  test_true(string[sizeof(READ_THROUGH_VALUE) -1] == 0);
+  test_strcmp(READ_THROUGH_VALUE, string);
+  free(string);
+
+  return TEST_SUCCESS;
+}
+
+static uint32_t early_refresh_trigger_calls= 0;
+
+static memcached_return_t early_refresh_trigger(memcached_st *, // memc
+                                                char *, // key
+                                                size_t, //  key_length,
+                                                memcached_result_st *result)
+{
+  early_refresh_trigger_calls++;
+  dream(0, 20 * 1000 * 1000);
+  memcached_result_set_expiration(result, 2);
+
+  return memcached_result_set_value(result, READ_THROUGH_VALUE, strlen(READ_THROUGH_VALUE));
+}
+
+test_return_t early_refresh_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  memcached_trigger_key_fn cb= (memcached_trigger_key_fn)early_refresh_trigger;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(&memc, MEMCACHED_CALLBACK_GET_FAILURE, *(void **)&cb));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_EARLY_REFRESH, 100));
+  test_compare(uint64_t(100), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_EARLY_REFRESH));
+  memcached_delete(&memc, test_literal_param(__func__), 0);
+  early_refresh_trigger_calls= 0;
+
+  // The miss computes and stores the value with its envelope
+  size_t string_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *string= memcached_get(&memc, test_literal_param(__func__),
+                              &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(strlen(READ_THROUGH_VALUE), string_length);
+  test_strcmp(READ_THROUGH_VALUE, string);
+  free(string);
+  test_compare(1U, early_refresh_trigger_calls);
+
+  // Two seconds from expiry a 20ms computation is not refreshed
+  string= memcached_get(&memc, test_literal_param(__func__),
+                        &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(strlen(READ_THROUGH_VALUE), string_length);
+  test_strcmp(READ_THROUGH_VALUE, string);
+  test_zero(flags & MEMCACHED_EARLY_REFRESH_FLAG);
+  free(string);
+  test_compare(1U, early_refresh_trigger_calls);
+
+  // A value that merely looks like an envelope is returned untouched
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param("early_refresh_plain"),
+                             test_literal_param("\xff" "xf\x01" "0123456789"), 0, 0));
+  string= memcached_get(&memc, test_literal_param("early_refresh_plain"),
+                        &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(size_t(14), string_length);
+  test_zero(memcmp(string, "\xff" "xf\x01" "0123456789", string_length));
+  free(string);
+  test_compare(1U, early_refresh_trigger_calls);
+  memcached_delete(&memc, test_literal_param("early_refresh_plain"), 0);
+
+  // Without the behavior the envelope is left on the value
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_EARLY_REFRESH, 0));
+  string= memcached_get(&memc, test_literal_param(__func__),
+                        &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(flags & MEMCACHED_EARLY_REFRESH_FLAG);
+  test_compare(strlen(READ_THROUGH_VALUE) +8, string_length);
+  test_zero(memcmp(string +8, READ_THROUGH_VALUE, strlen(READ_THROUGH_VALUE)));
+  free(string);
+
+  // A huge beta makes every read recompute
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_EARLY_REFRESH, UINT32_MAX));
+  string= memcached_get(&memc, test_literal_param(__func__),
+                        &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(strlen(READ_THROUGH_VALUE), string_length);
+  test_strcmp(READ_THROUGH_VALUE, string);
+  free(string);
+  test_compare(2U, early_refresh_trigger_calls);
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_EARLY_REFRESH, uint64_t(UINT32_MAX) +1));
+
+  memcached_delete(&memc, test_literal_param(__func__), 0);
+
+  return TEST_SUCCESS;
+}
+
+/*
+  A small ASCII server on the loopback interface, run by a thread of the
+  test, which only knows get and set. Every reply can be delayed, and while
+  hold is set the sets it receives are neither applied nor answered. It is
+  stopped and joined when it goes out of scope.
+*/
+struct scripted_server_st
+{
+  struct connection_st
+  {
+    int fd;
+    std::string input;
+  };
+
+  int listener;
+  in_port_t port;
+  bool running;
+  pthread_t thread;
+  uint32_t stop;
+  uint32_t delay; // Milliseconds before every reply
+  uint32_t hold;
+  uint32_t held; // Sets received while holding
+  std::map<std::string, std::string> values;
+  std::vector<connection_st> connections;
+  std::vector<std::pair<int, std::string> > pending; // Held sets, with their connection
+
+  scripted_server_st() :
+    listener(-1),
+    port(0),
+    running(false),
+    stop(0),
+    delay(0),
+    hold(0),
+    held(0)
+  {
+    if ((listener= socket(AF_INET, SOCK_STREAM, 0)) == -1)
+    {
+      return;
+    }
+
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family= AF_INET;
+    sin.sin_addr.s_addr= htonl(INADDR_LOOPBACK);
+    socklen_t addrlen= sizeof(sin);
+    if (bind(listener, (struct sockaddr*)&sin, addrlen) == 0 and
+        listen(listener, 8) == 0 and
+        getsockname(listener, (struct sockaddr*)&sin, &addrlen) == 0)
+    {
+      port= ntohs(sin.sin_port);
+      running= pthread_create(&thread, NULL, serve, this) == 0;
+    }
+  }
+
+  ~scripted_server_st()
+  {
+    if (running)
+    {
+      __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+      pthread_join(thread, NULL);
+    }
+
+    for (size_t x= 0; x < connections.size(); ++x)
+    {
+      close(connections[x].fd);
+    }
+
+    if (listener != -1)
+    {
+      close(listener);
+    }
+  }
+
+  void reply(int fd, const std::string& message)
+  {
+    uint32_t milliseconds= __atomic_load_n(&delay, __ATOMIC_ACQUIRE);
+    if (milliseconds)
+    {
+      usleep(milliseconds * 1000);
+    }
+    if (write(fd, message.c_str(), message.size()) == -1)
+    {
+      return;
+    }
+  }
+
+  void store(int fd, const std::string& key_and_value)
+  {
+    size_t split= key_and_value.find(' ');
+    values[key_and_value.substr(0, split)]= key_and_value.substr(split +1);
+    reply(fd, "STORED\r\n");
+  }
+
+  /* Answer every complete command, false once the connection is closed */
+  bool work(connection_st& connection)
+  {
+    char buffer[4096];
+    ssize_t nread= read(connection.fd, buffer, sizeof(buffer));
+    if (nread <= 0)
+    {
+      return false;
+    }
+    connection.input.append(buffer, size_t(nread));
+
+    size_t end;
+    while ((end= connection.input.find("\r\n")) != std::string::npos)
+    {
+      std::string line= connection.input.substr(0, end);
+      char key[MEMCACHED_MAX_KEY];
+      unsigned int flags;
+      unsigned long expiration;
+      size_t length;
+
+      if (sscanf(line.c_str(), "set %250s %u %lu %zu", key, &flags, &expiration, &length) == 4)
+      {
+        if (connection.input.size() < end +2 +length +2)
+        {
+          return true;
+        }
+
+        std::string key_and_value= std::string(key) +" " +connection.input.substr(end +2, length);
+        connection.input.erase(0, end +2 +length +2);
+        if (__atomic_load_n(&hold, __ATOMIC_ACQUIRE))
+        {
+          pending.push_back(std::make_pair(connection.fd, key_and_value));
+          __atomic_add_fetch(&held, 1, __ATOMIC_RELEASE);
+        }
+        else
+        {
+          store(connection.fd, key_and_value);
+        }
+        continue;
+      }
+
+      connection.input.erase(0, end +2);
+      if (sscanf(line.c_str(), "get %250s", key) == 1)
+      {
+        std::string message;
+        std::map<std::string, std::string>::const_iterator value= values.find(key);
+        if (value != values.end())
+        {
+          char header[MEMCACHED_MAX_KEY +64];
+          snprintf(header, sizeof(header), "VALUE %s 0 %zu\r\n", key, value->second.size());
+          message= header +value->second +"\r\n";
+        }
+        reply(connection.fd, message +"END\r\n");
+      }
+      else
+      {
+        reply(connection.fd, "ERROR\r\n");
+      }
+    }
+
+    return true;
+  }
+
+  static void *serve(void *arg)
+  {
+    scripted_server_st *server= static_cast<scripted_server_st *>(arg);
+
+    while (__atomic_load_n(&server->stop, __ATOMIC_ACQUIRE) == 0)
+    {
+      if (__atomic_load_n(&server->hold, __ATOMIC_ACQUIRE) == 0)
+      {
+        for (size_t x= 0; x < server->pending.size(); ++x)
+        {
+          server->store(server->pending[x].first, server->pending[x].second);
+        }
+        server->pending.clear();
+      }
+
+      std::vector<struct pollfd> fds(server->connections.size() +1);
+      fds[0].fd= server->listener;
+      fds[0].events= POLLIN;
+      for (size_t x= 0; x < server->connections.size(); ++x)
+      {
+        fds[x +1].fd= server->connections[x].fd;
+        fds[x +1].events= POLLIN;
+      }
+
+      if (poll(&fds[0], nfds_t(fds.size()), 10) <= 0)
+      {
+        continue;
+      }
+
+      for (size_t x= server->connections.size(); x > 0; --x)
+      {
+        if (fds[x].revents and server->work(server->connections[x -1]) == false)
+        {
+          close(server->connections[x -1].fd);
+          server->connections.erase(server->connections.begin() +long(x -1));
+        }
+      }
+
+      int fd;
+      if (fds[0].revents and (fd= accept(server->listener, NULL, NULL)) != -1)
+      {
+        connection_st connection;
+        connection.fd= fd;
+        server->connections.push_back(connection);
+      }
+    }
+
+    return NULL;
+  }
+};
+
+static void *near_cache_write_race_writer(void *arg)
+{
+  memcached_st *writer= static_cast<memcached_st *>(arg);
+  (void)memcached_set(writer, test_literal_param("near_cache_write_race_TEST"), test_literal_param("new"), 0, 0);
+
+  return NULL;
+}
+
+test_return_t near_cache_write_race_TEST(memcached_st *original_memc)
+{
+  scripted_server_st server;
+  test_true(server.running);
+
+  test::Memc memc(original_memc);
+  memcached_servers_reset(&memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_server_add(&memc, "127.0.0.1", server.port));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, false));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE, 1 << 20));
+  test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, test_literal_param(__func__), test_literal_param("old"), 0, 0));
+
+  // The server holds on to a write from a sharing handle
+  __atomic_store_n(&server.hold, 1, __ATOMIC_RELEASE);
+  test::Memc writer(&memc);
+  pthread_t tid;
+  test_zero(pthread_create(&tid, NULL, near_cache_write_race_writer, &writer));
+  for (uint32_t x= 0; x < 5000 and __atomic_load_n(&server.held, __ATOMIC_ACQUIRE) == 0; x++)
+  {
+    usleep(1000);
+  }
+  bool held= __atomic_load_n(&server.held, __ATOMIC_ACQUIRE) == 1;
+
+  // A read answered in the meantime gets the old value
+  size_t string_length;
+  uint32_t flags;
+  memcached_return_t rc;
+  char *string= memcached_get(&memc, test_literal_param(__func__), &string_length, &flags, &rc);
+  __atomic_store_n(&server.hold, 0, __ATOMIC_RELEASE);
+  test_zero(pthread_join(tid, NULL));
+  test_true(held);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(test_literal_param_size("old"), string_length);
+  test_zero(memcmp(string, "old", string_length));
+  free(string);
+
+  // Which is no longer cached once the write is acknowledged
+  string= memcached_get(&memc, test_literal_param(__func__), &string_length, &flags, &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_compare(test_literal_param_size("new"), string_length);
+  test_zero(memcmp(string, "new", string_length));
+  free(string);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t near_cache_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  memcached_near_cache_stat_st stat;
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_near_cache_stats(&memc, &stat));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE, 1 << 20));
+  test_compare(uint64_t(1 << 20), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL, 0));
+  test_compare(uint64_t(MEMCACHED_NEAR_CACHE_TTL), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE_TTL));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param(__func__), test_literal_param("first"), 0, 17));
+
+  // The first read goes to the server, the second one does not
+  for (uint32_t x= 0; x < 2; x++)
+  {
+    size_t string_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *string= memcached_get(&memc, test_literal_param(__func__),
+                                &string_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(test_literal_param_size("first"), string_length);
+    test_zero(memcmp(string, "first", string_length));
+    test_compare(17U, flags);
+    free(string);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stats(&memc, &stat));
+  test_compare(1U, stat.misses);
+  test_compare(1U, stat.hits);
+  test_compare(1U, stat.items);
+
+  // Writing through the handle drops the local copy
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param(__func__), test_literal_param("second"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stats(&memc, &stat));
+  test_compare(1U, stat.invalidations);
+  test_zero(stat.items);
+
+  // A cached key is answered locally next to one fetched from the server
+  const char *keys[]= { __func__, "near_cache_other" };
+  size_t key_length[]= { strlen(__func__), strlen("near_cache_other") };
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, keys[1], key_length[1], test_literal_param("other"), 0, 0));
+  for (uint32_t x= 0; x < 2; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_mget(&memc, keys, key_length, 2));
+    size_t counter= 0;
+    memcached_execute_fn callbacks[]= { &callback_counter };
+    test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(&memc, callbacks, (void *)&counter, 1));
+    test_compare(size_t(2), counter);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stats(&memc, &stat));
+  test_compare(3U, stat.hits);
+  test_compare(3U, stat.misses);
+
+  // A value read while a sharing handle changes the key is not kept
+  const char *racy= "near_cache_racy";
+  size_t racy_length= strlen(racy);
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, racy, racy_length, test_literal_param("old"), 0, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(&memc, &racy, &racy_length, 1));
+  {
+    memcached_st *writer= memcached_clone(NULL, &memc);
+    test_true(writer);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(writer, racy, racy_length, test_literal_param("new"), 0, 0));
+    memcached_free(writer);
+  }
+  memcached_return_t rc;
+  memcached_result_st *result;
+  while ((result= memcached_fetch_result(&memc, NULL, &rc)))
+  {
+    memcached_result_free(result);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stats(&memc, &stat));
+  test_compare(1U, stat.rejections);
+  test_compare(2U, stat.items);
+
+  memcached_delete(&memc, racy, racy_length, 0);
+  memcached_delete(&memc, keys[0], key_length[0], 0);
+  memcached_delete(&memc, keys[1], key_length[1], 0);
+  test_compare(MEMCACHED_SUCCESS, memcached_near_cache_stats(&memc, &stat));
+  test_zero(stat.items);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_NEAR_CACHE, 0));
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_near_cache_stats(&memc, &stat));
+
+  return TEST_SUCCESS;
+}
+
+test_return_t hot_keys_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  memcached_hot_key_st keys[4];
+  uint32_t number_of_keys= 4;
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_hot_keys(&memc, keys, &number_of_keys));
+  test_zero(number_of_keys);
+  test_compare(MEMCACHED_INVALID_ARGUMENTS,
+               memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HOT_KEYS, MEMCACHED_MAX_HOT_KEYS +1));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HOT_KEYS, 4));
+  test_compare(uint64_t(4), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_HOT_KEYS));
+
+  for (uint32_t x= 0; x < 10; x++)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(&memc, test_literal_param("hot_keys_written"), test_literal_param("value"), 0, 0));
+  }
+
+  for (uint32_t x= 0; x < 5; x++)
+  {
+    memcached_return_t rc;
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(&memc, test_literal_param("hot_keys_read"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_NOTFOUND, rc);
+    test_null(string);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_hot_keys_add(&memc, test_literal_param("hot_keys_added")));
+
+  number_of_keys= 4;
+  test_compare(MEMCACHED_SUCCESS, memcached_hot_keys(&memc, keys, &number_of_keys));
+  test_compare(3U, number_of_keys);
+  test_strcmp("hot_keys_written", keys[0].key);
+  test_compare(10U, keys[0].count);
+  test_strcmp("hot_keys_read", keys[1].key);
+  test_compare(5U, keys[1].count);
+  test_strcmp("hot_keys_added", keys[2].key);
+  test_compare(1U, keys[2].count);
+  test_compare(memcached_generate_hash(&memc, test_literal_param("hot_keys_written")), keys[0].server_key);
+
+  memcached_delete(&memc, test_literal_param("hot_keys_written"), 0);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t hot_key_replicas_TEST(memcached_st *original_memc)
 {
-  memcached_trigger_key_fn cb= (memcached_trigger_key_fn)read_through_trigger;
-
-  size_t string_length;
-  uint32_t flags;
-  memcached_return_t rc;
-  char *string= memcached_get(memc,
-                              test_literal_param(__func__),
-                              &string_length, &flags, &rc);
+  test::Memc memc(original_memc);
+  test_skip(true, memcached_server_count(&memc) > 1);
 
-  test_compare(MEMCACHED_NOTFOUND, rc);
-  test_false(string_length);
-  test_false(string);
+  test_compare(MEMCACHED_NOT_SUPPORTED,
+               memcached_hot_key_replicate(&memc, test_literal_param("hot_key_replicas"), true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS, 1));
+  test_compare(uint64_t(1), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS));
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_hot_key_replicate(&memc, test_literal_param("hot_key_replicas"), true));
 
   test_compare(MEMCACHED_SUCCESS,
-               memcached_callback_set(memc, MEMCACHED_CALLBACK_GET_FAILURE, *(void **)&cb));
+               memcached_set(&memc, test_literal_param("hot_key_replicas"), test_literal_param("value"), 0, 0));
 
-  string= memcached_get(memc,
-                        test_literal_param(__func__),
-                        &string_length, &flags, &rc);
+  // Reads alternate between the primary and its copy
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    memcached_return_t rc;
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(&memc, test_literal_param("hot_key_replicas"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(test_literal_param_size("value"), string_length);
+    test_memcmp("value", string, string_length);
+    free(string);
+  }
 
-  test_compare(MEMCACHED_SUCCESS, rc);
-  test_compare(sizeof(READ_THROUGH_VALUE) -1, string_length);
-  test_compare(0, string[sizeof(READ_THROUGH_VALUE) -1]);
-  test_strcmp(READ_THROUGH_VALUE, string);
-  free(string);
+  // The copy goes away with the primary
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(&memc, test_literal_param("hot_key_replicas"), 0));
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    memcached_return_t rc;
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(&memc, test_literal_param("hot_key_replicas"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_NOTFOUND, rc);
+    test_null(string);
+  }
 
-  string= memcached_get(memc,
-                        test_literal_param(__func__),
-                        &string_length, &flags, &rc);
+  // Without copies, a pinned key is only read from its primary, mget included
+  {
+    test::Memc plain(original_memc);
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(&plain, test_literal_param("hot_key_replicas"), test_literal_param("5"), 0, 0));
+  }
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    const char *keys[]= { "hot_key_replicas" };
+    size_t lengths[]= { test_literal_param_size("hot_key_replicas") };
+    test_compare(MEMCACHED_SUCCESS, memcached_mget(&memc, keys, lengths, 1));
 
-  test_compare(MEMCACHED_SUCCESS, rc);
-  test_true(string);
-  test_compare(string_length, sizeof(READ_THROUGH_VALUE) -1);
-  test_true(string[sizeof(READ_THROUGH_VALUE) -1] == 0);
-  test_strcmp(READ_THROUGH_VALUE, string);
-  free(string);
+    memcached_return_t rc;
+    memcached_result_st *result= memcached_fetch_result(&memc, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(result);
+    test_compare(size_t(1), memcached_result_length(result));
+    memcached_result_free(result);
+    test_null(memcached_fetch_result(&memc, NULL, &rc));
+  }
+
+  // An increment drops the copies the set wrote, no read sees the old count
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param("hot_key_replicas"), test_literal_param("5"), 0, 0));
+  uint64_t new_number;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_increment(&memc, test_literal_param("hot_key_replicas"), 1, &new_number));
+  test_compare(uint64_t(6), new_number);
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    memcached_return_t rc;
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(&memc, test_literal_param("hot_key_replicas"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_memcmp("6", string, string_length);
+    free(string);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(&memc, test_literal_param("hot_key_replicas"), 0));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_hot_key_replicate(&memc, test_literal_param("hot_key_replicas"), false));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HOT_KEY_REPLICAS, 0));
+  test_compare(MEMCACHED_NOT_SUPPORTED,
+               memcached_hot_key_replicate(&memc, test_literal_param("hot_key_replicas"), true));
 
   return TEST_SUCCESS;
 }
@@ -1331,6 +2083,91 @@ test_return_t increment_with_initial_999_test(memcached_st *memc)
   return __increment_with_initial_test(memc, 999);
 }
 
+test_return_t memcached_mincrement_TEST(memcached_st *memc)
+{
+  keys_st keys(1000);
+  std::vector<memcached_return_t> results(keys.size(), MEMCACHED_FAILURE);
+  std::vector<uint64_t> values(keys.size());
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mset(memc,
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.keys_ptr(), keys.lengths_ptr(),
+                              keys.size(),
+                              time_t(0), uint32_t(0), NULL));
+
+  // Every other key becomes a counter starting at its position
+  for (size_t x= 0; x < keys.size(); x+= 2)
+  {
+    char buffer[32];
+    int length= snprintf(buffer, sizeof(buffer), "%u", uint32_t(x));
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys.key_at(x), keys.length_at(x), buffer, size_t(length), time_t(0), uint32_t(0)));
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_delete(memc, keys.key_at(x +1), keys.length_at(x +1), 0));
+  }
+
+  test_compare(MEMCACHED_SOME_ERRORS,
+               memcached_mincrement(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(),
+                                    5, &values[0], &results[0]));
+
+  for (size_t x= 0; x < keys.size(); x+= 2)
+  {
+    test_compare(MEMCACHED_SUCCESS, results[x]);
+    test_compare(uint64_t(x +5), values[x]);
+    test_compare(MEMCACHED_NOTFOUND, results[x +1]);
+    test_compare(UINT64_MAX, values[x +1]);
+  }
+
+  test_compare(MEMCACHED_SOME_ERRORS,
+               memcached_mdecrement(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(),
+                                    2, &values[0], NULL));
+
+  for (size_t x= 0; x < keys.size(); x+= 2)
+  {
+    test_compare(uint64_t(x +3), values[x]);
+  }
+
+  return TEST_SUCCESS;
+}
+
+test_return_t memcached_mincrement_with_initial_TEST(memcached_st *memc)
+{
+  keys_st keys(1000);
+  std::vector<memcached_return_t> results(keys.size(), MEMCACHED_FAILURE);
+  std::vector<uint64_t> values(keys.size());
+
+  if (memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL) == false)
+  {
+    test_compare(MEMCACHED_INVALID_ARGUMENTS,
+                 memcached_mincrement_with_initial(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(),
+                                                   1, 999, 0, &values[0], &results[0]));
+    return TEST_SUCCESS;
+  }
+
+  // None of the counters exist yet
+  (void)memcached_mdelete(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(), NULL);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mincrement_with_initial(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(),
+                                                 1, 999, 0, &values[0], &results[0]));
+  for (size_t x= 0; x < keys.size(); ++x)
+  {
+    test_compare(MEMCACHED_SUCCESS, results[x]);
+    test_compare(uint64_t(999), values[x]);
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mdecrement_with_initial(memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size(),
+                                                 10, 999, 0, &values[0], &results[0]));
+  for (size_t x= 0; x < keys.size(); ++x)
+  {
+    test_compare(uint64_t(989), values[x]);
+  }
+
+  return TEST_SUCCESS;
+}
+
 test_return_t decrement_test(memcached_st *memc)
 {
   test_compare(return_value_based_on_buffering(memc),
@@ -2153,6 +2990,42 @@ test_return_t MEMCACHED_BEHAVIOR_TCP_KEEPIDLE_test(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+test_return_t MEMCACHED_BEHAVIOR_ZERO_COPY_test(memcached_st *memc)
+{
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ZERO_COPY, true));
+  test_true(memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_ZERO_COPY));
+
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD, 0));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(memc, MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD, 1024));
+  test_compare(uint64_t(1024), memcached_behavior_get(memc, MEMCACHED_BEHAVIOR_ZERO_COPY_THRESHOLD));
+
+  // One value below the threshold, and one that spans several write buffers.
+  size_t lengths[]= { 512, 300 * 1024 };
+  for (size_t x= 0; x < 2; ++x)
+  {
+    libtest::vchar_t value;
+    libtest::vchar::make(value, lengths[x]);
+
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, test_literal_param(__func__),
+                               &value[0], value.size(),
+                               time_t(0), uint32_t(0)));
+
+    size_t returned_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *returned= memcached_get(memc, test_literal_param(__func__),
+                                  &returned_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(returned);
+    test_compare(value.size(), returned_length);
+    test_memcmp(&value[0], returned, returned_length);
+    free(returned);
+  }
+
+  return TEST_SUCCESS;
+}
+
 /* Make sure we behave properly if server list has no values */
 test_return_t user_supplied_bug4(memcached_st *memc)
 {
@@ -4460,6 +5333,274 @@ test_return_t test_multiple_get_last_disconnect(memcached_st *)
   return TEST_SUCCESS;
 }
 
+test_return_t memcached_connect_all_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+  memcached_servers_reset(&memc);
+  test_compare(MEMCACHED_NO_SERVERS, memcached_connect_all(&memc));
+
+  memcached_st *clone= memcached_clone(NULL, original_memc);
+  test_true(clone);
+  test_compare(MEMCACHED_SUCCESS, memcached_connect_all(clone));
+  test_compare(MEMCACHED_SUCCESS, memcached_connect_all(clone));
+
+  const char *keys[]= { "connect_all_one", "connect_all_two", "connect_all_three" };
+  size_t key_length[]= { strlen(keys[0]), strlen(keys[1]), strlen(keys[2]) };
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(clone, keys, key_length, 3));
+  unsigned int keys_returned;
+  memcached_return_t rc;
+  test_compare(TEST_SUCCESS, fetch_all_results(clone, keys_returned, rc));
+  test_compare(MEMCACHED_NOTFOUND, rc);
+  test_zero(keys_returned);
+  memcached_free(clone);
+
+  const char *server_string= "--server=localhost:8888 --server=localhost:8889 --server=localhost:8890";
+  memcached_st *dead= memcached(server_string, strlen(server_string));
+  test_true(dead);
+  test_compare(MEMCACHED_SOME_ERRORS, memcached_connect_all(dead));
+  test_true(memcached_server_get_last_disconnect(dead));
+  memcached_free(dead);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t dns_cache_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  test_zero(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL, 60));
+  test_compare(uint64_t(60), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL));
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param("dns_cache"), test_literal_param("value"), 0, 0));
+
+  // Clones share the cache and connect with the addresses already found
+  for (uint32_t x= 0; x < 4; x++)
+  {
+    memcached_st *clone= memcached_clone(NULL, &memc);
+    test_true(clone);
+    test_compare(uint64_t(60), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL));
+
+    memcached_return_t rc;
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(clone, test_literal_param("dns_cache"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_memcmp("value", string, string_length);
+    free(string);
+    memcached_free(clone);
+  }
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL, 0));
+  test_zero(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_DNS_CACHE_TTL));
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(&memc, test_literal_param("dns_cache"), 0));
+
+  return TEST_SUCCESS;
+}
+
+test_return_t server_stats_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  memcached_return_t rc;
+  const memcached_instance_st *instance= memcached_server_by_key(&memc, test_literal_param("server_stats"), &rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+
+  memcached_server_stats_st stats;
+  test_false(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_SERVER_STATS));
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_server_stats(instance, &stats));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_SERVER_STATS, true));
+  test_true(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_SERVER_STATS));
+  test_compare(MEMCACHED_SUCCESS, memcached_server_stats(instance, &stats));
+  test_zero(stats.operation[MEMCACHED_OPERATION_GET].count);
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(&memc, test_literal_param("server_stats"), test_literal_param("value"), 0, 0));
+  for (uint32_t x= 0; x < 10; x++)
+  {
+    size_t string_length;
+    uint32_t flags;
+    char *string= memcached_get(&memc, test_literal_param("server_stats"), &string_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    free(string);
+  }
+  test_compare(MEMCACHED_SUCCESS, memcached_delete(&memc, test_literal_param("server_stats"), 0));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_server_stats(instance, &stats));
+  test_compare(uint64_t(1), stats.operation[MEMCACHED_OPERATION_SET].count);
+  test_compare(uint64_t(10), stats.operation[MEMCACHED_OPERATION_GET].count);
+  test_compare(uint64_t(1), stats.operation[MEMCACHED_OPERATION_DELETE].count);
+  test_zero(stats.operation[MEMCACHED_OPERATION_GET].errors);
+
+  uint64_t median= memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_GET, 50);
+  uint64_t highest= memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_GET, 100);
+  test_true(median <= highest);
+  test_compare(stats.operation[MEMCACHED_OPERATION_GET].latency_max, highest);
+  test_zero(memcached_server_stats_percentile(&stats, MEMCACHED_OPERATION_TOUCH, 50));
+
+  memcached_server_stats_reset(&memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_server_stats(instance, &stats));
+  test_zero(stats.operation[MEMCACHED_OPERATION_GET].count);
+
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_SERVER_STATS, false));
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_server_stats(instance, &stats));
+
+  return TEST_SUCCESS;
+}
+
+test_return_t latency_eject_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  test_zero(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR, 1));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR, 10));
+  test_compare(uint64_t(10), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_DISTRIBUTION, MEMCACHED_DISTRIBUTION_CONSISTENT));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_REMOVE_FAILED_SERVERS, true));
+
+  // Servers answering at the same speed all stay in the ring
+  for (uint32_t x= 0; x < 200; x++)
+  {
+    char key[32];
+    int key_length= snprintf(key, sizeof(key), "latency_eject%u", x);
+    test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, key, size_t(key_length), test_literal_param("value"), 0, 0));
+  }
+
+  for (uint32_t x= 0; x < memcached_server_count(&memc); x++)
+  {
+    test_zero(memcached_server_instance_by_position(&memc, x)->next_retry);
+  }
+
+  memcached_st *clone= memcached_clone(NULL, &memc);
+  test_true(clone);
+  test_compare(uint64_t(10), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR));
+  memcached_free(clone);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t latency_eject_slow_server_TEST(memcached_st *original_memc)
+{
+  // Answers every command 20 milliseconds late
+  scripted_server_st server;
+  test_true(server.running);
+  __atomic_store_n(&server.delay, 20, __ATOMIC_RELEASE);
+  in_port_t slow_port= server.port;
+
+  test::Memc memc(original_memc);
+  test_compare(MEMCACHED_SUCCESS, memcached_server_add(&memc, "127.0.0.1", slow_port));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, false));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_DISTRIBUTION, MEMCACHED_DISTRIBUTION_CONSISTENT));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_REMOVE_FAILED_SERVERS, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_RETRY_TIMEOUT, 1));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_LATENCY_EJECT_FACTOR, 10));
+
+  const memcached_instance_st *slow= NULL;
+  uint32_t x;
+  for (x= 0; x < memcached_server_count(&memc); x++)
+  {
+    if (memcached_server_port(memcached_server_instance_by_position(&memc, x)) == slow_port)
+    {
+      slow= memcached_server_instance_by_position(&memc, x);
+    }
+  }
+  test_true(slow);
+
+  // The slow server leaves the ring once it has answered enough requests
+  for (x= 0; x < 1000 and slow->next_retry == 0; x++)
+  {
+    char key[32];
+    int key_length= snprintf(key, sizeof(key), "latency_eject_slow%u", x);
+    test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, key, size_t(key_length), test_literal_param("value"), 0, 0));
+  }
+  test_true(slow->next_retry > time(NULL));
+
+  for (x= 0; x < 100; x++)
+  {
+    char key[32];
+    int key_length= snprintf(key, sizeof(key), "latency_eject_slow%u", x);
+    test_true(memcached_server_port(memcached_server_by_key(&memc, key, size_t(key_length), NULL)) != slow_port);
+  }
+
+  // And is back in it after the backoff, well before ten seconds
+  bool readmitted= false;
+  for (uint32_t wait= 0; wait < 100 and readmitted == false; wait++)
+  {
+    usleep(100 * 1000);
+    memcached_autoeject(&memc);
+    for (x= 0; x < 100 and readmitted == false; x++)
+    {
+      char key[32];
+      int key_length= snprintf(key, sizeof(key), "latency_eject_slow%u", x);
+      if (memcached_server_port(memcached_server_by_key(&memc, key, size_t(key_length), NULL)) == slow_port)
+      {
+        readmitted= true;
+        test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, key, size_t(key_length), test_literal_param("value"), 0, 0));
+      }
+    }
+  }
+  test_true(readmitted);
+
+  return TEST_SUCCESS;
+}
+
+test_return_t hedged_reads_TEST(memcached_st *original_memc)
+{
+  test::Memc memc(original_memc);
+
+  test_zero(memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_HEDGED_READS));
+  test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HEDGED_READS, 101));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_HEDGED_READS, 90));
+  test_compare(uint64_t(90), memcached_behavior_get(&memc, MEMCACHED_BEHAVIOR_HEDGED_READS));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, true));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(&memc, MEMCACHED_BEHAVIOR_NUMBER_OF_REPLICAS, 1));
+
+  keys_st keys(100);
+  for (size_t x= 0; x < keys.size(); x++)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, keys.key_at(x), keys.length_at(x), keys.key_at(x), keys.length_at(x), 0, 0));
+  }
+
+  // Enough gets for every server to have a read latency to hedge with
+  for (size_t x= 0; x < keys.size(); x++)
+  {
+    size_t value_length;
+    uint32_t flags;
+    memcached_return_t rc;
+    char *value= memcached_get(&memc, keys.key_at(x), keys.length_at(x), &value_length, &flags, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_memcmp(keys.key_at(x), value, value_length);
+    free(value);
+  }
+
+  // Every key is returned once however many copies are asked for
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(&memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size()));
+  size_t counter= 0;
+  memcached_execute_fn callbacks[]= { &callback_counter };
+  test_compare(MEMCACHED_SUCCESS, memcached_fetch_execute(&memc, callbacks, (void *)&counter, 1));
+  test_compare(keys.size(), counter);
+
+  // Late copies of an mget left half fetched do not answer the next command
+  test_compare(MEMCACHED_SUCCESS, memcached_mget(&memc, keys.keys_ptr(), keys.lengths_ptr(), keys.size()));
+  memcached_return_t rc;
+  memcached_result_st *result= memcached_fetch_result(&memc, NULL, &rc);
+  test_true(result);
+  memcached_result_free(result);
+  test_compare(MEMCACHED_SUCCESS, memcached_set(&memc, test_literal_param("hedged_reads"), test_literal_param("value"), 0, 0));
+  uint64_t value;
+  test_compare(MEMCACHED_SUCCESS, memcached_increment_with_initial(&memc, test_literal_param("hedged_reads_counter"), 1, 1, 0, &value));
+
+  memcached_st *clone= memcached_clone(NULL, &memc);
+  test_true(clone);
+  test_compare(uint64_t(90), memcached_behavior_get(clone, MEMCACHED_BEHAVIOR_HEDGED_READS));
+  memcached_free(clone);
+
+  return TEST_SUCCESS;
+}
+
 test_return_t test_verbosity(memcached_st *memc)
 {
   memcached_verbosity(memc, 3);
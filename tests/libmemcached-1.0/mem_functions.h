@@ -41,6 +41,7 @@ test_return_t MEMCACHED_BEHAVIOR_CORK_test(memcached_st *memc);
 test_return_t MEMCACHED_BEHAVIOR_POLL_TIMEOUT_test(memcached_st *memc);
 test_return_t MEMCACHED_BEHAVIOR_TCP_KEEPALIVE_test(memcached_st *memc);
 test_return_t MEMCACHED_BEHAVIOR_TCP_KEEPIDLE_test(memcached_st *memc);
+test_return_t MEMCACHED_BEHAVIOR_ZERO_COPY_test(memcached_st *memc);
 test_return_t _user_supplied_bug21(memcached_st* memc, size_t key_count);
 test_return_t add_host_test(memcached_st *memc);
 test_return_t add_host_test1(memcached_st *memc);
@@ -104,6 +105,12 @@ test_return_t memcached_get_by_key_MEMCACHED_ERRNO(memcached_st *memc);
 test_return_t memcached_get_by_key_MEMCACHED_NOTFOUND(memcached_st *memc);
 test_return_t memcached_get_hashkit_test (memcached_st *);
 test_return_t memcached_mget_mixed_memcached_get_TEST(memcached_st *memc);
+test_return_t memcached_mget_large_values_TEST(memcached_st *memc);
+test_return_t memcached_mset_TEST(memcached_st *memc);
+test_return_t memcached_mset_E2BIG_TEST(memcached_st *memc);
+test_return_t memcached_mdelete_TEST(memcached_st *memc);
+test_return_t memcached_mincrement_TEST(memcached_st *memc);
+test_return_t memcached_mincrement_with_initial_TEST(memcached_st *memc);
 test_return_t memcached_return_t_TEST(memcached_st *memc);
 test_return_t memcached_server_cursor_test(memcached_st *memc);
 test_return_t memcached_server_remove_test(memcached_st*);
@@ -126,6 +133,17 @@ test_return_t libmemcached_util_ping_TEST(memcached_st*);
 test_return_t prepend_test(memcached_st *memc);
 test_return_t quit_test(memcached_st *memc);
 test_return_t read_through(memcached_st *memc);
+test_return_t early_refresh_TEST(memcached_st *memc);
+test_return_t near_cache_TEST(memcached_st *memc);
+test_return_t near_cache_write_race_TEST(memcached_st *memc);
+test_return_t hot_keys_TEST(memcached_st *memc);
+test_return_t hot_key_replicas_TEST(memcached_st *memc);
+test_return_t memcached_connect_all_TEST(memcached_st *memc);
+test_return_t dns_cache_TEST(memcached_st *memc);
+test_return_t server_stats_TEST(memcached_st *memc);
+test_return_t latency_eject_TEST(memcached_st *memc);
+test_return_t latency_eject_slow_server_TEST(memcached_st *memc);
+test_return_t hedged_reads_TEST(memcached_st *memc);
 test_return_t regression_bug_(memcached_st*);
 test_return_t regression_bug_421108(memcached_st*);
 test_return_t regression_bug_434484(memcached_st*);
@@ -54,6 +54,7 @@ using namespace libtest;
 
 #include <pthread.h>
 #include <poll.h>
+#include <sys/time.h>
 
 #include "libmemcached/instance.hpp"
 
@@ -210,6 +211,87 @@ test_return_t connection_pool2_test(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+test_return_t connection_pool_lock_free_test(memcached_st *memc)
+{
+  memcached_pool_st* pool= memcached_pool_create_lock_free(memc, 5, POOL_SIZE);
+  test_true(pool);
+  memcached_st *mmc[POOL_SIZE];
+
+  for (size_t x= 0; x < POOL_SIZE; ++x)
+  {
+    memcached_return_t rc;
+    mmc[x]= memcached_pool_fetch(pool, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(mmc[x]);
+  }
+
+  // All memc should be gone
+  {
+    memcached_return_t rc;
+    test_null(memcached_pool_fetch(pool, NULL, &rc));
+    test_compare(MEMCACHED_NOTFOUND, rc);
+
+    struct timespec relative_time= { 0, 1000 };
+    test_null(memcached_pool_fetch(pool, &relative_time, &rc));
+    test_compare(MEMCACHED_TIMEOUT, rc);
+  }
+
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_set(mmc[0],
+                             test_literal_param("key"),
+                             "0", 1, 0, 0));
+
+  for (uint64_t x= 0; x < POOL_SIZE; ++x)
+  {
+    uint64_t number_value;
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_increment(mmc[x], 
+                                     test_literal_param("key"),
+                                     1, &number_value));
+    test_compare(number_value, (x+1));
+  }
+
+  for (size_t x= 0; x < POOL_SIZE; ++x)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_pool_release(pool, mmc[x]));
+  }
+
+  // The last one released is kept for this thread
+  {
+    memcached_return_t rc;
+    memcached_st *cached= memcached_pool_fetch(pool, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(cached == mmc[POOL_SIZE -1]);
+    test_compare(MEMCACHED_SUCCESS, memcached_pool_release(pool, cached));
+
+    // Releasing it again is refused and leaves it parked
+    test_compare(MEMCACHED_INVALID_ARGUMENTS, memcached_pool_release(pool, cached));
+    test_true(memcached_pool_fetch(pool, NULL, &rc) == cached);
+    test_compare(MEMCACHED_SUCCESS, memcached_pool_release(pool, cached));
+  }
+
+  // Behaviors reach the idle connections when they are next fetched
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_pool_behavior_set(pool, MEMCACHED_BEHAVIOR_IO_MSG_WATERMARK, 9999));
+
+  for (size_t x= 0; x < POOL_SIZE; ++x)
+  {
+    memcached_return_t rc;
+    mmc[x]= memcached_pool_fetch(pool, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_compare(UINT64_C(9999), memcached_behavior_get(mmc[x], MEMCACHED_BEHAVIOR_IO_MSG_WATERMARK));
+  }
+
+  for (size_t x= 0; x < POOL_SIZE; ++x)
+  {
+    test_compare(MEMCACHED_SUCCESS, memcached_pool_release(pool, mmc[x]));
+  }
+
+  test_true(memcached_pool_destroy(pool) == memc);
+
+  return TEST_SUCCESS;
+}
+
 struct test_pool_context_st {
   volatile memcached_return_t rc;
   memcached_pool_st* pool;
@@ -322,6 +404,44 @@ test_return_t connection_pool3_test(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+/*
+  A connection released by another thread is kept for that thread, it has
+  to be handed over once the pool is exhausted.
+*/
+test_return_t connection_pool3_lock_free_test(memcached_st *memc)
+{
+  memcached_pool_st* pool= memcached_pool_create_lock_free(memc, 1, 1);
+  test_true(pool);
+
+  memcached_st *pool_memc;
+  {
+    memcached_return_t rc;
+    pool_memc= memcached_pool_fetch(pool, NULL, &rc);
+    test_compare(MEMCACHED_SUCCESS, rc);
+    test_true(pool_memc);
+  }
+
+  pthread_t tid;
+  test_pool_context_st item(pool, pool_memc);
+
+  test_zero(pthread_create(&tid, NULL, connection_release, &item));
+  item.wait();
+
+  memcached_return_t rc;
+  struct timespec relative_time= { 5, 0 };
+  memcached_st *pop_memc= memcached_pool_fetch(pool, &relative_time, &rc);
+  test_compare(MEMCACHED_SUCCESS, item.rc);
+  test_compare(MEMCACHED_SUCCESS, rc);
+  test_true(pool_memc == pop_memc);
+
+  test_zero(pthread_join(tid, NULL));
+
+  test_compare(MEMCACHED_SUCCESS, memcached_pool_release(pool, pop_memc));
+  test_true(memcached_pool_destroy(pool) == memc);
+
+  return TEST_SUCCESS;
+}
+
 static memcached_st * create_single_instance_memcached(const memcached_st *original_memc, const char *options)
 {
   /*
@@ -447,7 +567,7 @@ static void *worker_thread(void *ctx)
 }
 
 #define NUM_THREADS 20
-test_return_t regression_bug_962815(memcached_st *memc)
+static test_return_t _regression_bug_962815(memcached_st *memc, bool lock_free)
 {
   pthread_t pid[NUM_THREADS];
 
@@ -456,7 +576,15 @@ test_return_t regression_bug_962815(memcached_st *memc)
   memcached_st *master = create_single_instance_memcached(memc, 0);
   test_true(master);
 
-  memcached_pool_st *pool= memcached_pool_create(master, 5, 10);
+  memcached_pool_st *pool;
+  if (lock_free)
+  {
+    pool= memcached_pool_create_lock_free(master, 5, 10);
+  }
+  else
+  {
+    pool= memcached_pool_create(master, 5, 10);
+  }
 
   test_true(pool);
 
@@ -495,3 +623,211 @@ test_return_t regression_bug_962815(memcached_st *memc)
 
   return TEST_SUCCESS;
 }
+
+test_return_t regression_bug_962815(memcached_st *memc)
+{
+  return _regression_bug_962815(memc, false);
+}
+
+test_return_t regression_bug_962815_lock_free(memcached_st *memc)
+{
+  return _regression_bug_962815(memc, true);
+}
+
+struct pool_contention_st
+{
+  memcached_pool_st *pool;
+  bool *stop;
+  uint64_t checkouts;
+  uint64_t failures;
+};
+
+static void *pool_contention_thread(void *ctx)
+{
+  pool_contention_st *context= static_cast<pool_contention_st *>(ctx);
+
+  struct timespec relative_time= { 5, 0 };
+  while (__atomic_load_n(context->stop, __ATOMIC_ACQUIRE) == false)
+  {
+    memcached_return_t rc;
+    memcached_st *mc= memcached_pool_fetch(context->pool, &relative_time, &rc);
+    if (mc == NULL)
+    {
+      context->failures++;
+      continue;
+    }
+
+    if (memcached_failed(memcached_pool_release(context->pool, mc)))
+    {
+      context->failures++;
+    }
+    context->checkouts++;
+  }
+
+  return NULL;
+}
+
+/*
+  Drives a pool from N threads that do nothing but fetch and release, and
+  reports checkouts per second for the locked and the lock free pool.
+*/
+test_return_t memcached_pool_contention_TEST(memcached_st *memc)
+{
+  const size_t thread_counts[]= { 1, 8, 64 };
+
+  for (size_t lock_free= 0; lock_free < 2; ++lock_free)
+  {
+    for (size_t count= 0; count < sizeof(thread_counts) / sizeof(thread_counts[0]); ++count)
+    {
+      const size_t number_of_threads= thread_counts[count];
+      memcached_pool_st *pool;
+      if (lock_free)
+      {
+        pool= memcached_pool_create_lock_free(memc, 16, 16);
+      }
+      else
+      {
+        pool= memcached_pool_create(memc, 16, 16);
+      }
+      test_true(pool);
+
+      bool stop= false;
+      std::vector<pool_contention_st> contexts(number_of_threads);
+      std::vector<pthread_t> threads(number_of_threads);
+
+      for (size_t x= 0; x < number_of_threads; ++x)
+      {
+        contexts[x].pool= pool;
+        contexts[x].stop= &stop;
+        contexts[x].checkouts= 0;
+        contexts[x].failures= 0;
+        test_zero(pthread_create(&threads[x], NULL, pool_contention_thread, &contexts[x]));
+      }
+
+      struct timeval start, end;
+      gettimeofday(&start, NULL);
+      dream(1, 0);
+      __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+      uint64_t checkouts= 0;
+      for (size_t x= 0; x < number_of_threads; ++x)
+      {
+        test_zero(pthread_join(threads[x], NULL));
+        test_zero(contexts[x].failures);
+        checkouts+= contexts[x].checkouts;
+      }
+      gettimeofday(&end, NULL);
+
+      double elapsed= double(end.tv_sec - start.tv_sec) + double(end.tv_usec - start.tv_usec) / 1000000.0;
+      Out << (lock_free ? "lock free" : "locked") << " pool, " << number_of_threads << " threads: "
+        << uint64_t(double(checkouts) / elapsed) << " checkouts/sec";
+
+      test_true(memcached_pool_destroy(pool) == memc);
+    }
+  }
+
+  return TEST_SUCCESS;
+}
+
+#define SINGLE_FLIGHT_VALUE "single flight value"
+static uint32_t single_flight_trigger_calls= 0;
+
+static memcached_return_t single_flight_trigger(memcached_st *, // memc
+                                                char *, // key
+                                                size_t, //  key_length,
+                                                memcached_result_st *result)
+{
+  __atomic_add_fetch(&single_flight_trigger_calls, 1, __ATOMIC_RELAXED);
+  dream(0, 500 * 1000 * 1000);
+
+  return memcached_result_set_value(result, test_literal_param(SINGLE_FLIGHT_VALUE));
+}
+
+struct single_flight_st
+{
+  memcached_pool_st *pool;
+  pthread_barrier_t *barrier;
+  bool loaded;
+};
+
+static void *single_flight_thread(void *ctx)
+{
+  single_flight_st *context= static_cast<single_flight_st *>(ctx);
+
+  memcached_return_t rc;
+  memcached_st *mc= memcached_pool_pop(context->pool, true, &rc);
+  if (mc)
+  {
+    pthread_barrier_wait(context->barrier);
+
+    size_t value_length;
+    uint32_t flags;
+    char *value= memcached_get(mc, test_literal_param(__func__), &value_length, &flags, &rc);
+    context->loaded= (value and value_length == strlen(SINGLE_FLIGHT_VALUE) and
+                      memcmp(value, SINGLE_FLIGHT_VALUE, value_length) == 0);
+    free(value);
+
+    memcached_pool_push(context->pool, mc);
+  }
+
+  return NULL;
+}
+
+/*
+  Every pooled handle misses the same key at once, the get_key_failure
+  trigger should run once and the other handles wait for its value.
+*/
+test_return_t memcached_pool_single_flight_TEST(memcached_st *memc)
+{
+  const size_t number_of_threads= 8;
+
+  memcached_st *master= memcached_clone(NULL, memc);
+  test_true(master);
+
+  memcached_trigger_key_fn cb= (memcached_trigger_key_fn)single_flight_trigger;
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_callback_set(master, MEMCACHED_CALLBACK_GET_FAILURE, *(void **)&cb));
+  test_compare(MEMCACHED_NOT_SUPPORTED, memcached_single_flight_stats(master, NULL, NULL));
+  test_compare(MEMCACHED_SUCCESS, memcached_behavior_set(master, MEMCACHED_BEHAVIOR_SINGLE_FLIGHT, true));
+  test_true(memcached_behavior_get(master, MEMCACHED_BEHAVIOR_SINGLE_FLIGHT));
+
+  memcached_delete(master, test_literal_param("single_flight_thread"), 0);
+  single_flight_trigger_calls= 0;
+
+  memcached_pool_st *pool= memcached_pool_create(master, number_of_threads, number_of_threads);
+  test_true(pool);
+
+  pthread_barrier_t barrier;
+  test_zero(pthread_barrier_init(&barrier, NULL, number_of_threads));
+
+  std::vector<single_flight_st> contexts(number_of_threads);
+  std::vector<pthread_t> threads(number_of_threads);
+  for (size_t x= 0; x < number_of_threads; ++x)
+  {
+    contexts[x].pool= pool;
+    contexts[x].barrier= &barrier;
+    contexts[x].loaded= false;
+    test_zero(pthread_create(&threads[x], NULL, single_flight_thread, &contexts[x]));
+  }
+
+  for (size_t x= 0; x < number_of_threads; ++x)
+  {
+    test_zero(pthread_join(threads[x], NULL));
+    test_true(contexts[x].loaded);
+  }
+  test_zero(pthread_barrier_destroy(&barrier));
+
+  uint64_t loads, coalesced;
+  test_compare(MEMCACHED_SUCCESS, memcached_single_flight_stats(master, &loads, &coalesced));
+  test_compare(uint64_t(single_flight_trigger_calls), loads);
+  test_compare(uint64_t(number_of_threads), loads +coalesced);
+  test_true(coalesced > 0);
+  Out << "single flight: " << loads << " loads, " << coalesced << " coalesced";
+
+  test_true(memcached_pool_destroy(pool) == master);
+
+  memcached_delete(master, test_literal_param("single_flight_thread"), 0);
+  memcached_free(master);
+
+  return TEST_SUCCESS;
+}
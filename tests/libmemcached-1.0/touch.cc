@@ -148,5 +148,38 @@ test_return_t test_memcached_touch_by_key(memcached_st *memc)
   return TEST_SUCCESS;
 }
 
+test_return_t test_memcached_mtouch(memcached_st *memc)
+{
+  test_skip(TEST_SUCCESS, pre_touch(memc));
+
+  const char *keys[]= { "mtouch_first", "mtouch_missing", "mtouch_last" };
+  size_t key_lengths[]= { strlen(keys[0]), strlen(keys[1]), strlen(keys[2]) };
+  memcached_return_t results[3];
+
+  for (size_t x= 0; x < 3; x+= 2)
+  {
+    test_compare(MEMCACHED_SUCCESS,
+                 memcached_set(memc, keys[x], key_lengths[x],
+                               test_literal_param("touchval"),
+                               2, 0));
+  }
+  (void)memcached_delete(memc, keys[1], key_lengths[1], 0);
+
+  test_compare(MEMCACHED_SOME_ERRORS,
+               memcached_mtouch(memc, keys, key_lengths, 3, 60 *60, results));
+  test_compare(MEMCACHED_SUCCESS, results[0]);
+  test_compare(MEMCACHED_NOTFOUND, results[1]);
+  test_compare(MEMCACHED_SUCCESS, results[2]);
 
+  // A date far enough away is taken as absolute, and so already expired
+  test_compare(MEMCACHED_SUCCESS,
+               memcached_mtouch(memc, keys, key_lengths, 1, 60 *60 *24 *60, NULL));
 
+  memcached_return_t rc= memcached_exist(memc, keys[0], key_lengths[0]);
+  ASSERT_EQ_(MEMCACHED_NOTFOUND, rc, "%s", memcached_last_error_message(memc));
+
+  rc= memcached_exist(memc, keys[2], key_lengths[2]);
+  ASSERT_EQ_(MEMCACHED_SUCCESS, rc, "%s", memcached_last_error_message(memc));
+
+  return TEST_SUCCESS;
+}
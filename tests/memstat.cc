@@ -92,11 +92,35 @@ static test_return_t binary_server_version_TEST(void *)
   return TEST_SUCCESS;
 }
 
+static test_return_t hot_keys_TEST(void *)
+{
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer), "--servers=localhost:%d", int(libtest::default_port()));
+  const char *args[]= { buffer, " --hot-keys=/dev/null", 0 };
+
+  test_compare(EXIT_SUCCESS, exec_cmdline(executable, args, true));
+
+  return TEST_SUCCESS;
+}
+
+static test_return_t client_TEST(void *)
+{
+  char buffer[1024];
+  snprintf(buffer, sizeof(buffer), "--servers=localhost:%d", int(libtest::default_port()));
+  const char *args[]= { buffer, " --client", 0 };
+
+  test_compare(EXIT_SUCCESS, exec_cmdline(executable, args, true));
+
+  return TEST_SUCCESS;
+}
+
 test_st memstat_tests[] ={
   {"--help", 0, help_test},
   {"--binary", 0, binary_TEST},
   {"--server-version", 0, server_version_TEST},
   {"--binary --server-version", 0, binary_server_version_TEST},
+  {"--hot-keys", 0, hot_keys_TEST},
+  {"--client", 0, client_TEST},
   {0, 0, 0}
 };
 
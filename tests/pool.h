@@ -42,3 +42,8 @@ test_return_t connection_pool_test(memcached_st *);
 test_return_t connection_pool2_test(memcached_st *);
 test_return_t connection_pool3_test(memcached_st *);
 test_return_t regression_bug_962815(memcached_st *);
+test_return_t connection_pool_lock_free_test(memcached_st *);
+test_return_t connection_pool3_lock_free_test(memcached_st *);
+test_return_t regression_bug_962815_lock_free(memcached_st *);
+test_return_t memcached_pool_contention_TEST(memcached_st *);
+test_return_t memcached_pool_single_flight_TEST(memcached_st *);
@@ -39,3 +39,4 @@
 
 test_return_t test_memcached_touch(memcached_st *);
 test_return_t test_memcached_touch_by_key(memcached_st *);
+test_return_t test_memcached_mtouch(memcached_st *);